@@ -3,7 +3,7 @@
 
 // @gips_version=1 @coord=pixel @filter=on
 
-uniform float radius = 0.0;   // @max=100
+uniform float radius = 0.0;   // @max=100 @identity
 uniform float N = 7.0;        // @min=3 @max=23 @int sample count
 uniform float passes = 3.0;   // @min=1 @max=4 @int pass count
 uniform float decay = 0.707;  // pass decay
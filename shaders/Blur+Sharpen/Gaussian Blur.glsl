@@ -5,8 +5,8 @@
 
 // not a "true" Gaussian blur -- using a cheap (finite) approximation
 
-uniform float sigma = 0.3;   // @min=0.3 @max=50 @digits=2
-uniform float aspect;        // @min=-1.5 @max=1.5
+uniform float sigma = 0.3;   // @min=0.3 @max=50 @digits=2 @identity
+uniform float aspect;        // @min=-1.5 @max=1.5 @identity
 uniform float amin = 1.0;    // @switch control sigma by alpha channel @on=0 @off=1
 
 vec4 run_main(vec2 pos, vec2 dir, float radius) {
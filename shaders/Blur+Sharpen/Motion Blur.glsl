@@ -5,7 +5,7 @@
 
 // not a "true" Gaussian blur -- using a cheap (finite) approximation
 
-uniform float sigma = 0.3;   // @min=0.3 @max=50 @digits=2
+uniform float sigma = 0.3;   // @min=0.3 @max=50 @digits=2 @identity
 uniform float angle;         // @angle @max=180
 uniform float box;           // @switch box blur (instead of Gaussian)
 uniform float amin = 1.0;    // @switch control sigma by alpha channel @on=0 @off=1
@@ -6,7 +6,7 @@
 // not a "true" Gaussian blur -- using a cheap (finite) approximation
 
 uniform vec2 center;           // @min=-2 @max=2
-uniform float strength;        // strength (exponential)
+uniform float strength;        // strength (exponential) @identity
 uniform float samples = 10.0;  // @min=1 @max=100 @int sample count (quality)
 uniform float box;             // @switch box blur (instead of Gaussian)
 
@@ -3,9 +3,9 @@
 
 // @gips_version=1
 
-uniform float balR;         // @min=-1 @max=1 cyan<->red
-uniform float balG;         // @min=-1 @max=1 magenta<->green
-uniform float balB;         // @min=-1 @max=1 yellow<->blue
+uniform float balR;         // @min=-1 @max=1 cyan<->red @identity
+uniform float balG;         // @min=-1 @max=1 magenta<->green @identity
+uniform float balB;         // @min=-1 @max=1 yellow<->blue @identity
 uniform float keepLuma;     // @switch        preserve luminance
 uniform float gamma = 2.2;  // @min=.2 @max=5 working gamma
 
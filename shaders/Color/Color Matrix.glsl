@@ -3,10 +3,10 @@
 
 // @gips_version=1
 
-uniform vec3 mixR = vec3(1., 0., 0.);  // @min=-2 @max=2 red mix
-uniform vec3 mixG = vec3(0., 1., 0.);  // @min=-2 @max=2 green mix
-uniform vec3 mixB = vec3(0., 0., 1.);  // @min=-2 @max=2 blue mix
-uniform vec3 offset;                   // @min=-2 @max=2 RGB offset
+uniform vec3 mixR = vec3(1., 0., 0.);  // @min=-2 @max=2 red mix @identity
+uniform vec3 mixG = vec3(0., 1., 0.);  // @min=-2 @max=2 green mix @identity
+uniform vec3 mixB = vec3(0., 0., 1.);  // @min=-2 @max=2 blue mix @identity
+uniform vec3 offset;                   // @min=-2 @max=2 RGB offset @identity
 
 vec3 run(vec3 rgb) {
     rgb = vec3(dot(rgb, mixR), dot(rgb, mixG), dot(rgb, mixB));
@@ -3,10 +3,10 @@
 
 // @gips_version=1
 
-uniform float hue;               // @angle
-uniform float saturation = 1.0;  // @min=0 @max=5
-uniform float invert;      // invert luminance   @toggle
-uniform float sign = 1.0;  // invert chrominance @toggle @off=1 @on=-1
+uniform float hue;               // @angle @identity
+uniform float saturation = 1.0;  // @min=0 @max=5 @identity
+uniform float invert;      // invert luminance   @toggle @identity
+uniform float sign = 1.0;  // invert chrominance @toggle @off=1 @on=-1 @identity
 
 vec3 run(vec3 rgb) {
     float luma = dot(rgb, vec3(.299, .587, .114));
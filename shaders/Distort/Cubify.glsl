@@ -10,7 +10,7 @@ uniform float hard;         // @switch hard pixels
 uniform float angle;        // @angle @max=90
 uniform vec2 phase;         // @min=-1 @max=1
 
-vec4 run(vec2 pos) {
+vec2 map(vec2 pos) {
     // pre-scale position, split into integer + fractional part
     float s = sin(angle), c = cos(angle);
     pos *= mat2(c,s,-s,c);
@@ -33,6 +33,5 @@ vec4 run(vec2 pos) {
 
     // re-assemble position
     pos = (pos + base - phase) / scxy;
-    pos *= mat2(c,-s,s,c);
-    return pixel(pos);
+    return pos * mat2(c,-s,s,c);
 }
@@ -18,7 +18,7 @@ float rand(float key, uint seed2) {
     return 2.0 * (uintBitsToFloat((x.r & 0x007FFFFFu) | 0x3F800000u) - 1.5);
 }
 
-vec4 run(vec2 pos) {
+vec2 map(vec2 pos) {
     float c = cos(angle), s = sin(angle);
 
     // get "octave" position
@@ -36,5 +36,5 @@ vec4 run(vec2 pos) {
     noise = mix(noise, -noise, sign);
 
     // apply displacement
-    return pixel(pos + vec2(c,s) * dot(noise, (exp2(strength) - 1.0) / (1.01 - threshold)));
+    return pos + vec2(c,s) * dot(noise, (exp2(strength) - 1.0) / (1.01 - threshold));
 }
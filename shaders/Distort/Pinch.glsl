@@ -3,11 +3,11 @@
 
 // @gips_version=1 @coord=rel
 
-uniform float strength;      // @min=-1 @max=1
+uniform float strength;      // @min=-1 @max=1 @identity
 uniform float radius = 1.0;  // @min=0.01 @max=2
 uniform vec2  center;        // @min=-2 @max=2
 
-vec4 run(vec2 pos) {
+vec2 map(vec2 pos) {
     pos -= center;
     float oldDist = length(pos);
     float d = oldDist / radius;
@@ -17,6 +17,5 @@ vec4 run(vec2 pos) {
     }
     d *= radius;
     pos *= d / oldDist;
-    pos += center;
-    return pixel(pos);
+    return pos + center;
 }
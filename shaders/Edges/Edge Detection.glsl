@@ -1,7 +1,7 @@
 // SPDX-FileCopyrightText: 2021 Martin J. Fiedler <keyj@emphy.de>
 // SPDX-License-Identifier: MIT
 
-// @gips_version=1 @coord=pixel @filter=off
+// @gips_version=1 @coord=pixel @filter=off @halo=1
 
 uniform float angle;        // @angle
 uniform float scale = 1.0;  // @max=5 amplification
@@ -3,8 +3,8 @@
 
 // @gips_version=1 @coord=rel @filter=on
 
-uniform float red;     // @min=-0.01 @max=0.01 red/cyan strength
-uniform float blue;    // @min=-0.01 @max=0.01 blue/yellow strength
+uniform float red;     // @min=-0.01 @max=0.01 red/cyan strength @identity
+uniform float blue;    // @min=-0.01 @max=0.01 blue/yellow strength @identity
 uniform float aspect;  // @min=-2 @max=2 R/B aspect ratio
 uniform vec2 center;   // @min=-1 @max=1
 
@@ -3,7 +3,7 @@
 
 // @gips_version=1 @coord=rel
 
-uniform float strength;
+uniform float strength;     // @identity
 uniform float size = 1.0;   // @min=0.01 @max=2
 uniform float power = 2.0;  // falloff power @min=1 @max=10
 uniform float sign = -1.0;  // inverse (correct vignetting) @toggle @on=1 @off=-1
@@ -1,7 +1,7 @@
 // SPDX-FileCopyrightText: 2021 Martin J. Fiedler <keyj@emphy.de>
 // SPDX-License-Identifier: MIT
 
-// @gips_version=1 @coord=none @filter=off
+// @gips_version=1 @coord=none @filter=off @halo=1
 
 uniform vec3 row0 = vec3(0.0, 0.0, 0.0);  // @min=-64 @max=64 abc
 uniform vec3 row1 = vec3(0.0, 1.0, 0.0);  // @min=-64 @max=64 def
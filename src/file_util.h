@@ -4,6 +4,7 @@
 #pragma once
 
 #include <cstdint>
+#include <cstddef>
 
 namespace FileUtil {
 
@@ -62,4 +63,25 @@ public:
 
 ///////////////////////////////////////////////////////////////////////////////
 
+//! read-only memory mapping of a whole file
+class MappedFile {
+    struct MappedFilePrivate *priv = nullptr;
+    const uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+public:
+    bool open(const char* filename);
+    inline bool good() const { return (m_data != nullptr); }
+    void close();
+
+    inline const uint8_t* data() const { return m_data; }
+    inline size_t         size() const { return m_size; }
+
+    inline MappedFile() {}
+    inline explicit MappedFile(const char* filename) { open(filename); }
+    MappedFile(const MappedFile&) = delete;
+    inline ~MappedFile() { close(); }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
 }  // namespace FileUtil
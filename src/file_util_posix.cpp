@@ -8,6 +8,8 @@
 #include <errno.h>
 #include <unistd.h>
 #include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 
 #include <cstdio>
 #include <cstdlib>
@@ -102,4 +104,31 @@ bool FileFingerprint::update(const char* path) {
 
 ///////////////////////////////////////////////////////////////////////////////
 
+bool MappedFile::open(const char* filename) {
+    close();
+    if (!filename || !filename[0]) { return false; }
+    int fd = ::open(filename, O_RDONLY);
+    if (fd < 0) { return false; }
+    struct stat st;
+    if (!fstat(fd, &st) && (st.st_size > 0)) {
+        void* map = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            m_data = static_cast<const uint8_t*>(map);
+            m_size = size_t(st.st_size);
+        }
+    }
+    ::close(fd);  // the mapping stays valid after closing the descriptor
+    return good();
+}
+
+void MappedFile::close() {
+    if (m_data) {
+        munmap(const_cast<uint8_t*>(m_data), m_size);
+    }
+    m_data = nullptr;
+    m_size = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
 }  // namespace FileUtil
@@ -104,4 +104,45 @@ bool FileFingerprint::update(const char* path) {
 
 ///////////////////////////////////////////////////////////////////////////////
 
+struct MappedFilePrivate {
+    HANDLE hFile;
+    HANDLE hMapping;
+};
+
+bool MappedFile::open(const char* filename) {
+    close();
+    if (!filename || !filename[0]) { return false; }
+    priv = new(std::nothrow) MappedFilePrivate;
+    if (!priv) { return false; }
+    priv->hMapping = nullptr;
+    priv->hFile = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ,
+        nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    LARGE_INTEGER size;
+    if ((priv->hFile != INVALID_HANDLE_VALUE) && GetFileSizeEx(priv->hFile, &size) && (size.QuadPart > 0)) {
+        priv->hMapping = CreateFileMappingA(priv->hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (priv->hMapping) {
+            m_data = static_cast<const uint8_t*>(MapViewOfFile(priv->hMapping, FILE_MAP_READ, 0, 0, 0));
+            m_size = m_data ? size_t(size.QuadPart) : 0;
+        }
+    }
+    if (!m_data) { close(); }
+    return good();
+}
+
+void MappedFile::close() {
+    if (m_data) {
+        UnmapViewOfFile(m_data);
+    }
+    if (priv) {
+        if (priv->hMapping) { CloseHandle(priv->hMapping); }
+        if (priv->hFile != INVALID_HANDLE_VALUE) { CloseHandle(priv->hFile); }
+        delete priv;
+        priv = nullptr;
+    }
+    m_data = nullptr;
+    m_size = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
 }  // namespace FileUtil
@@ -31,6 +31,7 @@
 #include "file_util.h"
 #include "vfs.h"
 #include "clipboard.h"
+#include "image_util.h"
 
 #include "patterns.h"
 
@@ -42,6 +43,9 @@ extern "C" const char* git_branch;
 
 namespace GIPS {
 
+constexpr size_t DecodedImageCacheBudget = size_t(1) << 30;  //!< in bytes
+constexpr size_t DecodedImageCacheMaxEntries = 4;
+
 ///////////////////////////////////////////////////////////////////////////////
 
 bool App::isPipelineFile(uint32_t extCode) {
@@ -51,7 +55,8 @@ bool App::isPipelineFile(uint32_t extCode) {
 bool App::isShaderFile(uint32_t extCode) {
     return (extCode == StringUtil::makeExtCode("glsl"))
         || (extCode == StringUtil::makeExtCode("frag"))
-        || (extCode == StringUtil::makeExtCode("fs"));
+        || (extCode == StringUtil::makeExtCode("fs"))
+        || (extCode == StringUtil::makeExtCode("cube"));  // 3D LUT, loaded as a node
 }
 
 bool App::isImageFile(uint32_t extCode) {
@@ -65,7 +70,11 @@ bool App::isImageFile(uint32_t extCode) {
         || (extCode == StringUtil::makeExtCode("gif"))
         || (extCode == StringUtil::makeExtCode("pgm"))
         || (extCode == StringUtil::makeExtCode("ppm"))
-        || (extCode == StringUtil::makeExtCode("pnm"));
+        || (extCode == StringUtil::makeExtCode("pnm"))
+        || (extCode == StringUtil::makeExtCode("pam"))
+        || (extCode == StringUtil::makeExtCode("pfm"))
+        || (extCode == StringUtil::makeExtCode("hdr"))
+        || (extCode == StringUtil::makeExtCode("qoi"));
 }
 
 bool App::isSaveImageFile(uint32_t extCode) {
@@ -74,7 +83,13 @@ bool App::isSaveImageFile(uint32_t extCode) {
         || (extCode == StringUtil::makeExtCode("jpe"))
         || (extCode == StringUtil::makeExtCode("png"))
         || (extCode == StringUtil::makeExtCode("tga"))
-        || (extCode == StringUtil::makeExtCode("bmp"));
+        || (extCode == StringUtil::makeExtCode("bmp"))
+        || (extCode == StringUtil::makeExtCode("qoi"))
+        || (extCode == StringUtil::makeExtCode("pam"))
+        || (extCode == StringUtil::makeExtCode("pfm"))
+        || (extCode == StringUtil::makeExtCode("tif"))
+        || (extCode == StringUtil::makeExtCode("tiff"))
+        || (extCode == StringUtil::makeExtCode("hdr"));
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -94,6 +109,12 @@ int App::run(int argc, char *argv[]) {
 
     setPaths(argv[0]);
 
+    // "gips --serve <socket>" runs as a daemon, with an invisible window
+    const char* servePath = nullptr;
+    #ifndef _WIN32
+        if ((argc > 2) && !strcmp(argv[1], "--serve")) { servePath = argv[2]; }
+    #endif
+
     if (!glfwInit()) {
         const char* err = "unknown error";
         glfwGetError(&err);
@@ -112,6 +133,7 @@ int App::run(int argc, char *argv[]) {
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
     glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
+    glfwWindowHint(GLFW_VISIBLE, servePath ? GLFW_FALSE : GLFW_TRUE);
     #ifndef NDEBUG
     glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GLFW_TRUE);
     #endif
@@ -157,6 +179,15 @@ int App::run(int argc, char *argv[]) {
         return 1;
     }
     GLutil::enableDebugMessages();
+    #ifndef _WIN32
+        if (servePath) {
+            int res = runServer(servePath);
+            GLutil::done();
+            glfwDestroyWindow(m_window);
+            glfwTerminate();
+            return res;
+        }
+    #endif
     m_glVendor   = (const char*) glGetString(GL_VENDOR);
     m_glRenderer = (const char*) glGetString(GL_RENDERER);
     m_glVersion  = (const char*) glGetString(GL_VERSION);
@@ -171,10 +202,15 @@ int App::run(int argc, char *argv[]) {
     glBindTexture(GL_TEXTURE_2D, m_imgTex);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glGenTextures(1, &m_resultTex);
+    glBindTexture(GL_TEXTURE_2D, m_resultTex);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glBindTexture(GL_TEXTURE_2D, 0);
     GLutil::checkError("texture setup");
 
     m_helperFBO.init();
+    m_viewFBO.init();
 
     if (!m_pipeline.init()) {
         fprintf(stderr, "failed to initialize the main pipeline\n");
@@ -184,20 +220,32 @@ int App::run(int argc, char *argv[]) {
     if (!m_renderDirect.init(m_pipeline.vs(), "direct rendering",
             "#version 330 core"
         "\n" "uniform sampler2D gips_tex;"
+        "\n" "uniform float gips_encode;"
         "\n" "in vec2 gips_pos;"
         "\n" "out vec4 gips_frag;"
+        "\n" "vec4 encode(vec4 c) {"
+        "\n" "  if (gips_encode < 0.5) { return c; }"
+        "\n" "  vec3 e = mix(12.92 * c.rgb, 1.055 * pow(c.rgb, vec3(1.0 / 2.4)) - 0.055, step(0.0031308, c.rgb));"
+        "\n" "  return vec4(e, c.a);"
+        "\n" "}"
         "\n" "void main() {"
-        "\n" "  gips_frag = texture(gips_tex, gips_pos);"
+        "\n" "  gips_frag = encode(texture(gips_tex, gips_pos));"
         "\n" "}"
         "\n")) { return 1; }
     if (!m_renderWithAlpha.init(m_pipeline.vs(), "alpha-visualization rendering",
             "#version 330 core"
         "\n" "uniform sampler2D gips_tex;"
+        "\n" "uniform float gips_encode;"
         "\n" "in vec2 gips_pos;"
         "\n" "out vec4 gips_frag;"
+        "\n" "vec4 encode(vec4 c) {"
+        "\n" "  if (gips_encode < 0.5) { return c; }"
+        "\n" "  vec3 e = mix(12.92 * c.rgb, 1.055 * pow(c.rgb, vec3(1.0 / 2.4)) - 0.055, step(0.0031308, c.rgb));"
+        "\n" "  return vec4(e, c.a);"
+        "\n" "}"
         "\n" "void main() {"
         "\n" "  vec2 cb = mod(floor(gl_FragCoord.xy * 0.125), 2.0);"
-        "\n" "  vec4 color = texture(gips_tex, gips_pos);"
+        "\n" "  vec4 color = encode(texture(gips_tex, gips_pos));"
         "\n" "  gips_frag = vec4(mix(vec3(0.5 + 0.25 * abs(cb.x - cb.y)), color.rgb, color.a), 1.0);"
         "\n" "}"
         "\n")) { return 1; }
@@ -209,10 +257,23 @@ int App::run(int argc, char *argv[]) {
     #ifndef NDEBUG
         fprintf(stderr, "max tex size: %d, max VP size: %dx%d => max image size: %d\n", maxTex, maxVP[0], maxVP[1], m_imgMaxSize);
     #endif
+    if (!m_resampler.init(m_pipeline.vs(), m_imgMaxSize)) {
+        fprintf(stderr, "GPU resampling not available, using the CPU instead\n");
+    }
+    if (!m_resampler.good() || !m_tileView.init(m_pipeline.vs(), m_imgMaxSize)) {
+        fprintf(stderr, "full-resolution tile view not available\n");
+    }
 
     loadPattern();
     for (int i = 1;  i < argc;  ++i) {
-        handleInputFile(argv[i]);
+        if (!strcmp(argv[i], "--trace")) {
+            m_latency.setTrace(true);
+        } else {
+            handleInputFile(argv[i]);
+        }
+    }
+    if (!m_renderThread.start(m_window, m_pipeline)) {
+        fprintf(stderr, "render thread not available, rendering in the UI thread instead\n");
     }
 
     // main loop
@@ -242,75 +303,82 @@ int App::run(int argc, char *argv[]) {
         #endif
         ImGui::Render();
 
-        // handle auto-test
+        // handle auto-test and pipeline changes; both modify the
+        // pipeline, so they need to wait for a running render
         if (autoTestInProgress()) {
+            RenderThread::Lock lock(m_renderThread);
             handleAutoTest();
         }
-
-        // process pipeline changes
-        if (handlePCR()) {
-            requestFrames(1);
+        if (m_pcr.type != PipelineChangeRequest::Type::None) {
+            RenderThread::Lock lock(m_renderThread);
+            if (handlePCR()) {
+                requestFrames(1);
+            }
         }
 
-        // image processing
-        if (m_pipeline.changed()) {
-            m_pipeline.render(m_imgTex, m_imgWidth, m_imgHeight, m_requestedFormat, m_showIndex);
+        // image processing; in sRGB mode, the image texture
+        // must be tagged as sRGB-encoded, too
+        bool wantSRGB = (m_pipeline.resolveFormat(processingFormat()) == PixelFormat::SRGB8);
+        if (wantSRGB != m_imgSRGB) {
+            RenderThread::Lock lock(m_renderThread);
+            setImageSRGB(wantSRGB);
         }
+        bool pipelineChanged = m_pipeline.changed();
+        if (pipelineChanged) {
+            // a render of the previous state is useless now
+            ++m_renderGeneration;
+            m_renderThread.cancel();
+        }
+        m_latency.update(pipelineChanged, m_renderGeneration);
+        updateResult();
 
-        // request to save?
-        if (m_pcr.type == PipelineChangeRequest::Type::SaveFile) {
-            saveFile(m_pcr.path.c_str());
-            m_pcr.type = PipelineChangeRequest::Type::None;
-            m_pcr.path.clear();
+        // request to save? this waits until the result is up to date
+        bool saveRequested = (m_pcr.type == PipelineChangeRequest::Type::SaveFile)
+                          || (m_pcr.type == PipelineChangeRequest::Type::SaveClipboard);
+        if (saveRequested && !resultCurrent()) {
             requestFrames(1);
-        }
-        if (m_pcr.type == PipelineChangeRequest::Type::SaveClipboard) {
-            saveFile(nullptr, true);
+        } else if (saveRequested) {
+            RenderThread::Lock lock(m_renderThread);
+            if (m_pcr.type == PipelineChangeRequest::Type::SaveFile) {
+                saveFile(m_pcr.path.c_str());
+            } else {
+                saveFile(nullptr, true);
+            }
             m_pcr.type = PipelineChangeRequest::Type::None;
+            m_pcr.path.clear();
             requestFrames(1);
         }
 
-        // start display rendering
-        GLutil::clearError();
-        glViewport(0, 0, int(m_io->DisplaySize.x), int(m_io->DisplaySize.y));
-        glClearColor(0.125f, 0.125f, 0.125f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT);
-
         // draw the main image
         updateImageGeometry();
-        RenderProgram& renderer = m_showAlpha ? m_renderWithAlpha : m_renderDirect;
-        if (renderer.prog.use()) {
-            glBindTexture(GL_TEXTURE_2D, m_pipeline.resultTex());
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-            float scaleX =  2.0f / m_io->DisplaySize.x;
-            float scaleY = -2.0f / m_io->DisplaySize.y;
-            glUniform4f(renderer.areaLoc,
-                scaleX * float(m_imgX0) - 1.0f,
-                scaleY * float(m_imgY0) + 1.0f,
-                scaleX * m_imgZoom * float(m_imgWidth),
-                scaleY * m_imgZoom * float(m_imgHeight));
-            GLutil::checkError("main image uniform setup");
-            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-            GLutil::checkError("main image draw");
-            glBindTexture(GL_TEXTURE_2D, 0);
-        }
+        drawImage();
 
         // draw the GUI and finish the frame
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
         GLutil::checkError("GUI draw");
         glfwSwapBuffers(m_window);
+        m_latency.presented();
     }
 
     // clean up
     #ifndef NDEBUG
         fprintf(stderr, "exiting ...\n");
     #endif
+    if (m_latency.trace()) {
+        m_latency.printStats(stderr);
+    }
     glUseProgram(0);
+    m_renderThread.stop();
     glDeleteTextures(1, &m_imgTex);
+    glDeleteTextures(1, &m_resultTex);
     m_pipeline.free();
     m_renderDirect.prog.free();
     m_renderWithAlpha.prog.free();
+    if (m_viewTex) { glDeleteTextures(1, &m_viewTex); }
+    m_viewFBO.free();
+    m_resampler.free();
+    clearDecodedImages();
+    m_tileView.free();
     GLutil::done();
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
@@ -325,6 +393,153 @@ int App::run(int argc, char *argv[]) {
 
 ///////////////////////////////////////////////////////////////////////////////
 
+void App::updateResult() {
+    // pick up a completed result; results of renders that were started
+    // before the latest change are dropped
+    unsigned generation = 0;
+    if (m_renderThread.poll(generation)) {
+        if (generation == m_renderGeneration) {
+            RenderThread::Lock lock(m_renderThread);
+            acquireResult();
+            m_latency.rendered(generation);
+        }
+        m_renderThread.release();
+    }
+
+    // start rendering the latest state as soon as the render thread is
+    // idle; changes made in the meantime are accumulated
+    if ((m_requestedGeneration != m_renderGeneration) && !m_renderThread.busy()) {
+        RenderThread::Lock lock(m_renderThread);
+        m_pipeline.latchParameters();
+        m_requestedGeneration = m_renderGeneration;
+        if (m_renderThread.running()) {
+            m_renderThread.request(m_imgTex, m_imgWidth, m_imgHeight, processingFormat(), m_showIndex, m_renderGeneration);
+        } else {
+            m_pipeline.render(m_imgTex, m_imgWidth, m_imgHeight, processingFormat(), m_showIndex);
+            acquireResult();
+            m_latency.rendered(m_renderGeneration);
+        }
+    }
+}
+
+void App::acquireResult() {
+    if (!m_pipeline.copyResult(m_resultTex)) {
+        setError("failed to retrieve the processing result");
+    }
+    m_resultFormat = m_pipeline.resultFormat();
+    m_tileView.invalidate();
+    m_viewValid = false;
+    m_mipmappedTex = 0;
+    requestFrames(1);
+}
+
+void App::drawImage() {
+    const int width = int(m_io->DisplaySize.x), height = int(m_io->DisplaySize.y);
+
+    // when zoomed in beyond the interactive resolution, the tile view
+    // shows the full-resolution result; it may need to render tiles
+    // even if nothing else changed
+    // (this is skipped while the render thread is busy)
+    prepareTileView();
+    bool tileViewUsed = false;
+    if (m_tileView.hasSource() && m_renderThread.tryLock()) {
+        tileViewUsed = m_tileView.update(m_pipeline, m_resampler, m_resampleFilter, processingFormat(), m_showIndex,
+                                         width, height, m_imgX0, m_imgY0, m_imgZoom);
+        m_renderThread.unlock();
+    }
+    if (tileViewUsed && m_tileView.busy()) {
+        requestFrames(1);
+    }
+
+    // re-composite the view only if anything in it changed; frames where
+    // only the UI changed just copy the cached view to the screen
+    ViewState state;
+    state.resultTex = m_resultTex;
+    state.width = width;
+    state.height = height;
+    state.x0 = m_imgX0;
+    state.y0 = m_imgY0;
+    state.zoom = m_imgZoom;
+    state.alpha = m_showAlpha;
+    state.tiled = tileViewUsed;
+    if (!m_viewValid || !(state == m_viewState) || (tileViewUsed && (m_tileView.lastRenderCount() > 0))) {
+        GLutil::clearError();
+        if (!m_viewTex) {
+            glGenTextures(1, &m_viewTex);
+            glBindTexture(GL_TEXTURE_2D, m_viewTex);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        }
+        if (((width != m_viewTexWidth) || (height != m_viewTexHeight)) && (width > 0) && (height > 0)) {
+            glBindTexture(GL_TEXTURE_2D, m_viewTex);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+            bool ok = !GLutil::checkError("view texture allocation");
+            m_viewTexWidth  = ok ? width  : 0;
+            m_viewTexHeight = ok ? height : 0;
+        }
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        // if the cache isn't usable for whatever reason, draw directly
+        // onto the screen instead
+        bool cached = (width > 0) && (width == m_viewTexWidth) && (height == m_viewTexHeight)
+                   && m_viewFBO.begin(m_viewTex);
+        if (!cached) { m_viewFBO.end(); }
+        glViewport(0, 0, width, height);
+        glClearColor(0.125f, 0.125f, 0.125f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        RenderProgram& renderer = m_showAlpha ? m_renderWithAlpha : m_renderDirect;
+        if (tileViewUsed) {
+            m_tileView.draw(width, height, m_imgX0, m_imgY0, m_imgZoom, state.resultTex, m_showAlpha);
+        } else if (renderer.prog.use()) {
+            glBindTexture(GL_TEXTURE_2D, state.resultTex);
+            // when zoomed out, the image is minified through a mip chain,
+            // which is built only once per result
+            bool minify = (m_imgZoom < 1.0f);
+            if (minify && (m_mipmappedTex != state.resultTex)) {
+                glGenerateMipmap(GL_TEXTURE_2D);
+                m_mipmappedTex = state.resultTex;
+            }
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, minify ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glUniform1f(renderer.encodeLoc, (m_resultFormat == PixelFormat::SRGB8) ? 1.0f : 0.0f);
+            float scaleX =  2.0f / m_io->DisplaySize.x;
+            float scaleY = -2.0f / m_io->DisplaySize.y;
+            glUniform4f(renderer.areaLoc,
+                scaleX * float(m_imgX0) - 1.0f,
+                scaleY * float(m_imgY0) + 1.0f,
+                scaleX * m_imgZoom * float(m_imgWidth),
+                scaleY * m_imgZoom * float(m_imgHeight));
+            GLutil::checkError("main image uniform setup");
+            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+            GLutil::checkError("main image draw");
+            glBindTexture(GL_TEXTURE_2D, 0);
+        }
+        m_viewState = state;
+        m_viewValid = cached;
+        if (!cached) { return; }
+        m_viewFBO.end();
+    }
+
+    // copy the cached view to the screen
+    GLutil::clearError();
+    if (!m_viewFBO.begin(m_viewTex)) {
+        m_viewFBO.end();
+        m_viewValid = false;
+        requestFrames(1);
+        return;
+    }
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_viewFBO);
+    m_viewFBO.end();
+    glViewport(0, 0, width, height);
+    GLutil::checkError("view copy");
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
 bool App::RenderProgram::init(GLuint vs, const char* desc, const char* fsSource) {
     GLutil::Shader fs(GL_FRAGMENT_SHADER, fsSource);
     if (!fs.good()) {
@@ -337,6 +552,8 @@ bool App::RenderProgram::init(GLuint vs, const char* desc, const char* fsSource)
     }
     if (prog.use()) {
         areaLoc = prog.getUniformLocation("gips_pos2ndc");
+        encodeLoc = prog.getUniformLocation("gips_encode");
+        glUniform1f(encodeLoc, 0.0f);
         glUniform4f(prog.getUniformLocation("gips_rel2map"), 0.0f, 0.0f, 1.0f, 1.0f);
         GLutil::checkError("uniform lookup");
         glUseProgram(0);
@@ -349,6 +566,7 @@ bool App::RenderProgram::init(GLuint vs, const char* desc, const char* fsSource)
 
 void App::handleKeyEvent(int key, int scancode, int action, int mods) {
     (void)scancode;
+    m_latency.inputEvent();
     if ((action != GLFW_PRESS) || m_io->WantCaptureKeyboard) { return; }
     bool ctrl = ((mods & GLFW_MOD_CONTROL) != 0);
     switch (key) {
@@ -359,10 +577,11 @@ void App::handleKeyEvent(int key, int scancode, int action, int mods) {
             if (ctrl) { showSaveUI(!(mods & GLFW_MOD_SHIFT)); }
             break;
         case GLFW_KEY_C:
-            if (ctrl) { saveFile(nullptr, true); }
+            if (ctrl) { requestSaveClipboard(); }
             break;
         case GLFW_KEY_V:
             if (ctrl) {
+                RenderThread::Lock lock(m_renderThread);
                 if (!loadPipeline(nullptr)) { loadImage(nullptr, true, true); }
             }
             break;
@@ -373,7 +592,8 @@ void App::handleKeyEvent(int key, int scancode, int action, int mods) {
             m_showDebug = true;
             break;
         case GLFW_KEY_F5: {
-            if (ctrl) { updateImage(); }
+            RenderThread::Lock lock(m_renderThread);
+            if (ctrl) { clearDecodedImages(); updateImage(); }
             m_pipeline.reload(ctrl);
             break; }
         default:
@@ -383,6 +603,7 @@ void App::handleKeyEvent(int key, int scancode, int action, int mods) {
 
 void App::handleMouseButtonEvent(int button, int action, int mods) {
     (void)mods;
+    m_latency.inputEvent();
     if (action == GLFW_RELEASE) {
         m_panning = false;
     } else if (!m_io->WantCaptureMouse && ((button == GLFW_MOUSE_BUTTON_LEFT) || (button == GLFW_MOUSE_BUTTON_MIDDLE))) {
@@ -393,6 +614,7 @@ void App::handleMouseButtonEvent(int button, int action, int mods) {
 }
 
 void App::handleCursorPosEvent(double xpos, double ypos) {
+    m_latency.inputEvent();
     if (m_panning && ((glfwGetMouseButton(m_window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS)
                   ||  (glfwGetMouseButton(m_window, GLFW_MOUSE_BUTTON_MIDDLE) == GLFW_PRESS))) {
         panUpdate(int(xpos + 0.5), int(ypos + 0.5));
@@ -401,6 +623,7 @@ void App::handleCursorPosEvent(double xpos, double ypos) {
 
 void App::handleScrollEvent(double xoffset, double yoffset) {
     (void)xoffset;
+    m_latency.inputEvent();
     if (!m_io->WantCaptureMouse) {
         double x = m_io->DisplaySize.x * 0.5f;
         double y = m_io->DisplaySize.y * 0.5f;
@@ -411,6 +634,7 @@ void App::handleScrollEvent(double xoffset, double yoffset) {
 }
 
 void App::handleDropEvent(int path_count, const char* paths[]) {
+    RenderThread::Lock lock(m_renderThread);
     for (int i = 0;  i < path_count;  ++i) {
         handleInputFile(paths[i]);
     }
@@ -567,6 +791,13 @@ bool App::handlePCR() {
             return true;  // don't clear the PCR yet
             break;
 
+        case PipelineChangeRequest::Type::BakeLUT:
+            if (validNodeIndex) {
+                bakeLUT(m_pcr.nodeIndex, m_pcr.path.c_str());
+                done = true;
+            }
+            break;
+
         default:
             break;
     }
@@ -638,18 +869,68 @@ bool App::loadPipeline(const char* filename) {
 
 ///////////////////////////////////////////////////////////////////////////////
 
-bool App::uploadImageTexture(uint8_t* data, int width, int height, ImageSource src, bool mustFreeData) {
+bool App::saveHighPrecisionImage(const char* filename, uint32_t extCode, GLuint tex, int width, int height, PixelFormat format) {
+    bool useFloat = (extCode == StringUtil::makeExtCode("pfm"))
+                 || (extCode == StringUtil::makeExtCode("hdr"))
+                 || (isTIFF(extCode) && isFloat(format));
+    size_t count = size_t(width) * size_t(height) * 4u;
+    void* data = malloc(count * (useFloat ? sizeof(float) : sizeof(uint16_t)));
+    if (!data) { return setError("out of memory"); }
+
+    // read the result as-is; the GL converts to the requested type
+    GLutil::clearError();
+    glBindTexture(GL_TEXTURE_2D, tex);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, useFloat ? GL_FLOAT : GL_UNSIGNED_SHORT, data);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    if (GLutil::checkError("saving texture readback")) { ::free(data); return setError("image retrieval failed"); }
+
+    // texture swizzles don't apply to readback, so grayscale results
+    // need to be expanded manually
+    if (isSingleChannel(format)) {
+        for (size_t i = 0;  i < count;  i += 4) {
+            if (useFloat) {
+                float* p = &static_cast<float*>(data)[i];
+                p[1] = p[2] = p[0];  p[3] = 1.0f;
+            } else {
+                uint16_t* p = &static_cast<uint16_t*>(data)[i];
+                p[1] = p[2] = p[0];  p[3] = 0xFFFF;
+            }
+        }
+    }
+
+    bool ok = writeImageFile(filename, extCode, data, width, height, useFloat ? PixelFormat::Float32 : PixelFormat::Int16);
+    ::free(data);
+    return ok;
+}
+
+bool App::uploadImageTexture(void* data, int width, int height, ImageSource src, bool mustFreeData, PixelFormat format, int channels) {
+    GLint glfmt; GLenum dtype;
+    switch (format) {
+        case PixelFormat::Int16:   glfmt = GL_RGBA16;  dtype = GL_UNSIGNED_SHORT; break;
+        case PixelFormat::Float16: glfmt = GL_RGBA16F; dtype = GL_FLOAT;          break;
+        case PixelFormat::Float32: glfmt = GL_RGBA32F; dtype = GL_FLOAT;          break;
+        default:
+            // there are no high-precision sRGB formats, so only 8-bit
+            // images can be tagged as such
+            format = PixelFormat::Int8;
+            glfmt = m_imgSRGB ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+            dtype = GL_UNSIGNED_BYTE;
+            break;
+    }
     GLutil::clearError();
     glBindTexture(GL_TEXTURE_2D, m_imgTex);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+    glTexImage2D(GL_TEXTURE_2D, 0, glfmt, width, height, 0, (channels == 3) ? GL_RGB : GL_RGBA, dtype, data);
     GLenum error = GLutil::checkError("texture upload");
     glBindTexture(GL_TEXTURE_2D, 0);
     glFlush();
     glFinish();
     if (mustFreeData) { ::free(data); }
+    resetTileView();
     m_imgWidth = width;
     m_imgHeight = height;
     m_imgSource = src;
+    m_imgFormat = format;
     m_imgAutofit = true;
     switch (error) {
         case GL_INVALID_ENUM:  return setError("unsupported texture format");
@@ -664,6 +945,70 @@ bool App::uploadImageTexture(uint8_t* data, int width, int height, ImageSource s
     return false;
 }
 
+bool App::uploadMappedImage(const FileUtil::MappedFile& file, const ImageUtil::RawImageInfo& info) {
+    // the pixel data is copied from the file mapping straight into a pixel
+    // buffer object, and the GL takes it from there; the only CPU-side
+    // processing is flipping the rows of bottom-up files
+    GLutil::clearError();
+    GLuint pbo = 0;
+    glGenBuffers(1, &pbo);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+    const uint8_t* src = &file.data()[info.offset];
+    bool mapped = true;
+    if (!info.bottomUp) {
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, GLsizeiptr(info.dataSize()), src, GL_STREAM_DRAW);
+    } else {
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, GLsizeiptr(info.dataSize()), nullptr, GL_STREAM_DRAW);
+        uint8_t* dest = static_cast<uint8_t*>(glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY));
+        if (dest) {
+            const size_t rowSize = info.rowSize();
+            for (int y = info.height - 1;  y >= 0;  --y) {
+                memcpy(dest, &src[size_t(y) * rowSize], rowSize);
+                dest += rowSize;
+            }
+            mapped = (glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_TRUE);
+        } else {
+            mapped = false;
+        }
+    }
+    bool ok = !GLutil::checkError("pixel buffer upload") && mapped;
+    if (ok) {
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glPixelStorei(GL_UNPACK_SWAP_BYTES, info.needsByteSwap() ? GL_TRUE : GL_FALSE);
+        PixelFormat format = (info.bytesPerSample == 4) ? PixelFormat::Float16
+                           : (info.bytesPerSample == 2) ? PixelFormat::Int16
+                           :                              PixelFormat::Int8;
+        ok = uploadImageTexture(nullptr, info.width, info.height, ImageSource::Image, false, format, info.channels);
+        glPixelStorei(GL_UNPACK_SWAP_BYTES, GL_FALSE);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    } else {
+        setError("failed to upload image data");
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glDeleteBuffers(1, &pbo);
+    return ok;
+}
+
+bool App::setImageSRGB(bool srgb) {
+    // the texture contents stay the same, only their interpretation
+    // changes; since GL 3.3 can't re-tag a texture in place, do a
+    // round trip through system memory (the raw data is never converted)
+    m_imgSRGB = srgb;
+    if ((m_imgWidth < 1) || (m_imgHeight < 1) || (m_imgFormat != PixelFormat::Int8)) { return true; }
+    uint8_t *data = (uint8_t*) malloc(m_imgWidth * m_imgHeight * 4);
+    if (!data) { return setError("out of memory"); }
+    GLutil::clearError();
+    glBindTexture(GL_TEXTURE_2D, m_imgTex);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    if (GLutil::checkError("image texture readback")) { ::free(data); return setError("image retrieval failed"); }
+    ImageSource src = m_imgSource;
+    bool autofit = m_imgAutofit;
+    bool ok = uploadImageTexture(data, m_imgWidth, m_imgHeight, src);
+    m_imgAutofit = autofit;
+    return ok;
+}
+
 bool App::loadColor() {
     if ((m_targetImgWidth != m_imgWidth) || (m_targetImgHeight != m_imgHeight)) {
         if (!uploadImageTexture(nullptr, m_targetImgWidth, m_targetImgHeight, ImageSource::Color)) {
@@ -677,6 +1022,106 @@ bool App::loadColor() {
     return setSuccess();
 }
 
+const App::DecodedImage* App::findDecodedImage(const char* path, const FileUtil::FileFingerprint& fp) {
+    for (auto it = m_decodedImages.begin();  it != m_decodedImages.end();  ++it) {
+        if (it->path != path) { continue; }
+        if (!(it->fp == fp)) {
+            // file has been modified since it was decoded
+            if (m_tileViewIO) { resetTileView(); }
+            ::free(it->data);
+            m_decodedImages.erase(it);
+            return nullptr;
+        }
+        m_decodedImages.splice(m_decodedImages.begin(), m_decodedImages, it);
+        return &m_decodedImages.front();
+    }
+    return nullptr;
+}
+
+bool App::cacheDecodedImage(const char* path, const FileUtil::FileFingerprint& fp, void* data, int width, int height, PixelFormat format) {
+    DecodedImage img;
+    img.path = path;
+    img.fp = fp;
+    img.data = data;
+    img.width = width;
+    img.height = height;
+    img.format = format;
+    if (!fp.good() || (img.size() > DecodedImageCacheBudget)) { return false; }
+    for (auto it = m_decodedImages.begin();  it != m_decodedImages.end();  ++it) {
+        if (it->path == img.path) {
+            ::free(it->data);
+            m_decodedImages.erase(it);
+            break;
+        }
+    }
+    m_decodedImages.push_front(img);
+
+    // evict the least recently used images (but never the new one)
+    size_t total = 0;
+    for (const auto& entry : m_decodedImages) { total += entry.size(); }
+    while ((m_decodedImages.size() > 1)
+       && ((total > DecodedImageCacheBudget) || (m_decodedImages.size() > DecodedImageCacheMaxEntries))) {
+        #ifndef NDEBUG
+            fprintf(stderr, "evicting decoded image '%s' from the cache\n", m_decodedImages.back().path.c_str());
+        #endif
+        total -= m_decodedImages.back().size();
+        ::free(m_decodedImages.back().data);
+        m_decodedImages.pop_back();
+    }
+    return true;
+}
+
+void App::clearDecodedImages() {
+    resetTileView();
+    for (auto& entry : m_decodedImages) { ::free(entry.data); }
+    m_decodedImages.clear();
+}
+
+void App::resetTileView() {
+    m_tileView.setSource(nullptr, 0, 0, 0, 0);
+    delete m_tileViewIO;
+    m_tileViewIO = nullptr;
+    m_tileViewFile.close();
+    m_tileViewChecked = false;
+}
+
+void App::prepareTileView() {
+    // the full-resolution source is looked up when the first frame is
+    // drawn after loading an image; it can be either a cached decoded
+    // image or a raw image file that's accessed through a memory mapping
+    // (images that have been decoded row by row can't be used, as they
+    // don't provide random access)
+    if (m_tileViewChecked) { return; }
+    m_tileViewChecked = true;
+    if (!m_tileView.good() || (m_imgSource != ImageSource::Image) || m_clipboardImage || m_imgFilename.empty()) { return; }
+    FileUtil::FileFingerprint fp(m_imgFilename.c_str());
+    const DecodedImage* src = findDecodedImage(m_imgFilename.c_str(), fp);
+    int width = 0, height = 0;
+    if (src) {
+        width = src->width;
+        height = src->height;
+        if ((width > m_imgWidth) || (height > m_imgHeight)) {
+            m_tileViewIO = new MemoryTileIO(src->data, src->width, src->format, nullptr, 0, PixelFormat::Int8);
+        }
+    } else if (m_tileViewFile.open(m_imgFilename.c_str())) {
+        ImageUtil::RawImageInfo info;
+        if (ImageUtil::parseRawImageHeader(m_tileViewFile.data(), m_tileViewFile.size(), info)
+        && ((info.width > m_imgWidth) || (info.height > m_imgHeight))) {
+            width = info.width;
+            height = info.height;
+            m_tileViewIO = new RawImageTileIO(m_tileViewFile.data(), info);
+        } else {
+            m_tileViewFile.close();
+        }
+    }
+    if (m_tileViewIO) {
+        #ifndef NDEBUG
+            fprintf(stderr, "tile view: %dx%d source, %s\n", width, height, src ? "cached" : "memory-mapped");
+        #endif
+        m_tileView.setSource(m_tileViewIO, width, height, m_imgWidth, m_imgHeight);
+    }
+}
+
 bool App::loadImage(const char* filename, bool useClipboard, bool updateClipboard) {
     if (!useClipboard && (!filename || !filename[0])) {
         m_imgFilename.clear();
@@ -692,16 +1137,19 @@ bool App::loadImage(const char* filename, bool useClipboard, bool updateClipboar
             fprintf(stderr, "loading image file '%s'\n", filename);
         }
     #endif
-    uint8_t* rawData = nullptr;
+    void* rawData = nullptr;
     bool mustFreeRawData = false;
     int rawWidth = 0, rawHeight = 0;
+    PixelFormat rawFormat = PixelFormat::Int8;
+    int targetWidth  = m_imgResize ? m_targetImgWidth  : m_imgMaxSize;
+    int targetHeight = m_imgResize ? m_targetImgHeight : m_imgMaxSize;
     if (updateClipboard || (useClipboard && !m_clipboardImage)) {
         ::free(m_clipboardImage);
         m_clipboardImage = Clipboard::getRGBA8Image(m_clipboardWidth, m_clipboardHeight);
         if (!m_clipboardImage) { return setError("failed to import pipeline or image from the clipboard"); }
     }
     if (useClipboard) {
-        rawData = (uint8_t*) m_clipboardImage;
+        rawData = m_clipboardImage;
         if (!rawData) { return false; }
         rawWidth = m_clipboardWidth;
         rawHeight = m_clipboardHeight;
@@ -709,35 +1157,163 @@ bool App::loadImage(const char* filename, bool useClipboard, bool updateClipboar
         m_imgFilename = filename;
         ::free(m_clipboardImage);
         m_clipboardImage = nullptr;
-        rawData = stbi_load(filename, &rawWidth, &rawHeight, nullptr, 4);
-        if (!rawData) { return setError("failed to read image file"); }
-        mustFreeRawData = true;
+        FileUtil::FileFingerprint fp(filename);
+        const DecodedImage* cached = findDecodedImage(filename, fp);
+        if (cached) {
+            #ifndef NDEBUG
+                fprintf(stderr, "using cached decoded image\n");
+            #endif
+            rawData = cached->data;
+            rawWidth = cached->width;
+            rawHeight = cached->height;
+            rawFormat = cached->format;
+        } else {
+            uint32_t extCode = StringUtil::extractExtCode(filename);
+            FileUtil::MappedFile file(filename);
+            ImageUtil::RawImageInfo rawInfo;
+
+            // images that need to be downscaled anyway and are too large
+            // to keep around are decoded row by row and streamed straight
+            // into the GPU resampler, if the format allows it
+            if (file.good() && m_resampler.good()) {
+                ImageUtil::RowReader* reader = ImageUtil::createRowReader(file.data(), file.size());
+                bool stream = reader && ((reader->width() > targetWidth) || (reader->height() > targetHeight))
+                           && ((size_t(reader->height()) * reader->rowSize()) > DecodedImageCacheBudget);
+                bool ok = stream && loadImageStreaming(*reader, targetWidth, targetHeight);
+                delete reader;
+                if (stream) { return ok; }
+            }
+
+            if (extCode == StringUtil::makeExtCode("qoi")) {
+                if (file.good()) {
+                    rawData = ImageUtil::decodeQOI(file.data(), file.size(), rawWidth, rawHeight);
+                }
+                if (!rawData) { return setError("failed to read image file"); }
+            } else if (((extCode == StringUtil::makeExtCode("ppm"))
+                    ||  (extCode == StringUtil::makeExtCode("pnm"))
+                    ||  (extCode == StringUtil::makeExtCode("pam"))
+                    ||  (extCode == StringUtil::makeExtCode("pfm")))
+                    && file.good()
+                    && ImageUtil::parseRawImageHeader(file.data(), file.size(), rawInfo)) {
+                // uncompressed file that the GL can consume as-is
+                #ifndef NDEBUG
+                    fprintf(stderr, "raw %dx%d image, %d channels, %d bytes per sample\n",
+                            rawInfo.width, rawInfo.height, rawInfo.channels, rawInfo.bytesPerSample);
+                #endif
+                if ((rawInfo.width <= targetWidth) && (rawInfo.height <= targetHeight)) {
+                    return uploadMappedImage(file, rawInfo);
+                }
+                rawData = ImageUtil::convertRawImage(file.data(), rawInfo);
+                if (!rawData) { return setError("out of memory"); }
+                rawWidth = rawInfo.width;
+                rawHeight = rawInfo.height;
+                rawFormat = (rawInfo.bytesPerSample == 4) ? PixelFormat::Float32
+                          : (rawInfo.bytesPerSample == 2) ? PixelFormat::Int16
+                          :                                 PixelFormat::Int8;
+            }
+            // only peek into the header first to find out whether the image
+            // has more than 8 bits of precision; if so, keep all of it
+            if (rawData) {
+                // already decoded above
+            } else if (stbi_is_hdr(filename)) {
+                rawData = stbi_loadf(filename, &rawWidth, &rawHeight, nullptr, 4);
+                rawFormat = PixelFormat::Float32;
+            } else if (stbi_is_16_bit(filename)) {
+                rawData = stbi_load_16(filename, &rawWidth, &rawHeight, nullptr, 4);
+                rawFormat = PixelFormat::Int16;
+            } else {
+                rawData = stbi_load(filename, &rawWidth, &rawHeight, nullptr, 4);
+            }
+            if (!rawData) { return setError("failed to read image file"); }
+            // keep the decoded data around for re-targeting
+            mustFreeRawData = !cacheDecodedImage(filename, fp, rawData, rawWidth, rawHeight, rawFormat);
+        }
     }
-    int targetWidth  = m_imgResize ? m_targetImgWidth  : m_imgMaxSize;
-    int targetHeight = m_imgResize ? m_targetImgHeight : m_imgMaxSize;
+    #ifndef NDEBUG
+        if (rawFormat != PixelFormat::Int8) {
+            fprintf(stderr, "image has %s format\n", pixelFormatName(rawFormat));
+        }
+    #endif
+    // HDR data is uploaded as half-float, which is more precise than the
+    // 8-bit mantissa of Radiance files anyway
+    PixelFormat texFormat = (rawFormat == PixelFormat::Float32) ? PixelFormat::Float16 : rawFormat;
     if ((rawWidth <= targetWidth) && (rawHeight <= targetHeight)) {
-        return uploadImageTexture(rawData, rawWidth, rawHeight, ImageSource::Image, mustFreeRawData);
+        return uploadImageTexture(rawData, rawWidth, rawHeight, ImageSource::Image, mustFreeRawData, texFormat);
     }
-    int scaledWidth  = targetWidth;
-    int scaledHeight = (rawHeight * scaledWidth + (rawWidth / 2)) / rawWidth;
-    if (scaledHeight > targetHeight) {
-        scaledHeight = targetHeight;
-        scaledWidth = (rawWidth * scaledHeight + (rawHeight / 2)) / rawHeight;
+    int scaledWidth, scaledHeight;
+    fitImageSize(rawWidth, rawHeight, targetWidth, targetHeight, scaledWidth, scaledHeight);
+
+    // preferably, let the GPU do the heavy lifting
+    if (m_resampler.good()) {
+        bool ok = uploadImageTexture(nullptr, scaledWidth, scaledHeight, ImageSource::Image, false, texFormat)
+               && m_resampler.resampleImage(rawData, rawWidth, rawHeight, rawFormat, m_imgTex, scaledWidth, scaledHeight, m_resampleFilter);
+        if (ok) {
+            if (mustFreeRawData) { ::free(rawData); }
+            return setSuccess();
+        }
+        #ifndef NDEBUG
+            fprintf(stderr, "GPU resampling failed, falling back to the CPU\n");
+        #endif
     }
+
     #ifndef NDEBUG
         fprintf(stderr, "downscaling %dx%d -> %dx%d\n", rawWidth, rawHeight, scaledWidth, scaledHeight);
     #endif
-    uint8_t* scaledData = (uint8_t*) malloc(scaledWidth * scaledHeight * 4);
+    void* scaledData = malloc(size_t(scaledWidth) * size_t(scaledHeight) * size_t(getBytesPerPixel(rawFormat)));
     if (!scaledData) {
         if (mustFreeRawData) { ::free(rawData); }
         return setError("out of memory");
     }
-    if (!stbir_resize_uint8(
-           rawData,    rawWidth,    rawHeight, 0,
-        scaledData, scaledWidth, scaledHeight, 0,
-        4)) { ::free(rawData); return setError("could not downscale image"); }
+    int res;
+    switch (rawFormat) {
+        case PixelFormat::Int16:
+            res = stbir_resize_uint16_generic(
+                (const uint16_t*) rawData,    rawWidth,    rawHeight, 0,
+                (uint16_t*)    scaledData, scaledWidth, scaledHeight, 0,
+                4, 3, 0, STBIR_EDGE_CLAMP, STBIR_FILTER_DEFAULT, STBIR_COLORSPACE_LINEAR, nullptr);
+            break;
+        case PixelFormat::Float32:
+            res = stbir_resize_float(
+                (const float*) rawData,    rawWidth,    rawHeight, 0,
+                (float*)    scaledData, scaledWidth, scaledHeight, 0,
+                4);
+            break;
+        default:
+            res = stbir_resize_uint8(
+                (const uint8_t*) rawData,    rawWidth,    rawHeight, 0,
+                (uint8_t*)    scaledData, scaledWidth, scaledHeight, 0,
+                4);
+            break;
+    }
     if (mustFreeRawData) { ::free(rawData); }
-    return uploadImageTexture(scaledData, scaledWidth, scaledHeight, ImageSource::Image);
+    if (!res) { ::free(scaledData); return setError("could not downscale image"); }
+    return uploadImageTexture(scaledData, scaledWidth, scaledHeight, ImageSource::Image, true, texFormat);
+}
+
+void App::fitImageSize(int width, int height, int maxWidth, int maxHeight, int& fitWidth, int& fitHeight) {
+    fitWidth  = maxWidth;
+    fitHeight = int((int64_t(height) * fitWidth + (width / 2)) / width);
+    if (fitHeight > maxHeight) {
+        fitHeight = maxHeight;
+        fitWidth = int((int64_t(width) * fitHeight + (height / 2)) / height);
+    }
+    fitWidth  = std::max(fitWidth,  1);
+    fitHeight = std::max(fitHeight, 1);
+}
+
+bool App::loadImageStreaming(ImageUtil::RowReader& reader, int targetWidth, int targetHeight) {
+    int scaledWidth, scaledHeight;
+    fitImageSize(reader.width(), reader.height(), targetWidth, targetHeight, scaledWidth, scaledHeight);
+    PixelFormat texFormat = (reader.bytesPerSample() == 4) ? PixelFormat::Float16
+                          : (reader.bytesPerSample() == 2) ? PixelFormat::Int16
+                          :                                  PixelFormat::Int8;
+    if (!uploadImageTexture(nullptr, scaledWidth, scaledHeight, ImageSource::Image, false, texFormat)) {
+        return false;
+    }
+    if (!m_resampler.resampleRows(reader, m_imgTex, scaledWidth, scaledHeight, m_resampleFilter)) {
+        return setError("failed to decode image file");
+    }
+    return setSuccess();
 }
 
 bool App::loadPattern() {
@@ -804,37 +1380,89 @@ bool App::saveFile(const char* filename, bool toClipboard) {
         m_lastSaveFilename = filename;
     }
 
+    // if the image has been downscaled on loading, the pipeline can
+    // optionally be run again on the original in tiles
+    uint32_t extCode = toClipboard ? 0 : StringUtil::extractExtCode(filename);
+    if (saveImage && !toClipboard && m_exportFullRes && (m_imgSource == ImageSource::Image)) {
+        return saveFullResolution(filename, extCode);
+    }
+
+    // optionally resample the result to the export size first
+    GLuint outTex = m_resultTex;
+    int outWidth  = m_imgWidth;
+    int outHeight = m_imgHeight;
+    PixelFormat outFormat = m_resultFormat;
+    struct TextureHolder {
+        GLuint tex = 0;
+        inline ~TextureHolder() { if (tex) { glDeleteTextures(1, &tex); } }
+    } scaled;
+    if (saveImage && (m_exportPercent < 100)) {
+        outWidth  = std::max((m_imgWidth  * m_exportPercent + 50) / 100, 1);
+        outHeight = std::max((m_imgHeight * m_exportPercent + 50) / 100, 1);
+        // keep the precision class of the result; sRGB results are
+        // resampled in linear light and re-encoded by the GL
+        GLint glfmt = isHighPrecision(outFormat) ? GL_RGBA32F
+                    : (outFormat == PixelFormat::SRGB8) ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+        outFormat   = isHighPrecision(outFormat) ? PixelFormat::Float32
+                    : (outFormat == PixelFormat::SRGB8) ? PixelFormat::SRGB8 : PixelFormat::Int8;
+        GLutil::clearError();
+        glGenTextures(1, &scaled.tex);
+        glBindTexture(GL_TEXTURE_2D, scaled.tex);
+        glTexImage2D(GL_TEXTURE_2D, 0, glfmt, outWidth, outHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        if (GLutil::checkError("export texture creation")) { return setError("failed to create temporary texture for saving"); }
+        if (outFormat == PixelFormat::SRGB8) { glEnable(GL_FRAMEBUFFER_SRGB); }
+        bool ok = m_resampler.resampleTexture(outTex, m_imgWidth, m_imgHeight, scaled.tex, outWidth, outHeight, m_resampleFilter);
+        glDisable(GL_FRAMEBUFFER_SRGB);
+        if (!ok) { return setError("failed to resample the image for saving"); }
+        outTex = scaled.tex;
+        #ifndef NDEBUG
+            fprintf(stderr, "exporting at %d%% size: %dx%d\n", m_exportPercent, outWidth, outHeight);
+        #endif
+    }
+
+    // high-precision formats are read directly from the result texture
+    if (saveImage && ((extCode == StringUtil::makeExtCode("pam"))
+                  ||  (extCode == StringUtil::makeExtCode("pfm"))
+                  ||  (extCode == StringUtil::makeExtCode("hdr"))
+                  || (((extCode == StringUtil::makeExtCode("png")) || isTIFF(extCode)) && isHighPrecision(outFormat)))) {
+        return saveHighPrecisionImage(filename, extCode, outTex, outWidth, outHeight, outFormat);
+    }
+
     if (saveImage) {
         GLuint tex = 0;
-        bool needStagingTexture = (m_pipeline.format() != PixelFormat::Int8);
+        // 8-bit results can be read directly; this includes sRGB,
+        // as reading back an sRGB texture doesn't decode it
+        bool needStagingTexture = (outFormat != PixelFormat::Int8)
+                               && (outFormat != PixelFormat::SRGB8);
 
         if (needStagingTexture) {
             // create staging texture
             GLutil::clearError();
             glGenTextures(1, &tex);
             glBindTexture(GL_TEXTURE_2D, tex);
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, m_imgWidth, m_imgHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, outWidth, outHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
             if (GLutil::checkError("saving texture creation")) { return setError("failed to create temporary texture for saving"); }
 
             // copy result into staging texture
             m_renderDirect.prog.use();
-            glBindTexture(GL_TEXTURE_2D, m_pipeline.resultTex());
+            glBindTexture(GL_TEXTURE_2D, outTex);
             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
             glUniform4f(m_renderDirect.areaLoc, -1.0f, -1.0f, 2.0f, 2.0f);
-            glViewport(0, 0, m_imgWidth, m_imgHeight);
+            glViewport(0, 0, outWidth, outHeight);
             if (GLutil::checkError("saving render preparation")) { return setError("image retrieval failed"); }
             m_helperFBO.begin(tex);
             glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
             m_helperFBO.end();
             if (GLutil::checkError("saving render draw operation")) { return setError("image retrieval failed"); }
         } else {
-            // pipeline runs in 8-bit integer mode -> can read the source directly
-            tex = m_pipeline.resultTex();
+            // pipeline runs in 8-bit (sRGB) integer mode -> can read the source directly
+            tex = outTex;
         }
 
         // read image data from the texture
-        uint8_t *data = (uint8_t*) malloc(m_imgWidth * m_imgHeight * 4);
+        uint8_t *data = (uint8_t*) malloc(outWidth * outHeight * 4);
         if (!data) { return setError("out of memory"); }
         glBindTexture(GL_TEXTURE_2D, tex);
         glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
@@ -846,33 +1474,14 @@ bool App::saveFile(const char* filename, bool toClipboard) {
 
         // save the image
         if (toClipboard) {
-            bool ok = Clipboard::setRGBA8ImageAndText(data, m_imgWidth, m_imgHeight, savePipeline.c_str(), int(savePipeline.size()));
+            bool ok = Clipboard::setRGBA8ImageAndText(data, outWidth, outHeight, savePipeline.c_str(), int(savePipeline.size()));
             ::free(data);
             if (ok) { return setSuccess("pipeline and image copied into the clipboard"); }
             else    { return setError("failed to set clipboard contents"); }
         } else {
-            int res;
-            switch (StringUtil::extractExtCode(filename)) {
-                case StringUtil::makeExtCode("jpg"):
-                case StringUtil::makeExtCode("jpeg"):
-                case StringUtil::makeExtCode("jpe"):
-                    res = stbi_write_jpg(filename, m_imgWidth, m_imgHeight, 4, data, 98);
-                    break;
-                case StringUtil::makeExtCode("png"):
-                    res = stbi_write_png(filename, m_imgWidth, m_imgHeight, 4, data, 0);
-                    break;
-                case StringUtil::makeExtCode("tga"):
-                    res = stbi_write_tga(filename, m_imgWidth, m_imgHeight, 4, data);
-                    break;
-                case StringUtil::makeExtCode("bmp"):
-                    res = stbi_write_bmp(filename, m_imgWidth, m_imgHeight, 4, data);
-                    break;
-                default:
-                    ::free(data); return setError("unrecognized output file format");
-            }
+            bool ok = writeImageFile(filename, extCode, data, outWidth, outHeight, PixelFormat::Int8);
             ::free(data);
-            if (res == 0) { return setError("image saving failed"); }
-            return setSuccess("image saved");
+            return ok;
         }
     } else if (!savePipeline.empty()) {
         bool ok = false;
@@ -887,6 +1496,169 @@ bool App::saveFile(const char* filename, bool toClipboard) {
     else { return false; /* unreachable */ }
 }
 
+bool App::saveFullResolution(const char* filename, uint32_t extCode) {
+    FileUtil::FileFingerprint fp(m_imgFilename.c_str());
+    const DecodedImage* src = findDecodedImage(m_imgFilename.c_str(), fp);
+
+    // use the best precision that the file format and the result allow
+    PixelFormat resultFormat = m_resultFormat;
+    m_pipeline.latchParameters();
+    bool highPrecision = isHighPrecision(resultFormat);
+    PixelFormat format = ((extCode == StringUtil::makeExtCode("pfm")) || (extCode == StringUtil::makeExtCode("hdr"))) ? PixelFormat::Float32
+                       : (isTIFF(extCode) && isFloat(resultFormat)) ? PixelFormat::Float32
+                       : ((extCode == StringUtil::makeExtCode("pam")) || (((extCode == StringUtil::makeExtCode("png")) || isTIFF(extCode)) && highPrecision)) ? PixelFormat::Int16
+                       : PixelFormat::Int8;
+
+    // PNG, TIFF and PAM files are written stripe by stripe while rendering,
+    // so the result never needs to be in memory as a whole; the source is
+    // decoded row by row too if it isn't in the cache
+    ImageUtil::RowWriter* (*createWriter)(const char*, int, int, int)
+        = (extCode == StringUtil::makeExtCode("png")) ? ImageUtil::createPNGWriter
+        : isTIFF(extCode)                             ? ImageUtil::createTIFFWriter
+        : (extCode == StringUtil::makeExtCode("pam")) ? ImageUtil::createPAMWriter
+        : nullptr;
+    if (createWriter) {
+        FileUtil::MappedFile file;
+        ImageUtil::RowReader* reader = nullptr;
+        if (!src && file.open(m_imgFilename.c_str())) {
+            reader = ImageUtil::createRowReader(file.data(), file.size());
+        }
+        if (src || reader) {
+            int width  = src ? src->width  : reader->width();
+            int height = src ? src->height : reader->height();
+            const char* tilingError = m_pipeline.checkTiling(width, height, m_showIndex);
+            if (tilingError) { delete reader;  return setError(tilingError); }
+            #ifndef NDEBUG
+                fprintf(stderr, "streaming export at full resolution: %dx%d, %s, source %s\n",
+                        width, height, pixelFormatName(format), src ? "cached" : "decoded row by row");
+            #endif
+            ImageUtil::RowWriter* writer = createWriter(filename, width, height, getBytesPerPixel(format) / 4);
+            bool ok = !!writer;
+            if (ok) {
+                StreamingTileIO* io = src ? new StreamingTileIO(src->data, src->width, src->format, *writer)
+                                          : new StreamingTileIO(*reader, *writer);
+                ok = m_pipeline.renderTiled(*io, width, height, processingFormat(), m_showIndex);
+                ok = io->finish() && ok;
+                delete io;
+                delete writer;
+            }
+            delete reader;
+            if (!ok) { return setError("full-resolution rendering failed"); }
+            return setSuccess("image saved");
+        }
+    }
+    if (!src) {
+        return setError("the full-resolution source image isn't available");
+    }
+    const char* tilingError = m_pipeline.checkTiling(src->width, src->height, m_showIndex);
+    if (tilingError) { return setError(tilingError); }
+    #ifndef NDEBUG
+        fprintf(stderr, "exporting at full resolution: %dx%d, %s\n", src->width, src->height, pixelFormatName(format));
+    #endif
+    void* data = malloc(size_t(src->width) * size_t(src->height) * size_t(getBytesPerPixel(format)));
+    if (!data) { return setError("out of memory"); }
+    int width = src->width, height = src->height;
+    bool ok;
+    {
+        MemoryTileIO io(src->data, src->width, src->format, data, src->width, format);
+        ok = m_pipeline.renderTiled(io, src->width, src->height, processingFormat(), m_showIndex);
+    }
+    if (!ok) { ::free(data); return setError("full-resolution rendering failed"); }
+    ok = writeImageFile(filename, extCode, data, width, height, format);
+    ::free(data);
+    return ok;
+}
+
+bool App::writeImageFile(const char* filename, uint32_t extCode, const void* data, int width, int height, PixelFormat format) {
+    bool ok;
+    if (isTIFF(extCode)) {
+        ImageUtil::RowWriter* writer = ImageUtil::createTIFFWriter(filename, width, height, getBytesPerPixel(format) / 4);
+        ok = writer && writer->writeRows(data, height) && writer->finish();
+        delete writer;
+    } else if (format == PixelFormat::Float32) {
+        if (extCode == StringUtil::makeExtCode("pfm")) {
+            ok = ImageUtil::writePFM(filename, width, height, static_cast<const float*>(data));
+        } else {
+            ok = !!stbi_write_hdr(filename, width, height, 4, static_cast<const float*>(data));
+        }
+    } else if (format == PixelFormat::Int16) {
+        if (extCode == StringUtil::makeExtCode("pam")) {
+            ok = ImageUtil::writePAM16(filename, width, height, static_cast<const uint16_t*>(data));
+        } else {
+            ok = ImageUtil::writePNG16(filename, width, height, static_cast<const uint16_t*>(data));
+        }
+    } else {
+        switch (extCode) {
+            case StringUtil::makeExtCode("jpg"):
+            case StringUtil::makeExtCode("jpeg"):
+            case StringUtil::makeExtCode("jpe"):
+                ok = !!stbi_write_jpg(filename, width, height, 4, data, 98);
+                break;
+            case StringUtil::makeExtCode("png"):
+                ok = !!stbi_write_png(filename, width, height, 4, data, 0);
+                break;
+            case StringUtil::makeExtCode("tga"):
+                ok = !!stbi_write_tga(filename, width, height, 4, data);
+                break;
+            case StringUtil::makeExtCode("bmp"):
+                ok = !!stbi_write_bmp(filename, width, height, 4, data);
+                break;
+            case StringUtil::makeExtCode("qoi"):
+                ok = ImageUtil::writeQOI(filename, width, height, static_cast<const uint8_t*>(data));
+                break;
+            default:
+                return setError("unrecognized output file format");
+        }
+    }
+    if (!ok) { return setError("image saving failed"); }
+    return setSuccess("image saved");
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool App::bakeLUT(int nodeIndex, const char* filename) {
+    constexpr int lutSize = 65;
+
+    // find the run of active color-only nodes around the selected one
+    const auto bakeable = [&] (int i) -> bool {
+        const Node& n = m_pipeline.node(i);
+        return n.good() && n.enabled() && n.pointwise();
+    };
+    int first = nodeIndex - 1;
+    if (!bakeable(first)) {
+        return setError("only enabled color-only nodes can be baked into a LUT");
+    }
+    int last = first;
+    while ((first > 0) && bakeable(first - 1)) { --first; }
+    while (((last + 1) < m_pipeline.nodeCount()) && bakeable(last + 1)) { ++last; }
+    #ifndef NDEBUG
+        fprintf(stderr, "baking nodes %d-%d into '%s'\n", first + 1, last + 1, filename);
+    #endif
+
+    // bake and save the LUT
+    LUT3D lut;
+    if (!m_pipeline.bakeLUT(lut, lutSize, first, last - first + 1)) {
+        return setError("LUT baking failed");
+    }
+    if (!lut.save(filename)) {
+        return setError("failed to save LUT file");
+    }
+
+    // replace the nodes by the LUT
+    for (int i = first;  i <= last;  ++i) {
+        m_pipeline.removeNode(first);
+    }
+    if (!m_pipeline.addNode(filename, first)) {
+        return setError("failed to load baked LUT");
+    }
+    if (m_showIndex > (last + 1)) {
+        m_showIndex -= last - first;
+    } else if (m_showIndex > first) {
+        m_showIndex = first + 1;
+    }
+    return setSuccess(std::to_string(last - first + 1) + " nodes baked into a LUT");
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 
 void App::startAutoTest(const char* scanDir) {
@@ -902,6 +1674,7 @@ void App::startAutoTest(const char* scanDir) {
             fprintf(stderr, "[AutoTest] starting, %d shaders queued\n", m_autoTestTotal);
         #endif
         setMessage("AutoTest: testing " + std::to_string(m_autoTestTotal) + " shaders");
+        RenderThread::Lock lock(m_renderThread);
         m_pipeline.clear();
         requestFrames(2);
         return;
@@ -15,8 +15,13 @@
 #include "imgui.h"
 
 #include "string_util.h"
+#include "image_util.h"
 
 #include "gips_core.h"
+#include "gips_resample.h"
+#include "gips_tileview.h"
+#include "gips_renderthread.h"
+#include "gips_latency.h"
 
 namespace GIPS {
 
@@ -71,16 +76,74 @@ private:
     int m_imgWidth = 0;
     int m_imgHeight = 0;
     int m_imgMaxSize = 1024;
+    bool m_imgSRGB = false;  //!< image texture is stored as GL_SRGB8_ALPHA8
+    PixelFormat m_imgFormat = PixelFormat::Int8;  //!< format of the image texture
+
+    // cache of decoded source image files, so changing the target size
+    // doesn't require decoding the file again
+    struct DecodedImage {
+        std::string path;
+        FileUtil::FileFingerprint fp;
+        void* data = nullptr;  //!< RGBA data, owned by the cache
+        int width = 0;
+        int height = 0;
+        PixelFormat format = PixelFormat::Int8;  //!< Int8, Int16 or Float32
+        inline size_t size() const
+            { return size_t(width) * size_t(height) * size_t(getBytesPerPixel(format)); }
+    };
+    std::list<DecodedImage> m_decodedImages;  //!< most recently used first
+    const DecodedImage* findDecodedImage(const char* path, const FileUtil::FileFingerprint& fp);
+    bool cacheDecodedImage(const char* path, const FileUtil::FileFingerprint& fp, void* data, int width, int height, PixelFormat format);
+    void clearDecodedImages();
 
     // rendering resources
     struct RenderProgram {
         GLutil::Program prog;
         GLint areaLoc = -1;
+        GLint encodeLoc = -1;
         bool init(GLuint vs, const char* desc, const char *fsSource);
     };
     RenderProgram m_renderDirect;
     RenderProgram m_renderWithAlpha;
     GLutil::FBO m_helperFBO;
+    Resampler m_resampler;
+    ResampleFilter m_resampleFilter = ResampleFilter::Mitchell;
+    int m_exportPercent = 100;  //!< size of saved images relative to the result
+    bool m_exportFullRes = false;  //!< save images at the source file's resolution
+
+    // display of the result at the source file's resolution when zooming in
+    TileViewer m_tileView;
+    TileIO* m_tileViewIO = nullptr;
+    FileUtil::MappedFile m_tileViewFile;
+    bool m_tileViewChecked = false;  //!< the full-resolution source has been looked up
+    void prepareTileView();
+    void resetTileView();
+
+    // the composited image view is cached in a screen-sized texture and
+    // only drawn again if the result or the view geometry changed
+    struct ViewState {
+        GLuint resultTex = 0;
+        int width = 0;
+        int height = 0;
+        int x0 = 0;
+        int y0 = 0;
+        float zoom = 0.0f;
+        bool alpha = false;
+        bool tiled = false;
+        inline bool operator== (const ViewState& other) const {
+            return (resultTex == other.resultTex) && (width == other.width) && (height == other.height)
+                && (x0 == other.x0) && (y0 == other.y0) && (zoom == other.zoom)
+                && (alpha == other.alpha) && (tiled == other.tiled);
+        }
+    };
+    ViewState m_viewState;
+    bool m_viewValid = false;
+    GLuint m_viewTex = 0;
+    int m_viewTexWidth = 0;
+    int m_viewTexHeight = 0;
+    GLutil::FBO m_viewFBO;
+    GLuint m_mipmappedTex = 0;  //!< result texture that has an up-to-date mip chain
+    void drawImage();
 
     // GL information
     std::string m_glVendor;
@@ -91,6 +154,23 @@ private:
     Pipeline m_pipeline;
     int m_showIndex = 0;
     PixelFormat m_requestedFormat = PixelFormat::DontCare;
+    //! the format to actually process the current image with (sRGB
+    //! processing isn't possible for high-precision images)
+    inline PixelFormat processingFormat() const
+        { return m_pipeline.adjustFormatForSource(m_requestedFormat, m_imgFormat); }
+
+    // the pipeline runs in a separate thread; the UI displays a copy of
+    // the last completed result
+    RenderThread m_renderThread;
+    unsigned m_renderGeneration = 0;     //!< incremented on every pipeline change
+    unsigned m_requestedGeneration = 0;  //!< generation of the last render request
+    GLuint m_resultTex = 0;
+    PixelFormat m_resultFormat = PixelFormat::Int8;
+    void updateResult();
+    void acquireResult();
+    inline bool resultCurrent()
+        { return (m_requestedGeneration == m_renderGeneration) && !m_renderThread.busy(); }
+    LatencyTracker m_latency;
 
     // image geometry, zoom&pan
     int m_imgX0 = 0;
@@ -130,10 +210,11 @@ private:
             SaveFile,
             LoadClipboard,
             SaveClipboard,
+            BakeLUT,
         } type = Type::None;
         int nodeIndex = 0;    //!< node index (1-based) for all operations
         int targetIndex = 0;  //!< target index (for MoveNode only)
-        std::string path;     //!< path to load (for LoadNode and SaveFile only)
+        std::string path;     //!< path to load (for LoadNode, SaveFile and BakeLUT only)
     } m_pcr;
 
     // auto-test mode
@@ -147,6 +228,12 @@ private:
     // initialization
     void setPaths(const char* argv0);
 
+    // processing daemon mode (implemented in gips_server_posix.cpp;
+    // not available on Windows)
+    #ifndef _WIN32
+        int runServer(const char* socketPath);
+    #endif
+
     // event and PCR handling
     void handleKeyEvent(int key, int scancode, int action, int mods);
     void handleMouseButtonEvent(int button, int action, int mods);
@@ -164,14 +251,24 @@ private:
     bool loadPipeline(const char* filename);
 
     // image source modification functions
-    bool uploadImageTexture(uint8_t* data, int width, int height, ImageSource src, bool mustFreeData=true);
+    bool uploadImageTexture(void* data, int width, int height, ImageSource src, bool mustFreeData=true, PixelFormat format=PixelFormat::Int8, int channels=4);
+    bool uploadMappedImage(const FileUtil::MappedFile& file, const ImageUtil::RawImageInfo& info);
+    bool setImageSRGB(bool srgb);
+    bool saveHighPrecisionImage(const char* filename, uint32_t extCode, GLuint tex, int width, int height, PixelFormat format);
     bool loadColor();
     bool loadImage(const char* filename, bool useClipboard=false, bool updateClipboard=false);
+    bool loadImageStreaming(ImageUtil::RowReader& reader, int targetWidth, int targetHeight);
+    static void fitImageSize(int width, int height, int maxWidth, int maxHeight, int& fitWidth, int& fitHeight);
     bool loadPattern();
     bool updateImage();
 
     // pipeline and image result saving
     bool saveFile(const char* filename, bool toClipboard=false);
+    bool saveFullResolution(const char* filename, uint32_t extCode);
+    bool writeImageFile(const char* filename, uint32_t extCode, const void* data, int width, int height, PixelFormat format);
+
+    // color chain baking
+    bool bakeLUT(int nodeIndex, const char* filename);
 
     // auto-test mode implementation
     void startAutoTest(const char* scanDir=nullptr);
@@ -218,6 +315,8 @@ public:
         { m_pcr.type = PipelineChangeRequest::Type::LoadClipboard; }
     inline void requestSaveClipboard()
         { m_pcr.type = PipelineChangeRequest::Type::SaveClipboard; }
+    inline void requestBakeLUT(int nodeIndex, const char* filename)
+        { m_pcr.type = PipelineChangeRequest::Type::BakeLUT; m_pcr.nodeIndex = nodeIndex; m_pcr.path = filename; }
 
     inline void requestFrames(int n)
         { if (n > m_renderFrames) { m_renderFrames = n; } }
@@ -255,6 +354,9 @@ public:
     static bool isSaveImageFile(uint32_t extCode);
     static inline bool isSaveImageFile(const char* filename)
         { return isSaveImageFile(StringUtil::extractExtCode(filename)); }
+
+    static inline bool isTIFF(uint32_t extCode)
+        { return (extCode == StringUtil::makeExtCode("tif")) || (extCode == StringUtil::makeExtCode("tiff")); }
 };
 
 ///////////////////////////////////////////////////////////////////////////////
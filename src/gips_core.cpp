@@ -17,15 +17,26 @@
 #include "gl_util.h"
 
 #include "file_util.h"
+#include "image_util.h"
 
 #include "gips_core.h"
 
 namespace GIPS {
 
+constexpr int MaxTileSize = 4096;  //!< keeps the intermediate buffers of a tile reasonably small
+constexpr int MinTileSize = 256;   //!< don't go below this after running out of memory
+constexpr int TileAlign = 16;      //!< granularity of tile overlaps
+constexpr int InitialSlicePixels = 262144;  //!< size of the first band of a pass with unknown cost
+constexpr int MinSliceRows = 8;    //!< don't draw bands that are thinner than this
+
 ///////////////////////////////////////////////////////////////////////////////
 
 int getBytesPerPixel(PixelFormat fmt) {
     switch (fmt) {
+        case PixelFormat::Gray8:
+            return 1;
+        case PixelFormat::Gray16F:
+            return 2;
         case PixelFormat::Int16:
         case PixelFormat::Float16:
             return 8;
@@ -39,6 +50,11 @@ int getBytesPerPixel(PixelFormat fmt) {
 const char* pixelFormatName(PixelFormat fmt) {
     switch (fmt) {
         case PixelFormat::DontCare: return "don't care";
+        case PixelFormat::Gray8:    return "8-bit integer, grayscale";
+        case PixelFormat::Gray16F:  return "16-bit floating point, grayscale";
+        case PixelFormat::SRGB8:    return "8-bit sRGB, linear light";
+        case PixelFormat::RGB10A2:  return "10-bit integer, 2-bit alpha";
+        case PixelFormat::RGB11F:   return "11/10-bit floating point, no alpha";
         case PixelFormat::Int16:    return "16-bit integer";
         case PixelFormat::Float16:  return "16-bit floating point";
         case PixelFormat::Float32:  return "32-bit floating point";
@@ -46,6 +62,50 @@ const char* pixelFormatName(PixelFormat fmt) {
     }
 }
 
+//! what a pixel format can store
+struct FormatCaps {
+    PixelFormat format;
+    bool color;
+    bool srgb;
+    bool isFloat;
+    int bits;       //!< color precision
+    int alphaBits;
+};
+//! all formats, from the cheapest to the most expensive one
+static const FormatCaps formatCaps[] = {
+    { PixelFormat::Gray8,   false, false, false,  8,  0 },
+    { PixelFormat::Gray16F, false, false, true,  16,  0 },
+    { PixelFormat::Int8,    true,  false, false,  8,  8 },
+    { PixelFormat::SRGB8,   true,  true,  false,  8,  8 },
+    { PixelFormat::RGB10A2, true,  false, false, 10,  2 },
+    { PixelFormat::Int16,   true,  false, false, 16, 16 },
+    { PixelFormat::RGB11F,  true,  false, true,  11,  0 },
+    { PixelFormat::Float16, true,  false, true,  16, 16 },
+    { PixelFormat::Float32, true,  false, true,  32, 32 },
+};
+
+PixelFormat mergePixelFormats(PixelFormat a, PixelFormat b) {
+    if (a == PixelFormat::DontCare) { return b; }
+    if ((b == PixelFormat::DontCare) || (a == b)) { return a; }
+    const FormatCaps* ca = nullptr;
+    const FormatCaps* cb = nullptr;
+    for (const auto& c : formatCaps) {
+        if (c.format == a) { ca = &c; }
+        if (c.format == b) { cb = &c; }
+    }
+    if (!ca || !cb) { return PixelFormat::Int8; }
+    for (const auto& c : formatCaps) {
+        if ((c.color   || !(ca->color   || cb->color))
+        &&  (c.srgb    == (ca->srgb     && cb->srgb))
+        &&  (c.isFloat || !(ca->isFloat || cb->isFloat))
+        &&  (c.bits      >= std::max(ca->bits,      cb->bits))
+        &&  (c.alphaBits >= std::max(ca->alphaBits, cb->alphaBits))) {
+            return c.format;
+        }
+    }
+    return PixelFormat::Float32;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 
 bool Parameter::changed() {
@@ -64,6 +124,9 @@ bool Node::changed() {
     for (size_t i = 0;  i < m_params.size();  ++i) {
         if (m_params[i].changed()) { res = true; }
     }
+    // the cache is invalidated when the new values are latched, as
+    // it may be in use by a render in progress
+    if (res) { m_invalidateCache = true; }
     return res;
 }
 
@@ -76,6 +139,21 @@ bool Pipeline::changed() {
     return res;
 }
 
+void Pipeline::latchParameters() {
+    for (auto node : m_nodes) {
+        node->m_renderEnabled = node->m_enabled;
+        for (auto& param : node->m_params) {
+            for (int i = 0;  i < 4;  ++i) {
+                param.m_renderValue[i] = param.m_value[i];
+            }
+        }
+        if (node->m_invalidateCache) {
+            node->m_cacheValid = false;
+            node->m_invalidateCache = false;
+        }
+    }
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 
 void Parameter::reset() {
@@ -108,6 +186,62 @@ void Pipeline::reload(bool force) {
     }
 }
 
+bool Parameter::atIdentity() const {
+    return atIdentity(m_value);
+}
+
+bool Parameter::atIdentity(const float* value) const {
+    if (!m_hasIdentity) { return false; }
+    int count;
+    switch (m_type) {
+        case ParameterType::Value2: count = 2; break;
+        case ParameterType::Value3:
+        case ParameterType::RGB:    count = 3; break;
+        case ParameterType::Value4:
+        case ParameterType::RGBA:   count = 4; break;
+        default:                    count = 1; break;
+    }
+    for (int i = 0;  i < count;  ++i) {
+        float tolerance = 1.0E-6f * std::max(1.0f, std::abs(m_identityValue[i]));
+        if (std::abs(value[i] - m_identityValue[i]) > tolerance) { return false; }
+    }
+    return true;
+}
+
+bool Node::isIdentity() const {
+    bool anyIdentity = false;
+    for (const auto& p : m_params) {
+        if (!p.m_hasIdentity) { continue; }
+        if (!p.atIdentity()) { return false; }
+        anyIdentity = true;
+    }
+    return anyIdentity;
+}
+
+bool Node::renderIdentity() const {
+    bool anyIdentity = false;
+    for (const auto& p : m_params) {
+        if (!p.m_hasIdentity) { continue; }
+        if (!p.atIdentity(p.m_renderValue)) { return false; }
+        anyIdentity = true;
+    }
+    return anyIdentity;
+}
+
+int Node::halo() const {
+    if (m_halo >= 0) { return m_halo; }
+    // distortions and passes that run at another resolution or sample
+    // mipmaps may read from anywhere in the image; without a declared
+    // halo, there's no telling how much of it they need
+    if (m_isMap) { return -1; }
+    for (const auto& pass : m_passes) {
+        if ((pass.scale != 1.0f) || pass.mipmap) { return -1; }
+    }
+    // color-only nodes and single-pass generators never look at
+    // neighboring pixels; everything else might
+    return (m_pixelLocal || (m_inputIndependent && (m_passCount == 1))) ? 0 : DefaultTileHalo;
+}
+
 Parameter* Node::findParam(const char* name) {
     for (size_t i = 0;  i < m_params.size();  ++i) {
         if (!strcmp(name, m_params[i].m_name.c_str())) { return &m_params[i]; }
@@ -116,13 +250,31 @@ Parameter* Node::findParam(const char* name) {
 }
 
 PixelFormat Pipeline::detectFormat() const {
-    PixelFormat fmt = PixelFormat::Int8;
+    PixelFormat fmt = PixelFormat::DontCare;
     for (size_t i = 0;  i < m_nodes.size();  ++i) {
-        if (m_nodes[i]->m_preferredFormat > fmt) {
-            fmt = m_nodes[i]->m_preferredFormat;
-        }
+        fmt = mergePixelFormats(fmt, m_nodes[i]->m_preferredFormat);
     }
-    return fmt;
+    return (fmt == PixelFormat::DontCare) ? PixelFormat::Int8 : fmt;
+}
+
+PixelFormat Pipeline::resolveFormat(PixelFormat requested) const {
+    if (requested != PixelFormat::DontCare) { return requested; }
+    // in mixed-precision mode, the main buffers use the lowest format,
+    // and only the passes that ask for more precision get it
+    return m_mixedPrecision ? PixelFormat::Int8 : detectFormat();
+}
+
+PixelFormat Pipeline::adjustFormatForSource(PixelFormat requested, PixelFormat sourceFormat) const {
+    if (!isHighPrecision(sourceFormat) || (resolveFormat(requested) != PixelFormat::SRGB8)) { return requested; }
+    return (sourceFormat == PixelFormat::Int16) ? PixelFormat::Int16 : PixelFormat::Float16;
+}
+
+void Node::freeCache() {
+    if (m_cacheTex && GLutil::initialized) {
+        glDeleteTextures(1, &m_cacheTex);
+    }
+    m_cacheTex = 0;
+    m_cacheValid = false;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -170,17 +322,308 @@ void Pipeline::clear() {
         delete m_nodes[i];
     }
     m_nodes.clear();
+    clearMapChains();
     m_pipelineChanged = true;
 }
 
 void Pipeline::free() {
     clear();
+    freePool();
+    freeTileBuffers();
     m_fbo.free();
+    m_copyProg.free();
     m_vs.free();
     if ((m_tex[0] || m_tex[1]) && GLutil::initialized) {
         glDeleteTextures(2, m_tex);
         m_tex[0] = m_tex[1] = 0;
     }
+    if (m_samplers[0] && GLutil::initialized) {
+        glDeleteSamplers(4, m_samplers);
+    }
+    for (auto& s : m_samplers) { s = 0; }
+    if (m_tileSrcTex && GLutil::initialized) {
+        glDeleteTextures(1, &m_tileSrcTex);
+    }
+    m_tileSrcTex = 0;
+    if (m_tiledResultTex && GLutil::initialized) {
+        glDeleteTextures(1, &m_tiledResultTex);
+    }
+    m_tiledResultTex = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+Pipeline::MapChain* Pipeline::getMapChain(const std::vector<const Node*>& nodes) {
+    for (auto chain : m_mapChains) {
+        if (chain->nodes != nodes) { continue; }
+        bool same = true;
+        for (size_t i = 0;  same && (i < nodes.size());  ++i) {
+            same = (chain->serials[i] == nodes[i]->m_loadSerial);
+        }
+        if (same) { chain->used = true; return chain; }
+    }
+    MapChain* chain = new MapChain;
+    chain->nodes = nodes;
+    for (auto node : nodes) { chain->serials.push_back(node->m_loadSerial); }
+    chain->ok = buildMapChain(*chain);
+    chain->used = true;
+    m_mapChains.push_back(chain);
+    return chain;
+}
+
+void Pipeline::clearMapChains(bool unusedOnly) {
+    size_t keep = 0;
+    for (auto chain : m_mapChains) {
+        if (unusedOnly && chain->used) {
+            chain->used = false;
+            m_mapChains[keep++] = chain;
+        } else {
+            delete chain;
+        }
+    }
+    m_mapChains.resize(keep);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void getCoordMapping(CoordMapMode mode, int width, int height, float rel2map[4], float map2tex[4]) {
+    double ox = 0.0, oy = 0.0, sx = 1.0, sy = 1.0;
+    switch (mode) {
+        case CoordMapMode::Pixel:
+            sx = width;
+            sy = height;
+            break;
+        case CoordMapMode::Relative:
+            ox = -std::max(1.0, double(width) / double(height));
+            oy = -std::max(1.0, double(height) / double(width));
+            sx = -2.0 * ox;
+            sy = -2.0 * oy;
+            break;
+        default:  // None
+            break;
+    }
+    rel2map[0] = float(ox);        rel2map[1] = float(oy);
+    rel2map[2] = float(sx);        rel2map[3] = float(sy);
+    map2tex[0] = float(-ox / sx);  map2tex[1] = float(-oy / sy);
+    map2tex[2] = float(1.0 / sx);  map2tex[3] = float(1.0 / sy);
+}
+
+void Pipeline::getPassMapping(CoordMapMode mode, int width, int height, float scale,
+                              GLfloat rel2map[4], GLfloat map2tex[4], GLfloat imageSize[2]) const {
+    // in 'none' mode, positions are texture coordinates and are used
+    // as such by the shaders, so these only ever see the tile itself
+    if (!m_tiling || (mode == CoordMapMode::None)) {
+        getCoordMapping(mode, width, height, rel2map, map2tex);
+        imageSize[0] = GLfloat(width);
+        imageSize[1] = GLfloat(height);
+        return;
+    }
+
+    // otherwise, map the tile to the part of the whole image's
+    // coordinate system that it covers
+    int fullWidth  = std::max(1, int(float(m_fullWidth)  * scale + 0.5f));
+    int fullHeight = std::max(1, int(float(m_fullHeight) * scale + 0.5f));
+    getCoordMapping(mode, fullWidth, fullHeight, rel2map, map2tex);
+    rel2map[0] += GLfloat(double(rel2map[2]) * double(m_tileX) / double(m_fullWidth));
+    rel2map[1] += GLfloat(double(rel2map[3]) * double(m_tileY) / double(m_fullHeight));
+    rel2map[2]  = GLfloat(double(rel2map[2]) * double(m_width)  / double(m_fullWidth));
+    rel2map[3]  = GLfloat(double(rel2map[3]) * double(m_height) / double(m_fullHeight));
+    map2tex[0] = -rel2map[0] / rel2map[2];  map2tex[1] = -rel2map[1] / rel2map[3];
+    map2tex[2] = 1.0f / rel2map[2];         map2tex[3] = 1.0f / rel2map[3];
+    imageSize[0] = GLfloat(fullWidth);
+    imageSize[1] = GLfloat(fullHeight);
+}
+
+void Pipeline::setTileOffset(GLint location, float scale) const {
+    // gl_FragCoord is relative to the tile; the offset makes it refer
+    // to the whole image, so position-dependent patterns line up
+    if (location < 0) { return; }
+    if (!m_tiling) { glUniform2f(location, 0.0f, 0.0f);  return; }
+    glUniform2f(location, GLfloat(double(m_tileX) * double(scale)), GLfloat(double(m_tileY) * double(scale)));
+}
+
+void Parameter::setUniform(GLint location) const {
+    switch (m_type) {
+        case ParameterType::Value:
+        case ParameterType::Toggle:
+        case ParameterType::Angle:
+            glUniform1f(location, m_renderValue[0]);
+            break;
+        case ParameterType::Value2:
+            glUniform2fv(location, 1, m_renderValue);
+            break;
+        case ParameterType::Value3:
+        case ParameterType::RGB:
+            glUniform3fv(location, 1, m_renderValue);
+            break;
+        case ParameterType::Value4:
+        case ParameterType::RGBA:
+            glUniform4fv(location, 1, m_renderValue);
+            break;
+        // no default here; all enumerants are supposed to be handled
+    }
+}
+
+static void allocateTexture(GLuint tex, int width, int height, PixelFormat format) {
+    glBindTexture(GL_TEXTURE_2D, tex);
+    GLint glfmt; GLenum dtype;
+    switch (format) {
+        case PixelFormat::Gray8:   glfmt = GL_R8;             dtype = GL_UNSIGNED_BYTE;  break;
+        case PixelFormat::SRGB8:   glfmt = GL_SRGB8_ALPHA8;   dtype = GL_UNSIGNED_BYTE;  break;
+        case PixelFormat::Gray16F: glfmt = GL_R16F;           dtype = GL_FLOAT;          break;
+        case PixelFormat::RGB10A2: glfmt = GL_RGB10_A2;       dtype = GL_UNSIGNED_BYTE;  break;
+        case PixelFormat::Int16:   glfmt = GL_RGBA16;         dtype = GL_UNSIGNED_SHORT; break;
+        case PixelFormat::RGB11F:  glfmt = GL_R11F_G11F_B10F; dtype = GL_FLOAT;          break;
+        case PixelFormat::Float16: glfmt = GL_RGBA16F;        dtype = GL_FLOAT;          break;
+        case PixelFormat::Float32: glfmt = GL_RGBA32F;        dtype = GL_FLOAT;          break;
+        default:                   glfmt = GL_RGBA8;          dtype = GL_UNSIGNED_BYTE;  break;
+    }
+    glTexImage2D(GL_TEXTURE_2D, 0, glfmt, width, height, 0, GL_RGBA, dtype, nullptr);
+
+    // single-channel textures are presented to the shaders as gray RGBA;
+    // since textures may be re-allocated in another format, the swizzle
+    // needs to be reset for all other formats
+    static const GLint swizzleGray[4] = { GL_RED, GL_RED, GL_RED, GL_ONE };
+    static const GLint swizzleRGBA[4] = { GL_RED, GL_GREEN, GL_BLUE, GL_ALPHA };
+    glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, isSingleChannel(format) ? swizzleGray : swizzleRGBA);
+}
+
+//! determine the format a pass shall render into; sRGB is only supported
+//! as a pipeline-wide format, as the encoded data would be misinterpreted
+//! at the boundaries to other formats
+static PixelFormat getPassFormat(PixelFormat baseFormat, PixelFormat passFormat, bool mixed) {
+    return (mixed && (passFormat != PixelFormat::DontCare) && (passFormat != PixelFormat::SRGB8)) ? passFormat : baseFormat;
+}
+
+GLuint Pipeline::acquireTexture(int width, int height, PixelFormat format) {
+    for (auto& entry : m_pool) {
+        if (!entry.inUse && (entry.width == width) && (entry.height == height) && (entry.format == format)) {
+            entry.inUse = true;
+            return entry.tex;
+        }
+    }
+    PooledTexture entry;
+    entry.width = width;
+    entry.height = height;
+    entry.format = format;
+    glGenTextures(1, &entry.tex);
+    glBindTexture(GL_TEXTURE_2D, entry.tex);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    allocateTexture(entry.tex, width, height, format);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    GLutil::checkError("pooled buffer allocation");
+    #ifndef NDEBUG
+        fprintf(stderr, "allocated pooled %dx%d buffer #%d (fmt #%d)\n", width, height, int(m_pool.size()) + 1, static_cast<int>(format));
+    #endif
+    entry.inUse = true;
+    m_pool.push_back(entry);
+    return entry.tex;
+}
+
+void Pipeline::releaseTexture(GLuint tex) {
+    for (auto& entry : m_pool) {
+        if (entry.tex == tex) { entry.inUse = false; }
+    }
+}
+
+void Pipeline::freePool() {
+    if (GLutil::initialized) {
+        for (const auto& entry : m_pool) {
+            glDeleteTextures(1, &entry.tex);
+        }
+    }
+    m_pool.clear();
+    m_pooledResult = 0;
+}
+
+void Pipeline::swapTargets() {
+    RenderTargets& o = m_otherTargets;
+    if (!o.tex[0]) {
+        glGenTextures(2, o.tex);
+        for (int i = 0;  i < 2;  ++i) {
+            glBindTexture(GL_TEXTURE_2D, o.tex[i]);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        }
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+    std::swap(m_width,        o.width);
+    std::swap(m_height,       o.height);
+    std::swap(m_format,       o.format);
+    std::swap(m_resultFormat, o.resultFormat);
+    std::swap(m_mixedActive,  o.mixedActive);
+    std::swap(m_tex[0],       o.tex[0]);
+    std::swap(m_tex[1],       o.tex[1]);
+    std::swap(m_resultTex,    o.resultTex);
+    std::swap(m_pooledResult, o.pooledResult);
+    m_pool.swap(o.pool);
+}
+
+void Pipeline::freeTileBuffers() {
+    // must not be called while the tile targets are swapped in
+    RenderTargets& o = m_otherTargets;
+    if (GLutil::initialized) {
+        if (o.tex[0]) { glDeleteTextures(2, o.tex); }
+        for (const auto& entry : o.pool) {
+            glDeleteTextures(1, &entry.tex);
+        }
+        if (m_tileSrcTex) { glDeleteTextures(1, &m_tileSrcTex); }
+    }
+    o = RenderTargets();
+    m_tileSrcTex = 0;
+}
+
+bool Pipeline::copyResult(GLuint destTex) {
+    if (!m_resultTex || !m_copyProg.good()) { return false; }
+    // the result may have a reduced size if it's a pooled texture
+    GLint width = 0, height = 0;
+    GLutil::clearError();
+    glBindTexture(GL_TEXTURE_2D, m_resultTex);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH,  &width);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+    if ((width < 1) || (height < 1)) { glBindTexture(GL_TEXTURE_2D, 0);  return false; }
+    allocateTexture(destTex, width, height, m_resultFormat);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    if (GLutil::checkError("result copy allocation") || !m_fbo.begin(destTex)) { m_fbo.end();  return false; }
+    // sRGB data is decoded when reading and encoded again when writing
+    if (m_resultFormat == PixelFormat::SRGB8) { glEnable(GL_FRAMEBUFFER_SRGB); }
+    glViewport(0, 0, width, height);
+    m_copyProg.use();
+    glBindTexture(GL_TEXTURE_2D, m_resultTex);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glUseProgram(0);
+    glDisable(GL_FRAMEBUFFER_SRGB);
+    m_fbo.end();
+    return !GLutil::checkError("result copy");
+}
+
+GLuint Pipeline::copySource(GLuint srcTex) {
+    // this is drawn rather than copied with glCopyTexSubImage2D(), so the
+    // formats don't need to match; the sRGB state is already set up by
+    // render(), so sRGB sources are decoded and encoded again
+    GLuint tex = acquireTexture(m_width, m_height, m_resultFormat);
+    if (!tex || !m_copyProg.good()) { return 0; }
+    GLutil::clearError();
+    if (!m_fbo.begin(tex)) { m_fbo.end();  releaseTexture(tex);  return 0; }
+    glViewport(0, 0, m_width, m_height);
+    m_copyProg.use();
+    glBindTexture(GL_TEXTURE_2D, srcTex);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glUseProgram(0);
+    m_fbo.end();
+    if (GLutil::checkError("source copy")) { releaseTexture(tex);  return 0; }
+    return tex;
+}
+
+uint64_t Pipeline::poolMemory() const {
+    uint64_t mem = 0;
+    for (const auto& entry : m_pool) {
+        mem += uint64_t(entry.width) * uint64_t(entry.height) * uint64_t(getBytesPerPixel(entry.format));
+    }
+    return mem;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -201,6 +644,28 @@ bool Pipeline::init() {
     "\n" "}"
     "\n");
 
+    // tiles must fit into a texture as well as into the viewport
+    GLint maxTex = 0, maxVP[2] = { 0, 0 };
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTex);
+    glGetIntegerv(GL_MAX_VIEWPORT_DIMS, maxVP);
+    m_maxTileSize = std::max(MinTileSize, std::min({ int(maxTex), int(maxVP[0]), int(maxVP[1]), MaxTileSize }));
+
+    // helper program for copyResult()
+    GLutil::Shader copyFS(GL_FRAGMENT_SHADER,
+         "#version 330 core"
+    "\n" "uniform sampler2D gips_tex;"
+    "\n" "out vec4 gips_frag;"
+    "\n" "void main() {"
+    "\n" "  gips_frag = texelFetch(gips_tex, ivec2(gl_FragCoord.xy), 0);"
+    "\n" "}"
+    "\n");
+    if (m_vs.good() && copyFS.good() && m_copyProg.link(m_vs, copyFS) && m_copyProg.use()) {
+        glUniform4f(m_copyProg.getUniformLocation("gips_pos2ndc"), -1.0f, -1.0f, 2.0f, 2.0f);
+        glUniform4f(m_copyProg.getUniformLocation("gips_rel2map"), 0.0f, 0.0f, 1.0f, 1.0f);
+        glUseProgram(0);
+    }
+    copyFS.free();
+
     m_fbo.init();
     glGenTextures(2, m_tex);
     for (int i = 0;  i < 2;  ++i) {
@@ -209,58 +674,223 @@ bool Pipeline::init() {
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     }
     glBindTexture(GL_TEXTURE_2D, 0);
+    glGenSamplers(4, m_samplers);
+    for (int i = 0;  i < 4;  ++i) {
+        bool texFilter = !!(i & 1), mipmap = !!(i & 2);
+        GLint minFilter = mipmap ? (texFilter ? GL_LINEAR_MIPMAP_LINEAR : GL_NEAREST_MIPMAP_NEAREST)
+                                 : (texFilter ? GL_LINEAR : GL_NEAREST);
+        glSamplerParameteri(m_samplers[i], GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glSamplerParameteri(m_samplers[i], GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glSamplerParameteri(m_samplers[i], GL_TEXTURE_MIN_FILTER, minFilter);
+        glSamplerParameteri(m_samplers[i], GL_TEXTURE_MAG_FILTER, texFilter ? GL_LINEAR : GL_NEAREST);
+    }
 
     m_initOK = m_vs.good();
     m_initialized = true;
     return m_initOK;
 }
 
-void Pipeline::render(GLuint srcTex, int width, int height, PixelFormat format, int maxNodes) {
+void Pipeline::render(GLuint srcTex, int width, int height, PixelFormat format, int maxNodes, int firstNode) {
     GLutil::clearError();
     if ((maxNodes < 0) || (maxNodes > nodeCount())) { maxNodes = nodeCount(); }
-    if (format == PixelFormat::DontCare) { format = detectFormat(); }
+    if (firstNode < 0) { firstNode = 0; }
+    if (!m_tiling) { m_tilingError = nullptr; }
+    PixelFormat requestedFormat = format;
+    bool mixed = m_mixedPrecision && (format == PixelFormat::DontCare);
+    format = resolveFormat(format);
     #ifndef NDEBUG
-        fprintf(stderr, "render: %dx%d, fmt #%d, %d nodes\n", width, height, static_cast<int>(format), maxNodes);
+        fprintf(stderr, "render: %dx%d, fmt #%d%s, %d nodes\n", width, height, static_cast<int>(format), mixed ? " (mixed)" : "", maxNodes);
     #endif
 
+    // the previous result isn't needed any longer
+    if (m_pooledResult) {
+        releaseTexture(m_pooledResult);
+        m_pooledResult = 0;
+    }
+
     // format change?
-    if ((width != m_width) || (height != m_height) || (format != m_format)) {
+    if ((width != m_width) || (height != m_height) || (format != m_format) || (mixed != m_mixedActive)) {
         #ifndef NDEBUG
             fprintf(stderr, "render format changed (was %dx%d, #%d)\n", m_width, m_height, static_cast<int>(m_format));
         #endif
         for (int i = 0;  i < 2;  ++i) {
-            glBindTexture(GL_TEXTURE_2D, m_tex[i]);
-            GLint glfmt; GLenum dtype;
-            switch (format) {
-                case PixelFormat::Int16:   glfmt = GL_RGBA16;  dtype = GL_UNSIGNED_SHORT; break;
-                case PixelFormat::Float16: glfmt = GL_RGBA16F; dtype = GL_FLOAT;          break;
-                case PixelFormat::Float32: glfmt = GL_RGBA32F; dtype = GL_FLOAT;          break;
-                default:                   glfmt = GL_RGBA8;   dtype = GL_UNSIGNED_BYTE;  break;
-            }
-            glTexImage2D(GL_TEXTURE_2D, 0, glfmt, width, height, 0, GL_RGBA, dtype, nullptr);
+            allocateTexture(m_tex[i], width, height, format);
         }
         glBindTexture(GL_TEXTURE_2D, 0);
-        GLutil::checkError("intermediate buffer allocation");
+        if (!m_tiling) {
+            for (auto node : m_nodes) {
+                node->freeCache();  // will be re-created in the new format on demand
+            }
+        }
+        freePool();
+        m_allocFailed = (GLutil::checkError("intermediate buffer allocation") == GL_OUT_OF_MEMORY);
         m_width = width;
         m_height = height;
         m_format = format;
+        m_mixedActive = mixed;
+        if (m_allocFailed) {
+            // shrink the buffers to release whatever has been allocated,
+            // and make sure that they're re-allocated on the next call
+            for (int i = 0;  i < 2;  ++i) {
+                allocateTexture(m_tex[i], 1, 1, format);
+            }
+            glBindTexture(GL_TEXTURE_2D, 0);
+            m_width = m_height = 0;
+            m_resultTex = srcTex;
+            m_resultFormat = format;
+            // if this happens for the whole image, the image is processed
+            // in tiles instead; if it happens for a tile, the caller
+            // (i.e. renderTiled()) is responsible for dealing with it
+            if (!m_tiling) {
+                renderFallback(srcTex, width, height, requestedFormat, maxNodes, firstNode);
+            }
+            return;
+        }
+    }
+    if (!m_tiling) {
+        m_lastTileCount = 0;
+        if (m_tiledResultTex) {
+            glDeleteTextures(1, &m_tiledResultTex);
+            m_tiledResultTex = 0;
+        }
     }
 
-    // set viewport
+    // set viewport; in sRGB mode, let the hardware convert from and to
+    // linear light on every texture read and framebuffer write
     glViewport(0, 0, width, height);
+    if (m_format == PixelFormat::SRGB8) { glEnable(GL_FRAMEBUFFER_SRGB); }
     GLutil::checkError("processing viewport setup");
     auto t0 = std::chrono::high_resolution_clock::now();
 
+    // find the last active node that doesn't read its input;
+    // everything upstream of it can't affect the result and is skipped
+    // (nodes outside of the rendered range are never marked as bypassed)
+    int startIndex = firstNode;
+    for (int nodeIndex = 0;  nodeIndex < nodeCount();  ++nodeIndex) {
+        auto& node = *m_nodes[size_t(nodeIndex)];
+        bool inRange = (nodeIndex >= firstNode) && (nodeIndex < maxNodes);
+        node.m_bypassed = inRange && node.m_renderEnabled && node.renderIdentity();
+        if (inRange && node.m_renderEnabled && !node.m_bypassed && node.m_inputIndependent && (node.passCount() > 0)) {
+            startIndex = nodeIndex;
+        }
+    }
+    m_lastSkipCount = startIndex - firstNode;
+
+    // count the passes to be rendered, for progress reporting
+    m_progressDone = m_progressTotal = 0;
+    for (int nodeIndex = startIndex;  nodeIndex < maxNodes;  ++nodeIndex) {
+        const auto& node = *m_nodes[size_t(nodeIndex)];
+        if (node.m_renderEnabled && !node.m_bypassed) { m_progressTotal += node.passCount(); }
+    }
+    m_progress = 0.0f;
+
+    // results that live in pooled textures (because they have a reduced
+    // size or a different format) are returned to the pool as soon as
+    // the next result is available
+    const auto setResult = [this] (GLuint tex, PixelFormat format, GLuint pooledTex) {
+        if (m_pooledResult) { releaseTexture(m_pooledResult); }
+        m_pooledResult = pooledTex;
+        m_resultTex = tex;
+        m_resultFormat = format;
+    };
+
     // iterate over the nodes and passes
     m_resultTex = srcTex;
-    for (int nodeIndex = 0;  nodeIndex < maxNodes;  ++nodeIndex) {
-        const auto& node = *m_nodes[size_t(nodeIndex)];
-        if (!node.enabled()) { continue; }
+    m_resultFormat = m_format;
+    m_lastBypassCount = 0;
+    m_lastComposedCount = 0;
+    std::vector<const Node*> mapNodes;
+    for (int nodeIndex = startIndex;  nodeIndex < maxNodes;  ++nodeIndex) {
+        if (m_cancel) { break; }
+        auto& node = *m_nodes[size_t(nodeIndex)];
+        if (node.m_bypassed) { ++m_lastBypassCount; }
+        if (!node.m_renderEnabled || node.m_bypassed) { continue; }
+
+        // consecutive map() nodes are composed into a single pass
+        // that samples the input only once
+        if (node.m_isMap && node.good()) {
+            mapNodes.clear();
+            int lastIndex = nodeIndex;
+            for (int i = nodeIndex;  i < maxNodes;  ++i) {
+                const Node& n = *m_nodes[size_t(i)];
+                if (!n.m_renderEnabled || n.m_bypassed) { continue; }
+                if (!n.m_isMap || !n.good()) { break; }
+                mapNodes.push_back(&n);
+                lastIndex = i;
+            }
+            PixelFormat chainFormat = PixelFormat::DontCare;
+            for (auto n : mapNodes) {
+                chainFormat = mergePixelFormats(chainFormat, n->m_passes[0].format);
+            }
+            chainFormat = getPassFormat(m_format, chainFormat, mixed);
+            GLuint outTex = (m_resultTex == m_tex[0]) ? m_tex[1] : m_tex[0];
+            GLuint pooledTex = 0;
+            if ((mapNodes.size() > 1u) && (chainFormat != m_format)) {
+                outTex = pooledTex = acquireTexture(m_width, m_height, chainFormat);
+            }
+            if ((mapNodes.size() > 1u) && renderMapChain(*getMapChain(mapNodes), outTex, chainFormat)) {
+                setResult(outTex, chainFormat, pooledTex);
+                for (int i = nodeIndex + 1;  i <= lastIndex;  ++i) {
+                    if (m_nodes[size_t(i)]->m_bypassed) { ++m_lastBypassCount; }
+                }
+                m_lastComposedCount += int(mapNodes.size());
+                m_progressDone += int(mapNodes.size());
+                nodeIndex = lastIndex;
+                continue;
+            }
+            if (pooledTex) { releaseTexture(pooledTex); }
+        }
+
+        // input-independent nodes render their last pass into a cache
+        // texture that can be re-used until the node itself changes
+        // (except in tiled mode, where every tile has different content)
+        if (node.m_inputIndependent && !m_tiling) {
+            if (node.m_cacheValid) {
+                setResult(node.m_cacheTex, node.m_cacheFormat, 0);
+                m_progressDone += node.passCount();
+                continue;
+            }
+            if (!node.m_cacheTex) {
+                GLutil::clearError();
+                glGenTextures(1, &node.m_cacheTex);
+                glBindTexture(GL_TEXTURE_2D, node.m_cacheTex);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+                node.m_cacheFormat = getPassFormat(m_format, node.m_passes[size_t(node.passCount() - 1)].format, mixed);
+                allocateTexture(node.m_cacheTex, m_width, m_height, node.m_cacheFormat);
+                glBindTexture(GL_TEXTURE_2D, 0);
+                if (GLutil::checkError("cache buffer allocation")) { node.freeCache(); }
+            }
+        }
+
+        GLuint bufTex[MaxNamedBuffers] = { 0, };
         for (int passIndex = 0;  passIndex < node.passCount();  ++passIndex) {
-            const auto& pass = node.m_passes[passIndex];
+            const auto& pass = node.m_passes[size_t(passIndex)];
+            int passWidth  = std::max(1, int(float(m_width)  * pass.scale + 0.5f));
+            int passHeight = std::max(1, int(float(m_height) * pass.scale + 0.5f));
+            PixelFormat passFormat = getPassFormat(m_format, pass.format, mixed);
+            bool pooled = (passWidth != m_width) || (passHeight != m_height) || (passFormat != m_format);
 
-            // select output buffer to use
+            // select output buffer to use; named outputs, reduced-size and
+            // different-format outputs are taken from the pool (except for
+            // named outputs of the last pass, where nobody could read them)
             GLuint outTex = (m_resultTex == m_tex[0]) ? m_tex[1] : m_tex[0];
+            GLuint newPooledTex = 0;
+            if (node.m_cacheTex && !m_tiling && ((passIndex + 1) == node.passCount())) {
+                outTex = node.m_cacheTex;
+                passFormat = node.m_cacheFormat;
+            } else if ((pass.outputBuffer >= 0) && ((passIndex + 1) < node.passCount())) {
+                outTex = bufTex[pass.outputBuffer] = acquireTexture(passWidth, passHeight, passFormat);
+            } else if (pooled) {
+                outTex = newPooledTex = acquireTexture(passWidth, passHeight, passFormat);
+            }
+
+            // mipmaps can't be generated for the caller's texture,
+            // so a mipmapped first pass reads from a copy of it
+            if (pass.mipmap && (m_resultTex == srcTex)) {
+                GLuint copyTex = copySource(srcTex);
+                if (copyTex) { setResult(copyTex, m_resultFormat, copyTex); }
+            }
 
             // prepare FBO, texture and program for rendering
             GLutil::clearError();
@@ -268,79 +898,102 @@ void Pipeline::render(GLuint srcTex, int width, int height, PixelFormat format,
                 #ifndef NDEBUG
                     fprintf(stderr, "Error: framebuffer isn't complete (status 0x%04X)\n", m_fbo.status);
                 #endif
+                if (newPooledTex) { releaseTexture(newPooledTex); }
                 continue;
             }
             glBindTexture(GL_TEXTURE_2D, m_resultTex);
+            glBindSampler(0, getSampler(pass.texFilter, pass.mipmap && (m_resultTex != srcTex)));
+            if (node.m_lutTex) {
+                glActiveTexture(GL_TEXTURE1);
+                glBindTexture(GL_TEXTURE_3D, node.m_lutTex);
+                glActiveTexture(GL_TEXTURE0);
+            }
+            for (size_t b = 0;  b < node.m_buffers.size();  ++b) {
+                if (bufTex[b] && (node.m_buffers[b].producer < passIndex)) {
+                    glActiveTexture(GLenum(GL_TEXTURE2 + b));
+                    glBindTexture(GL_TEXTURE_2D, bufTex[b]);
+                    glBindSampler(GLuint(2 + b), getSampler(pass.texFilter, false));
+                }
+            }
+            glActiveTexture(GL_TEXTURE0);
             pass.program.use();
             GLutil::checkError("FBO/tex/shader setup");
 
-            // set up input texture
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, pass.texFilter ? GL_LINEAR : GL_NEAREST);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, pass.texFilter ? GL_LINEAR : GL_NEAREST);
+            // set up input texture (if the source couldn't be copied,
+            // the pass runs without mipmaps)
+            if (pass.mipmap && (m_resultTex != srcTex)) {
+                glGenerateMipmap(GL_TEXTURE_2D);
+            }
 
             // set up geometry
-            glUniform2f(pass.locImageSize, GLfloat(m_width), GLfloat(m_height));
-            double ox = 0.0, oy = 0.0, sx = 1.0, sy = 1.0;
-            switch (pass.coordMode) {
-                case CoordMapMode::Pixel:
-                    sx = m_width;
-                    sy = m_height;
-                    break;
-                case CoordMapMode::Relative:
-                    ox = -std::max(1.0, double(m_width) / double(m_height));
-                    oy = -std::max(1.0, double(m_height) / double(m_width));
-                    sx = -2.0 * ox;
-                    sy = -2.0 * oy;
-                    break;
-                default:  // None
-                    break;
-            }
-            glUniform4f(pass.locRel2Map, GLfloat(ox), GLfloat(oy), GLfloat(sx), GLfloat(sy));
+            glViewport(0, 0, passWidth, passHeight);
+            GLfloat rel2map[4], map2tex[4], imageSize[2];
+            getPassMapping(pass.coordMode, passWidth, passHeight, pass.scale, rel2map, map2tex, imageSize);
+            glUniform2fv(pass.locImageSize, 1, imageSize);
+            glUniform1f(pass.locMono, isSingleChannel(passFormat) ? 1.0f : 0.0f);
+            setTileOffset(pass.locTileOffset, pass.scale);
+            glUniform4fv(pass.locRel2Map, 1, rel2map);
             if (pass.locMap2Tex >= 0) {
-                glUniform4f(pass.locMap2Tex, GLfloat(-ox / sx), GLfloat(-oy / sy), GLfloat(1.0 / sx), GLfloat(1.0 / sy));
+                glUniform4fv(pass.locMap2Tex, 1, map2tex);
             }
 
             // set up parameters
             for (int paramIndex = 0;  paramIndex < node.paramCount();  ++paramIndex) {
                 const auto& param = node.m_params[size_t(paramIndex)];
-                GLint loc = param.m_location[passIndex];
-                switch (param.m_type) {
-                    case ParameterType::Value:
-                    case ParameterType::Toggle:
-                    case ParameterType::Angle:
-                        glUniform1f(loc, param.m_value[0]);
-                        break;
-                    case ParameterType::Value2:
-                        glUniform2fv(loc, 1, param.m_value);
-                        break;
-                    case ParameterType::Value3:
-                    case ParameterType::RGB:
-                        glUniform3fv(loc, 1, param.m_value);
-                        break;
-                    case ParameterType::Value4:
-                    case ParameterType::RGBA:
-                        glUniform4fv(loc, 1, param.m_value);
-                        break;
-                    // no default here; all enumerants are supposed to be handled
-                }
+                param.setUniform(param.m_location[passIndex]);
             }
             GLutil::checkError("uniform setup");
 
             // now render!
-            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+            bool complete = drawSliced(passWidth, passHeight, node.m_passes[size_t(passIndex)].msPerMPixel);
             GLutil::checkError("filter rendering");
+            ++m_progressDone;
 
             // "unprepare" everything
             glUseProgram(0);
+            for (size_t b = 0;  b < node.m_buffers.size();  ++b) {
+                if (bufTex[b]) {
+                    glActiveTexture(GLenum(GL_TEXTURE2 + b));
+                    glBindTexture(GL_TEXTURE_2D, 0);
+                    glBindSampler(GLuint(2 + b), 0);
+                }
+            }
+            glActiveTexture(GL_TEXTURE0);
+            glBindSampler(0, 0);
+            if (node.m_lutTex) {
+                glActiveTexture(GL_TEXTURE1);
+                glBindTexture(GL_TEXTURE_3D, 0);
+                glActiveTexture(GL_TEXTURE0);
+            }
             glBindTexture(GL_TEXTURE_2D, 0);
             m_fbo.end();
             GLutil::checkError("FBO/tex/shader teardown");
 
             // set result to output buffer
-            m_resultTex = outTex;
+            setResult(outTex, passFormat, newPooledTex);
 
+            // return named buffers to the pool after their last reader ran
+            // (which includes the next pass, reading the buffer as gips_tex)
+            for (size_t b = 0;  b < node.m_buffers.size();  ++b) {
+                const auto& buf = node.m_buffers[b];
+                if (bufTex[b] && (passIndex >= std::max(buf.producer + 1, buf.lastReader))) {
+                    releaseTexture(bufTex[b]);
+                    bufTex[b] = 0;
+                }
+            }
+            if (!complete) { break; }
         }   // END pass loop
+        for (size_t b = 0;  b < node.m_buffers.size();  ++b) {
+            if (bufTex[b]) { releaseTexture(bufTex[b]); }
+        }
+        if (!m_tiling) {
+            node.m_cacheValid = node.m_cacheTex && (m_resultTex == node.m_cacheTex) && !m_cancel;
+        }
     }   // END node loop
+    m_lastRenderCancelled = m_cancel;
+    m_progress = 1.0f;
+    clearMapChains(true);
+    glDisable(GL_FRAMEBUFFER_SRGB);
 
     // force full pipeline flush to measure timing
     glBindTexture(GL_TEXTURE_2D, m_resultTex);
@@ -351,6 +1004,538 @@ void Pipeline::render(GLuint srcTex, int width, int height, PixelFormat format,
     m_lastRenderTime_ms = std::chrono::duration<float, std::milli>(t1 - t0).count();
 }   // END render()
 
+bool Pipeline::renderMapChain(MapChain& chain, GLuint outTex, PixelFormat format) {
+    if (!chain.ok) { return false; }
+    GLutil::clearError();
+    if (!m_fbo.begin(outTex)) { return false; }
+    glViewport(0, 0, m_width, m_height);
+    glBindTexture(GL_TEXTURE_2D, m_resultTex);
+    chain.program.use();
+    GLutil::checkError("FBO/tex/shader setup");
+
+    // the upstream-most node is the one that actually samples the input
+    glBindSampler(0, getSampler(chain.nodes[0]->m_passes[0].texFilter, false));
+
+    // set up geometry and parameters
+    glUniform1f(chain.locMono, isSingleChannel(format) ? 1.0f : 0.0f);
+    setTileOffset(chain.locTileOffset, 1.0f);
+    size_t paramIndex = 0;
+    for (size_t i = 0;  i < chain.nodes.size();  ++i) {
+        const Node& node = *chain.nodes[i];
+        GLfloat rel2map[4], map2tex[4], imageSize[2];
+        getPassMapping(node.m_passes[0].coordMode, m_width, m_height, 1.0f, rel2map, map2tex, imageSize);
+        if (!i) { glUniform2fv(chain.locImageSize, 1, imageSize); }
+        glUniform4fv(chain.locRel2Map[i], 1, rel2map);
+        glUniform4fv(chain.locMap2Tex[i], 1, map2tex);
+        for (const auto& param : node.m_params) {
+            param.setUniform(chain.locParams[paramIndex++]);
+        }
+    }
+    GLutil::checkError("uniform setup");
+
+    // render and clean up; if the render is cancelled halfway,
+    // the chain still counts as rendered, as the result is discarded anyway
+    drawSliced(m_width, m_height, chain.msPerMPixel);
+    GLutil::checkError("composed map rendering");
+    glUseProgram(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindSampler(0, 0);
+    m_fbo.end();
+    GLutil::checkError("FBO/tex/shader teardown");
+    return true;
+}
+
+bool Pipeline::drawSliced(int width, int height, float& msPerMPixel) {
+    if ((m_sliceBudget_ms <= 0.0f) || m_tiling) {
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        return true;
+    }
+
+    // draw the pass in horizontal bands; the height of each band follows
+    // from the pass's measured cost, which is refined with every band
+    glEnable(GL_SCISSOR_TEST);
+    float mpixPerRow = float(width) * 1.0e-6f;
+    int y = 0;
+    while ((y < height) && !m_cancel) {
+        float maxRows = (msPerMPixel > 0.0f) ? (m_sliceBudget_ms / (msPerMPixel * mpixPerRow))
+                                             : float(InitialSlicePixels / width);
+        int rows = std::max(int(std::min(maxRows, float(height))), MinSliceRows);
+        if ((height - y - rows) < MinSliceRows) { rows = height - y; }
+        auto t0 = std::chrono::high_resolution_clock::now();
+        glScissor(0, y, width, rows);
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+        // wait until the band has been drawn, so that the GPU's queue
+        // never holds more than one band's worth of work
+        GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        GLenum status;
+        do {
+            status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 100000000u);
+        } while (status == GL_TIMEOUT_EXPIRED);
+        glDeleteSync(fence);
+        auto t1 = std::chrono::high_resolution_clock::now();
+        float cost = std::chrono::duration<float, std::milli>(t1 - t0).count() / (float(rows) * mpixPerRow);
+        msPerMPixel = (msPerMPixel > 0.0f) ? (0.5f * (msPerMPixel + cost)) : cost;
+
+        y += rows;
+        if (m_progressTotal > 0) {
+            m_progress = std::min(1.0f, (float(m_progressDone) + float(y) / float(height)) / float(m_progressTotal));
+        }
+    }
+    glDisable(GL_SCISSOR_TEST);
+    return (y >= height);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int Pipeline::tileHalo(int maxNodes, int firstNode) const {
+    if ((maxNodes < 0) || (maxNodes > nodeCount())) { maxNodes = nodeCount(); }
+    // the areas that the nodes look at add up along the pipeline
+    int halo = 0;
+    for (int i = std::max(firstNode, 0);  i < maxNodes;  ++i) {
+        const Node& node = *m_nodes[size_t(i)];
+        if (node.m_renderEnabled && node.good() && !node.renderIdentity()) {
+            int h = node.halo();
+            if (h < 0) { return -1; }
+            halo += h;
+        }
+    }
+    return (halo + TileAlign - 1) & (~(TileAlign - 1));
+}
+
+int Pipeline::getTileSize(int width, int height, int halo, int tileSize) const {
+    if ((tileSize <= 0) || (tileSize > m_maxTileSize)) { tileSize = m_maxTileSize; }
+    tileSize &= ~(TileAlign - 1);
+    if ((width <= tileSize) && (height <= tileSize)) { return tileSize; }  // single tile
+    if (halo < 0) { return 0; }
+    // leave room for renderTiled() to widen the tiles by up to TileAlign-1
+    // pixels; the overlap must not take up more than a quarter of a tile
+    // on each side; if the requested tiles are too small for that, use
+    // larger ones
+    int maxSize = (m_maxTileSize - (TileAlign - 1)) & ~(TileAlign - 1);
+    int minSize = std::max(MinTileSize, 4 * halo);
+    if (minSize > maxSize) { return 0; }
+    return std::max(std::min(tileSize, maxSize), minSize);
+}
+
+const char* Pipeline::checkTiling(int width, int height, int maxNodes, int firstNode, int tileSize) const {
+    if (!m_initOK) { return "the pipeline isn't initialized"; }
+    int halo = tileHalo(maxNodes, firstNode);
+    if (getTileSize(width, height, halo, tileSize) > 0) { return nullptr; }
+    return (halo < 0) ? "the pipeline can't be processed in tiles (it contains distortion, '@scale' or '@mipmap' filters without '@halo')"
+                      : "the pipeline can't be processed in tiles (the filters' '@halo' sizes are too large)";
+}
+
+//! format of the source texture for a tile: the source image's own
+//! precision, except that 8-bit data is tagged as sRGB-encoded in sRGB
+//! mode, just like the image texture is for interactive rendering
+static PixelFormat getTileSourceFormat(PixelFormat srcFormat, PixelFormat baseFormat) {
+    if ((srcFormat == PixelFormat::Int8) || (srcFormat == PixelFormat::SRGB8)) {
+        return (baseFormat == PixelFormat::SRGB8) ? PixelFormat::SRGB8 : PixelFormat::Int8;
+    }
+    return srcFormat;
+}
+
+bool Pipeline::renderTiled(TileIO& io, int width, int height, PixelFormat format, int maxNodes, int firstNode, int tileSize) {
+    if (!m_initOK || (width < 1) || (height < 1)) { return false; }
+    format = adjustFormatForSource(format, io.sourceFormat());
+    int halo = tileHalo(maxNodes, firstNode);
+    tileSize = getTileSize(width, height, halo, tileSize);
+    m_tilingError = tileSize ? nullptr : checkTiling(width, height, maxNodes, firstNode);
+    if (m_tilingError) {
+        #ifndef NDEBUG
+            fprintf(stderr, "tiled render: %dx%d impossible: %s\n", width, height, m_tilingError);
+        #endif
+        return false;
+    }
+    // after running out of memory, a pipeline that can't be tiled at all
+    // (but fits into a single tile) can't be retried with smaller tiles
+    const int minTileSize = (halo < 0) ? tileSize : std::max(MinTileSize, 4 * halo);
+    PixelFormat srcFormat = getTileSourceFormat(io.sourceFormat(), resolveFormat(format));
+    float totalTime_ms = 0.0f;
+    bool ok = false;
+    swapTargets();
+    m_tiling = true;
+    m_fullWidth = width;
+    m_fullHeight = height;
+
+    for (;;) {
+        // all tiles have the same size (they're shifted inwards at the
+        // right and bottom edges), so the intermediate buffers only need
+        // to be allocated once; the tiles are widened a bit beyond the
+        // (aligned) step size, so the shifted tiles start at aligned
+        // positions, too
+        int tileWidth  = std::min(tileSize, width);
+        int tileHeight = std::min(tileSize, height);
+        int haloX = (tileWidth  < width)  ? halo : 0;
+        int haloY = (tileHeight < height) ? halo : 0;
+        int stepX = tileWidth  - 2 * haloX;
+        int stepY = tileHeight - 2 * haloY;
+        if (tileWidth  < width)  { tileWidth  += (width  - tileWidth)  & (TileAlign - 1); }
+        if (tileHeight < height) { tileHeight += (height - tileHeight) & (TileAlign - 1); }
+        #ifndef NDEBUG
+            fprintf(stderr, "tiled render: %dx%d in %dx%d tiles, %d pixels overlap, source fmt #%d\n",
+                    width, height, tileWidth, tileHeight, std::max(haloX, haloY), static_cast<int>(srcFormat));
+        #endif
+
+        // allocate the source texture for the tiles
+        GLutil::clearError();
+        if (!m_tileSrcTex) {
+            glGenTextures(1, &m_tileSrcTex);
+            glBindTexture(GL_TEXTURE_2D, m_tileSrcTex);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        }
+        allocateTexture(m_tileSrcTex, tileWidth, tileHeight, srcFormat);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        m_allocFailed = (GLutil::checkError("tile source buffer allocation") == GL_OUT_OF_MEMORY);
+
+        // render the tiles, in reading order
+        m_lastTileCount = 0;
+        ok = !m_allocFailed;
+        for (int y = 0;  ok && (y < height);  y += stepY) {
+            for (int x = 0;  ok && (x < width);  x += stepX) {
+                m_tileX = std::max(0, std::min(x - haloX, width  - tileWidth));
+                m_tileY = std::max(0, std::min(y - haloY, height - tileHeight));
+                ok = io.readSource(m_tileSrcTex, m_tileX, m_tileY, tileWidth, tileHeight);
+                if (!ok) { break; }
+                render(m_tileSrcTex, tileWidth, tileHeight, format, maxNodes, firstNode);
+                totalTime_ms += m_lastRenderTime_ms;
+                ok = !m_allocFailed
+                  && io.writeResult(m_resultTex, m_resultFormat, x - m_tileX, y - m_tileY,
+                                    x, y, std::min(stepX, width - x), std::min(stepY, height - y));
+                ++m_lastTileCount;
+            }
+        }
+
+        // if we ran out of memory, try again with smaller tiles
+        if (ok || !m_allocFailed || (tileSize <= minTileSize) || !io.rewind()) { break; }
+        tileSize = std::max((tileSize / 2) & (~(TileAlign - 1)), minTileSize);
+        #ifndef NDEBUG
+            fprintf(stderr, "out of video memory, retrying with %d pixel tiles\n", tileSize);
+        #endif
+        freePool();
+    }
+
+    // the tile buffers may be quite large, so they're not kept around
+    m_tiling = false;
+    swapTargets();
+    freeTileBuffers();
+    m_lastRenderTime_ms = totalTime_ms;
+    return ok;
+}
+
+GLuint Pipeline::renderTile(TileIO& io, int x, int y, int width, int height, int fullWidth, int fullHeight,
+                            PixelFormat& resultFormat, PixelFormat format, int maxNodes, int firstNode) {
+    if (!m_initOK || (width < 1) || (height < 1) || (width > m_maxTileSize) || (height > m_maxTileSize)) { return 0; }
+    if (((width < fullWidth) || (height < fullHeight)) && (tileHalo(maxNodes, firstNode) < 0)) { return 0; }
+    format = adjustFormatForSource(format, io.sourceFormat());
+    float renderTime = m_lastRenderTime_ms;
+    int bypassCount = m_lastBypassCount, skipCount = m_lastSkipCount, composedCount = m_lastComposedCount;
+    swapTargets();
+    m_tiling = true;
+    m_tileX = x;
+    m_tileY = y;
+    m_fullWidth = fullWidth;
+    m_fullHeight = fullHeight;
+
+    // the source texture is kept, as it's re-used for the next tile
+    GLutil::clearError();
+    if (!m_tileSrcTex) {
+        glGenTextures(1, &m_tileSrcTex);
+        glBindTexture(GL_TEXTURE_2D, m_tileSrcTex);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+    allocateTexture(m_tileSrcTex, width, height, getTileSourceFormat(io.sourceFormat(), resolveFormat(format)));
+    glBindTexture(GL_TEXTURE_2D, 0);
+    m_allocFailed = !!GLutil::checkError("tile source buffer allocation");
+    GLuint result = 0;
+    if (!m_allocFailed && io.readSource(m_tileSrcTex, x, y, width, height)) {
+        render(m_tileSrcTex, width, height, format, maxNodes, firstNode);
+        if (!m_allocFailed) {
+            result = m_resultTex;
+            resultFormat = m_resultFormat;
+        }
+    }
+
+    m_tiling = false;
+    swapTargets();
+    m_lastRenderTime_ms = renderTime;
+    m_lastBypassCount = bypassCount;
+    m_lastSkipCount = skipCount;
+    m_lastComposedCount = composedCount;
+    return result;
+}
+
+//! tile I/O for the out-of-memory fallback: the source is read from a
+//! texture, and the result is assembled in another texture
+class TextureTileIO : public TileIO {
+    GLutil::FBO m_fbo;
+    GLuint m_srcTex;
+    GLuint& m_destTex;
+    int m_width;
+    int m_height;
+    PixelFormat m_srcFormat = PixelFormat::Int8;
+    PixelFormat m_destFormat = PixelFormat::DontCare;
+    bool copy(GLuint srcTex, int sx, int sy, GLuint destTex, int dx, int dy, int width, int height) {
+        GLutil::clearError();
+        if (!m_fbo.begin(srcTex)) { return false; }
+        glBindTexture(GL_TEXTURE_2D, destTex);
+        glCopyTexSubImage2D(GL_TEXTURE_2D, 0, dx, dy, sx, sy, width, height);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        m_fbo.end();
+        return !GLutil::checkError("tile copy");
+    }
+public:
+    TextureTileIO(GLuint srcTex, GLuint& destTex, int width, int height)
+        : m_srcTex(srcTex), m_destTex(destTex), m_width(width), m_height(height)
+    {
+        m_fbo.init();
+        // copies between the tiles and the source texture only work if
+        // they have compatible formats, so the tiles need to use its format
+        GLint glfmt = 0;
+        glBindTexture(GL_TEXTURE_2D, srcTex);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &glfmt);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        switch (glfmt) {
+            case GL_SRGB8_ALPHA8:    m_srcFormat = PixelFormat::SRGB8;   break;
+            case GL_RGBA16:
+            case GL_RGB16:           m_srcFormat = PixelFormat::Int16;   break;
+            case GL_RGBA16F:
+            case GL_RGB16F:
+            case GL_R11F_G11F_B10F:  m_srcFormat = PixelFormat::Float16; break;
+            case GL_RGBA32F:
+            case GL_RGB32F:          m_srcFormat = PixelFormat::Float32; break;
+            default:                 m_srcFormat = PixelFormat::Int8;    break;
+        }
+    }
+    inline PixelFormat destFormat() const { return m_destFormat; }
+    PixelFormat sourceFormat() const override { return m_srcFormat; }
+    bool readSource(GLuint tex, int x, int y, int width, int height) override {
+        return copy(m_srcTex, x, y, tex, 0, 0, width, height);
+    }
+    bool writeResult(GLuint tex, PixelFormat format, int texX, int texY, int x, int y, int width, int height) override {
+        if (!m_destTex) {
+            GLutil::clearError();
+            glGenTextures(1, &m_destTex);
+            glBindTexture(GL_TEXTURE_2D, m_destTex);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            allocateTexture(m_destTex, m_width, m_height, format);
+            glBindTexture(GL_TEXTURE_2D, 0);
+            m_destFormat = format;
+            if (GLutil::checkError("tiled result buffer allocation")) { return false; }
+        }
+        return copy(tex, texX, texY, m_destTex, x, y, width, height);
+    }
+};
+
+void Pipeline::renderFallback(GLuint srcTex, int width, int height, PixelFormat format, int maxNodes, int firstNode) {
+    #ifndef NDEBUG
+        fprintf(stderr, "out of video memory, falling back to tiled rendering\n");
+    #endif
+    if (m_tiledResultTex) {
+        glDeleteTextures(1, &m_tiledResultTex);
+        m_tiledResultTex = 0;
+    }
+    freePool();
+    TextureTileIO io(srcTex, m_tiledResultTex, width, height);
+    bool ok = renderTiled(io, width, height, format, maxNodes, firstNode, m_maxTileSize / 2);
+    if (ok && m_tiledResultTex) {
+        m_resultTex = m_tiledResultTex;
+        m_resultFormat = io.destFormat();
+    } else {
+        // nothing we can do; show the unprocessed image at least
+        m_resultTex = srcTex;
+        m_resultFormat = resolveFormat(format);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static GLenum getSampleType(PixelFormat format) {
+    switch (format) {
+        case PixelFormat::Int16:   return GL_UNSIGNED_SHORT;
+        case PixelFormat::Float32: return GL_FLOAT;
+        default:                   return GL_UNSIGNED_BYTE;
+    }
+}
+
+static PixelFormat getSampleFormat(int bytesPerSample) {
+    return (bytesPerSample == 4) ? PixelFormat::Float32
+         : (bytesPerSample == 2) ? PixelFormat::Int16
+         :                         PixelFormat::Int8;
+}
+
+//! upload a region of an RGBA image in memory into a texture
+static bool uploadTile(GLuint tex, const void* src, int srcWidth, PixelFormat srcFormat, int x, int y, int width, int height) {
+    GLutil::clearError();
+    glBindTexture(GL_TEXTURE_2D, tex);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, srcWidth);
+    glPixelStorei(GL_UNPACK_SKIP_PIXELS, x);
+    glPixelStorei(GL_UNPACK_SKIP_ROWS, y);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, getSampleType(srcFormat), src);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+    glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return !GLutil::checkError("tile upload");
+}
+
+//! read a region of a texture into an RGBA image in memory
+//! \param dest  position of the region's top-left pixel in the image
+static bool readbackTile(GLutil::FBO& fbo, GLuint tex, PixelFormat format, int texX, int texY, int width, int height,
+                         uint8_t* dest, int destWidth, PixelFormat destFormat) {
+    size_t stride = size_t(destWidth) * size_t(getBytesPerPixel(destFormat));
+    GLutil::clearError();
+    if (!fbo.begin(tex)) { return false; }
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glPixelStorei(GL_PACK_ROW_LENGTH, destWidth);
+    glReadPixels(texX, texY, width, height, GL_RGBA, getSampleType(destFormat), dest);
+    glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+    fbo.end();
+    if (GLutil::checkError("tile readback")) { return false; }
+
+    // texture swizzles don't apply to readback, so grayscale results
+    // need to be expanded manually
+    if (isSingleChannel(format)) {
+        for (int row = 0;  row < height;  ++row) {
+            uint8_t* p = &dest[size_t(row) * stride];
+            for (int col = 0;  col < width;  ++col) {
+                switch (destFormat) {
+                    case PixelFormat::Int16:   { uint16_t* v = &reinterpret_cast<uint16_t*>(p)[col * 4];  v[1] = v[2] = v[0]; } break;
+                    case PixelFormat::Float32: { float*    v = &reinterpret_cast<float*>   (p)[col * 4];  v[1] = v[2] = v[0]; } break;
+                    default:                   { uint8_t*  v = &p[col * 4];                              v[1] = v[2] = v[0]; } break;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+MemoryTileIO::MemoryTileIO(const void* src, int srcWidth, PixelFormat srcFormat,
+                           void* dest, int destWidth, PixelFormat destFormat)
+    : m_src(src), m_srcWidth(srcWidth), m_srcFormat(srcFormat),
+      m_dest(dest), m_destWidth(destWidth), m_destFormat(destFormat)
+{
+    m_fbo.init();
+}
+
+bool MemoryTileIO::readSource(GLuint tex, int x, int y, int width, int height) {
+    return uploadTile(tex, m_src, m_srcWidth, m_srcFormat, x, y, width, height);
+}
+
+bool MemoryTileIO::writeResult(GLuint tex, PixelFormat format, int texX, int texY, int x, int y, int width, int height) {
+    size_t bpp = size_t(getBytesPerPixel(m_destFormat));
+    uint8_t* dest = &static_cast<uint8_t*>(m_dest)[(size_t(y) * size_t(m_destWidth) + size_t(x)) * bpp];
+    return readbackTile(m_fbo, tex, format, texX, texY, width, height, dest, m_destWidth, m_destFormat);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+StreamingTileIO::StreamingTileIO(const void* src, int srcWidth, PixelFormat srcFormat, ImageUtil::RowWriter& writer)
+    : m_src(src), m_srcWidth(srcWidth), m_srcFormat(srcFormat), m_writer(writer)
+{
+    init();
+}
+
+StreamingTileIO::StreamingTileIO(ImageUtil::RowReader& reader, ImageUtil::RowWriter& writer)
+    : m_srcWidth(reader.width()), m_srcFormat(getSampleFormat(reader.bytesPerSample())),
+      m_reader(&reader), m_writer(writer)
+{
+    init();
+}
+
+void StreamingTileIO::init() {
+    m_destFormat = getSampleFormat(m_writer.bytesPerSample());
+    m_fbo.init();
+}
+
+StreamingTileIO::~StreamingTileIO() {
+    wait();
+}
+
+bool StreamingTileIO::wait() {
+    return !m_pending.valid() || m_pending.get();
+}
+
+bool StreamingTileIO::readSource(GLuint tex, int x, int y, int width, int height) {
+    if (!m_reader) {
+        return uploadTile(tex, m_src, m_srcWidth, m_srcFormat, x, y, width, height);
+    }
+    if (y < m_srcStart) {
+        #ifndef NDEBUG
+            fprintf(stderr, "streaming tile source: row %d has already been discarded\n", y);
+        #endif
+        return false;
+    }
+
+    // decode the missing rows, then drop the ones that aren't needed
+    // any longer (tiles are requested in reading order)
+    size_t rowSize = m_reader->rowSize();
+    if (m_srcEnd < (y + height)) {
+        size_t have = m_srcRows.size();
+        m_srcRows.resize(have + size_t(y + height - m_srcEnd) * rowSize);
+        if (!m_reader->readRows(&m_srcRows[have], y + height - m_srcEnd)) { return false; }
+        m_srcEnd = y + height;
+    }
+    if (y > m_srcStart) {
+        m_srcRows.erase(m_srcRows.begin(), m_srcRows.begin() + ptrdiff_t(size_t(y - m_srcStart) * rowSize));
+        m_srcStart = y;
+    }
+    return uploadTile(tex, m_srcRows.data(), m_srcWidth, m_srcFormat, x, 0, width, height);
+}
+
+bool StreamingTileIO::writeResult(GLuint tex, PixelFormat format, int texX, int texY, int x, int y, int width, int height) {
+    // the tiles of a stripe are assembled in the current stripe buffer
+    std::vector<uint8_t>& stripe = m_stripe[m_current];
+    size_t rowSize = m_writer.rowSize();
+    if (!x) { stripe.resize(size_t(height) * rowSize); }
+    if ((y != m_row) || (stripe.size() < (size_t(height) * rowSize))) { return false; }
+    uint8_t* dest = &stripe[size_t(x) * size_t(getBytesPerPixel(m_destFormat))];
+    if (!readbackTile(m_fbo, tex, format, texX, texY, width, height, dest, m_writer.width(), m_destFormat)) { return false; }
+    if ((x + width) < m_writer.width()) { return true; }
+
+    // stripe complete -> encode it in the background while the next one
+    // is being rendered into the other buffer
+    if (!wait()) { return false; }
+    ImageUtil::RowWriter* writer = &m_writer;
+    const uint8_t* rows = stripe.data();
+    m_pending = std::async(std::launch::async, [writer, rows, height] () -> bool {
+        return writer->writeRows(rows, height);
+    });
+    m_row += height;
+    m_current ^= 1;
+    return true;
+}
+
+bool StreamingTileIO::rewind() {
+    // once anything has been written or source rows have been dropped,
+    // there's no way back
+    return !m_row && !m_srcStart;
+}
+
+bool StreamingTileIO::finish() {
+    bool ok = wait();
+    return m_writer.finish() && ok;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+PixelFormat RawImageTileIO::sourceFormat() const {
+    return getSampleFormat(m_info.bytesPerSample);
+}
+
+bool RawImageTileIO::readSource(GLuint tex, int x, int y, int width, int height) {
+    m_buffer.resize(size_t(width) * size_t(height) * 4u * size_t(m_info.bytesPerSample));
+    if (!ImageUtil::readRawImageRegion(m_data, m_info, x, y, width, height, m_buffer.data())) { return false; }
+    return uploadTile(tex, m_buffer.data(), width, getSampleFormat(m_info.bytesPerSample), 0, 0, width, height);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 
 }  // namespace GIPS
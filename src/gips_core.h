@@ -3,17 +3,23 @@
 
 #pragma once
 
+#include <cstdint>
+
 #include <string>
 #include <vector>
 #include <type_traits>
+#include <future>
+#include <atomic>
 
 #include "gl_header.h"
 #include "gl_util.h"
 #include "file_util.h"
+#include "image_util.h"
 
 namespace GIPS {
 
-constexpr int MaxPasses = 4;
+constexpr int MaxNamedBuffers = 14;  //!< texture units 2 to 15
+constexpr int DefaultTileHalo = 64;  //!< tile overlap for nodes without '@halo'
 
 
 enum class ParameterType {
@@ -37,8 +43,13 @@ enum class CoordMapMode {
 
 enum class PixelFormat {
     DontCare =   0,
+    Gray8    =   1,  //!< single-channel (luminance only) formats
+    Gray16F  =   2,
     Int8     =   8,
+    SRGB8    =   9,  //!< 8-bit sRGB-encoded, processed in linear light
+    RGB10A2  =  10,
     Int16    =  16,
+    RGB11F   = 111,  //!< R11G11B10F, no alpha
     Float16  = 116,
     Float32  = 132,
 };
@@ -48,6 +59,40 @@ inline bool operator< (const PixelFormat a, const PixelFormat b) {
 }
 int getBytesPerPixel(PixelFormat fmt);
 const char* pixelFormatName(PixelFormat fmt);
+//! determine the smallest format that satisfies two format requests
+//! (color, precision, floating point and alpha), e.g. Float16 for Int16
+//! and RGB11F; sRGB is only chosen if both requests ask for it
+PixelFormat mergePixelFormats(PixelFormat a, PixelFormat b);
+inline bool isSingleChannel(PixelFormat fmt) {
+    return (fmt == PixelFormat::Gray8) || (fmt == PixelFormat::Gray16F);
+}
+inline bool isHighPrecision(PixelFormat fmt) {
+    return (fmt != PixelFormat::DontCare) && (fmt != PixelFormat::Gray8)
+        && (fmt != PixelFormat::Int8)     && (fmt != PixelFormat::SRGB8);
+}
+inline bool isFloat(PixelFormat fmt) {
+    return (fmt == PixelFormat::Gray16F) || (fmt == PixelFormat::RGB11F)
+        || (fmt == PixelFormat::Float16) || (fmt == PixelFormat::Float32);
+}
+
+
+//! 3D color lookup table, as stored in .cube files
+struct LUT3D {
+    std::string title;
+    int size = 0;
+    float domainMin[3] = { 0.0f, 0.0f, 0.0f };
+    float domainMax[3] = { 1.0f, 1.0f, 1.0f };
+    std::vector<float> data;  //!< RGB triplets, red index varying fastest
+
+    bool load(const char* filename, std::string& err);
+    bool save(const char* filename) const;
+
+    //! create or update a 3D texture with the LUT contents
+    bool upload(GLuint& tex) const;
+
+    //! generate the GIPS shader code that applies the LUT
+    std::string shaderCode() const;
+};
 
 
 class Parameter {
@@ -63,11 +108,18 @@ class Parameter {
     float m_value[4]            = { 0.0f, };
     float m_oldValue[4]         = { 0.0f, };
     float m_defaultValue[4]     = { 0.0f, };
-    GLint m_location[MaxPasses] = { 0, };
+    float m_identityValue[4]    = { 0.0f, };
+    float m_renderValue[4]      = { 0.0f, };  //!< value used for rendering, see Pipeline::latchParameters()
+    bool m_hasIdentity          = false;
+    std::vector<GLint> m_location;  //!< per pass
+    void setUniform(GLint location) const;
+    bool atIdentity(const float* value) const;
 public:
     inline Parameter() {}
     bool changed();
     void reset();
+    bool atIdentity() const;
+    inline       bool    hasIdentity() const { return m_hasIdentity; }
     inline const char*   name()     const { return m_name.c_str(); }
     inline const char*   desc()     const { return m_desc.empty() ? m_name.c_str() : m_desc.c_str(); }
     inline const char*   format()   const { return m_format.empty() ? "%.2f" : m_format.c_str(); }
@@ -92,14 +144,49 @@ class Node {
         GLint locImageSize = -1;
         GLint locRel2Map = -1;
         GLint locMap2Tex = -1;
+        GLint locLUT = -1;
+        GLint locMono = -1;
+        GLint locTileOffset = -1;
+        int outputBuffer = -1;  //!< index into m_buffers, or -1 for none
+        float scale = 1.0f;     //!< resolution relative to the pipeline's image size
+        bool upsample = false;  //!< implicit upsampling pass (no user code)
+        bool mipmap = false;    //!< generate mipmaps of the input texture
+        PixelFormat format = PixelFormat::DontCare;  //!< preferred output format
+        float msPerMPixel = 0.0f;  //!< measured cost, for time-sliced rendering
         inline PassData() {}
-    } m_passes[MaxPasses];
+    };
+    std::vector<PassData> m_passes;
+    //! named intermediate buffer ('@output=name')
+    struct BufferInfo {
+        std::string name;
+        int producer = -1;    //!< index of the pass that writes the buffer
+        int lastReader = -1;  //!< index of the last pass that reads it
+    };
+    std::vector<BufferInfo> m_buffers;
     std::vector<Parameter> m_params;
     bool m_programChanged = true;
     bool m_enabled = true;
     bool m_wasEnabled = false;
+    bool m_renderEnabled = true;      //!< m_enabled as of the last Pipeline::latchParameters()
+    bool m_invalidateCache = false;   //!< parameters changed since the last latchParameters()
+    std::atomic<bool> m_bypassed { false };
+    bool m_inputIndependent = false;
+    GLuint m_cacheTex = 0;
+    PixelFormat m_cacheFormat = PixelFormat::DontCare;
+    bool m_cacheValid = false;
+    bool m_pointwise = false;   //!< RGB->RGB and position-independent, i.e. bakeable into a LUT
+    bool m_pixelLocal = false;  //!< never reads pixels other than the one it writes
+    GLuint m_lutTex = 0;
+    bool m_isMap = false;
+    std::string m_mapCode;                   //!< source code of map() nodes
+    std::vector<std::string> m_globalNames;  //!< global identifiers in m_mapCode
+    unsigned m_loadSerial = 0;
     FileUtil::FileFingerprint m_fp;
     PixelFormat m_preferredFormat = PixelFormat::DontCare;
+    int m_halo = -1;  //!< declared with '@halo', or -1 if unknown
+    void freeCache();
+    void freeLUT();
+    bool renderIdentity() const;  //!< isIdentity() with the latched values
 
 public:
     bool load(const char* filename, const GLutil::Shader& vs, const FileUtil::FileFingerprint* fp=nullptr);
@@ -108,6 +195,18 @@ public:
     bool changed();
     void reset();
 
+    //! check whether all parameters with an '@identity' token are at their
+    //! identity value (and there is at least one such parameter), i.e.
+    //! whether the node can be skipped without changing the result
+    bool isIdentity() const;
+
+    //! number of pixels around each tile that the node needs to see to
+    //! produce correct results in tiled mode; this is either declared
+    //! with '@halo', or a conservative guess
+    //! \returns -1 if the node may read from anywhere in the image and
+    //!          thus can't be processed in tiles at all
+    int halo() const;
+
     inline const char*      name()       const { return m_name.c_str(); }
     inline const char*      filename()   const { return m_filename.c_str(); }
     inline       bool       hasErrors()  const { return !m_errors.empty(); }
@@ -115,6 +214,11 @@ public:
     inline       bool       good()       const { return (m_passCount > 0); }
     inline       int        passCount()  const { return m_passCount; }
     inline       bool       enabled()    const { return m_enabled; }
+    inline       bool       bypassed()   const { return m_bypassed; }
+    inline       bool inputIndependent() const { return m_inputIndependent; }
+    inline       bool       pointwise()  const { return m_pointwise; }
+    inline       bool       isLUT()      const { return (m_lutTex != 0); }
+    inline       bool       isMap()      const { return m_isMap; }
     inline       int        paramCount() const { return int(m_params.size()); }
     inline const Parameter& param(int i) const { return m_params[size_t(i)]; }
     inline       Parameter& param(int i)       { return m_params[size_t(i)]; }
@@ -129,6 +233,112 @@ public:
     inline Node() {}
     inline Node(const char* filename, const GLutil::Shader& vs) { load(filename, vs); }
     Node(const Node&) = delete;
+    inline ~Node() { freeCache(); freeLUT(); }
+};
+
+
+//! data source and destination for Pipeline::renderTiled()
+class TileIO {
+public:
+    //! format in which the source image is stored; readSource() gets a
+    //! texture of that precision (Int8, SRGB8, Int16, Float16 or Float32)
+    virtual PixelFormat sourceFormat() const = 0;
+
+    //! upload a region of the source image into an already allocated
+    //! texture that has exactly the region's size
+    virtual bool readSource(GLuint tex, int x, int y, int width, int height) = 0;
+
+    //! store the valid part of a rendered tile; (texX, texY) is the
+    //! position of that part in the tile's result texture, (x, y) its
+    //! position in the whole image
+    virtual bool writeResult(GLuint tex, PixelFormat format, int texX, int texY,
+                             int x, int y, int width, int height) = 0;
+
+    //! prepare for starting over with a different tile size, after
+    //! running out of video memory
+    //! \returns false if the tiles can't be processed once again
+    virtual bool rewind() { return true; }
+
+    inline TileIO() {}
+    TileIO(const TileIO&) = delete;
+    virtual ~TileIO() {}
+};
+
+
+//! tiled rendering from and into RGBA images in system memory
+class MemoryTileIO : public TileIO {
+    GLutil::FBO m_fbo;
+    const void* m_src;
+    int m_srcWidth;
+    PixelFormat m_srcFormat;
+    void* m_dest;
+    int m_destWidth;
+    PixelFormat m_destFormat;
+public:
+    //! \param srcFormat   sample type of the source: Int8 (uint8_t),
+    //!                    Int16 (uint16_t) or Float32 (float)
+    //! \param destFormat  sample type of the destination, as above
+    MemoryTileIO(const void* src, int srcWidth, PixelFormat srcFormat,
+                 void* dest, int destWidth, PixelFormat destFormat);
+    inline PixelFormat sourceFormat() const override { return m_srcFormat; }
+    bool readSource(GLuint tex, int x, int y, int width, int height) override;
+    bool writeResult(GLuint tex, PixelFormat format, int texX, int texY,
+                     int x, int y, int width, int height) override;
+};
+
+
+//! tiled rendering into a file that's written sequentially; the source
+//! is either an image in memory or decoded row by row, and the result is
+//! handed over to the writer in stripes, which are encoded in a background
+//! thread while the next stripe is being rendered
+class StreamingTileIO : public TileIO {
+    GLutil::FBO m_fbo;
+    const void* m_src = nullptr;
+    int m_srcWidth;
+    PixelFormat m_srcFormat;
+    ImageUtil::RowReader* m_reader = nullptr;
+    std::vector<uint8_t> m_srcRows;  //!< decoded source rows [m_srcStart, m_srcEnd)
+    int m_srcStart = 0;
+    int m_srcEnd = 0;
+    ImageUtil::RowWriter& m_writer;
+    PixelFormat m_destFormat;
+    std::vector<uint8_t> m_stripe[2];  //!< stripe being rendered, stripe being encoded
+    int m_current = 0;
+    std::future<bool> m_pending;       //!< encoder job for the other stripe
+    int m_row = 0;                     //!< first row of the current stripe
+    bool wait();
+    void init();
+public:
+    //! \param srcFormat  sample type of the source: Int8 (uint8_t),
+    //!                   Int16 (uint16_t) or Float32 (float)
+    StreamingTileIO(const void* src, int srcWidth, PixelFormat srcFormat, ImageUtil::RowWriter& writer);
+    //! source rows are decoded on demand; they are only kept as long as
+    //! they may be needed by the current row of tiles
+    StreamingTileIO(ImageUtil::RowReader& reader, ImageUtil::RowWriter& writer);
+    inline PixelFormat sourceFormat() const override { return m_srcFormat; }
+    bool readSource(GLuint tex, int x, int y, int width, int height) override;
+    bool writeResult(GLuint tex, PixelFormat format, int texX, int texY,
+                     int x, int y, int width, int height) override;
+    bool rewind() override;
+    //! wait until all stripes are encoded and finish the output file
+    bool finish();
+    ~StreamingTileIO();
+};
+
+
+//! random-access tile source for an uncompressed PPM, PAM or PFM file in
+//! memory (typically a file mapping, which must stay valid); regions are
+//! converted on the fly, so the image never needs to be decoded as a whole
+class RawImageTileIO : public TileIO {
+    const uint8_t* m_data;
+    ImageUtil::RawImageInfo m_info;
+    std::vector<uint8_t> m_buffer;
+public:
+    RawImageTileIO(const uint8_t* data, const ImageUtil::RawImageInfo& info) : m_data(data), m_info(info) {}
+    PixelFormat sourceFormat() const override;
+    bool readSource(GLuint tex, int x, int y, int width, int height) override;
+    //! this is a source only; writing always fails
+    bool writeResult(GLuint, PixelFormat, int, int, int, int, int, int) override { return false; }
 };
 
 
@@ -137,14 +347,113 @@ class Pipeline {
     int m_width = 0;
     int m_height = 0;
     PixelFormat m_format = PixelFormat::DontCare;
+    PixelFormat m_resultFormat = PixelFormat::DontCare;
+    bool m_mixedPrecision = false;  //!< requested by the user
+    bool m_mixedActive = false;     //!< actually in effect for the last render
     GLuint m_tex[2] = {0,0};
+    //! sampler objects for the pass inputs, indexed by getSampler(); they
+    //! override the textures' own filter and wrap modes, so the caller's
+    //! source texture is never modified
+    GLuint m_samplers[4] = {0,0,0,0};
     GLutil::FBO m_fbo;
     bool m_pipelineChanged = true;
     GLutil::Shader m_vs;
+    GLutil::Program m_copyProg;
     GLuint m_resultTex = 0;
     bool m_initialized = false;
     bool m_initOK = false;
     float m_lastRenderTime_ms = 0.0f;
+    int m_lastBypassCount = 0;
+    int m_lastSkipCount = 0;
+    int m_lastComposedCount = 0;
+    int m_lastTileCount = 0;
+    bool m_lastRenderCancelled = false;
+
+    // time-sliced rendering state
+    float m_sliceBudget_ms = 0.0f;  //!< target duration of a single draw; 0 = no slicing
+    std::atomic<bool> m_cancel { false };
+    std::atomic<float> m_progress { 1.0f };
+    int m_progressDone = 0;    //!< passes completed in the current render
+    int m_progressTotal = 0;   //!< passes that the current render consists of
+    //! draw the full-viewport quad, split into bands if time slicing is
+    //! enabled; \returns false if the render has been cancelled halfway
+    bool drawSliced(int width, int height, float& msPerMPixel);
+
+    // tiled rendering state; while a tile is rendered, m_width and
+    // m_height are the size of the tile, not of the whole image
+    bool m_tiling = false;
+    int m_tileX = 0;           //!< position of the current tile
+    int m_tileY = 0;
+    int m_fullWidth = 0;       //!< size of the whole image
+    int m_fullHeight = 0;
+    int m_maxTileSize = 0;
+    bool m_allocFailed = false;  //!< intermediate buffers didn't fit into video memory
+    GLuint m_tileSrcTex = 0;
+    GLuint m_tiledResultTex = 0;  //!< result of the out-of-memory fallback
+    const char* m_tilingError = nullptr;  //!< why the last tiled render wasn't possible
+    //! size of the tiles to use, at least the requested size; 0 if the
+    //! image can't be processed in tiles with the given overlap
+    int getTileSize(int width, int height, int halo, int tileSize) const;
+    void getPassMapping(CoordMapMode mode, int width, int height, float scale,
+                        GLfloat rel2map[4], GLfloat map2tex[4], GLfloat imageSize[2]) const;
+    //! set a pass's gips_tile_offset uniform (the tile's position in the image)
+    void setTileOffset(GLint location, float scale) const;
+    void renderFallback(GLuint srcTex, int width, int height, PixelFormat format, int maxNodes, int firstNode);
+
+    //! single-pass program for a run of consecutive map() nodes
+    struct MapChain {
+        std::vector<const Node*> nodes;
+        std::vector<unsigned> serials;
+        GLutil::Program program;
+        bool ok = false;
+        bool used = false;
+        GLint locImageSize = -1;
+        GLint locMono = -1;
+        GLint locTileOffset = -1;
+        std::vector<GLint> locRel2Map;  //!< per node
+        std::vector<GLint> locMap2Tex;  //!< per node
+        std::vector<GLint> locParams;   //!< per node and parameter
+        float msPerMPixel = 0.0f;       //!< measured cost, for time-sliced rendering
+    };
+    std::vector<MapChain*> m_mapChains;
+
+    //! pool of textures for named intermediate buffers
+    struct PooledTexture {
+        GLuint tex = 0;
+        int width = 0;
+        int height = 0;
+        PixelFormat format = PixelFormat::DontCare;
+        bool inUse = false;
+    };
+    std::vector<PooledTexture> m_pool;
+    GLuint m_pooledResult = 0;  //!< pooled texture holding the current result
+
+    //! render targets of the "other" context: tiles are rendered with
+    //! these swapped in, so the interactive result survives tiling
+    struct RenderTargets {
+        int width = 0;
+        int height = 0;
+        PixelFormat format = PixelFormat::DontCare;
+        PixelFormat resultFormat = PixelFormat::DontCare;
+        bool mixedActive = false;
+        GLuint tex[2] = {0,0};
+        GLuint resultTex = 0;
+        std::vector<PooledTexture> pool;
+        GLuint pooledResult = 0;
+    } m_otherTargets;
+    void swapTargets();
+    GLuint acquireTexture(int width, int height, PixelFormat format);
+    void releaseTexture(GLuint tex);
+    void freePool();
+    inline GLuint getSampler(bool texFilter, bool mipmap) const
+        { return m_samplers[(texFilter ? 1 : 0) + (mipmap ? 2 : 0)]; }
+    //! copy the (caller-owned) source texture into a pooled texture,
+    //! e.g. to generate mipmaps for it; \returns 0 on failure
+    GLuint copySource(GLuint srcTex);
+    MapChain* getMapChain(const std::vector<const Node*>& nodes);
+    bool buildMapChain(MapChain& chain);
+    bool renderMapChain(MapChain& chain, GLuint outTex, PixelFormat format);
+    void clearMapChains(bool unusedOnly=false);
 
 public:
     bool init();
@@ -152,7 +461,17 @@ public:
     inline       bool            good()      const { return m_initOK; }
     inline       GLuint          resultTex() const { return m_resultTex; }
     inline       PixelFormat     format()    const { return m_format; }
+    inline       PixelFormat   resultFormat() const { return m_resultFormat; }
+    inline       bool        mixedPrecision() const { return m_mixedPrecision; }
+    inline       void     setMixedPrecision(bool m) { m_mixedPrecision = m; m_pipelineChanged = true; }
     inline       float lastRenderTime_ms()   const { return m_lastRenderTime_ms; }
+    inline       int   lastBypassCount()     const { return m_lastBypassCount; }
+    inline       int   lastSkipCount()       const { return m_lastSkipCount; }
+    inline       int   lastComposedCount()   const { return m_lastComposedCount; }
+    inline       int   lastTileCount()       const { return m_lastTileCount; }
+    inline       bool lastRenderCancelled()  const { return m_lastRenderCancelled; }
+    inline       int             poolSize()  const { return int(m_pool.size()); }
+    uint64_t poolMemory() const;
     inline       int             nodeCount() const { return int(m_nodes.size()); }
     inline const Node&           node(int i) const { return *m_nodes[size_t(i)]; }
     inline       Node&           node(int i)       { return *m_nodes[size_t(i)]; }
@@ -168,13 +487,91 @@ public:
     bool changed();
     inline void  markAsChanged() { m_pipelineChanged = true; }
 
+    //! take over the current parameter values and node states for all
+    //! subsequent rendering; this allows the UI to modify parameters
+    //! while another thread renders with the previous ones
+    void latchParameters();
+
+    //! exchange the pipeline's framebuffer object with another one; FBOs
+    //! can't be shared between GL contexts, so rendering in a different
+    //! context must use an FBO that has been created in that context
+    inline void swapFramebuffer(GLutil::FBO& fbo)
+        { std::swap(m_fbo.id, fbo.id);  std::swap(m_fbo.status, fbo.status); }
+
+    //! copy the result into another texture, which is (re-)allocated in
+    //! the result's format
+    bool copyResult(GLuint destTex);
+
     void reload(bool force=false);
     void clear();
 
-    void render(GLuint srcTex, int width, int height, PixelFormat format=PixelFormat::DontCare, int maxNodes=-1);
+    void render(GLuint srcTex, int width, int height, PixelFormat format=PixelFormat::DontCare, int maxNodes=-1, int firstNode=0);
+
+    //! split each pass of render() into horizontal bands that take about
+    //! the given time each, waiting for every band to finish before the
+    //! next one is drawn; this keeps the GPU responsive for other contexts
+    //! and makes renders cancellable (0 = draw every pass at once, which
+    //! is also what tiled rendering always does)
+    inline void setSliceBudget(float budget_ms) { m_sliceBudget_ms = budget_ms; }
+
+    //! request (or withdraw the request) to stop a running time-sliced
+    //! render after the current band; the flag isn't reset by render(),
+    //! and as long as it's set, every render is cancelled right away
+    //! \note This and progress() are the only methods that may be called
+    //!       from another thread while rendering.
+    inline void cancel(bool c=true) { m_cancel = c; }
+
+    //! completed fraction of the running render
+    inline float progress() const { return m_progress; }
+
+    //! render an image of arbitrary size in overlapping tiles; the source
+    //! is read and the result is written through a TileIO object, so
+    //! neither of them needs to fit into a single texture
+    //! \param tileSize  maximum tile size, including the overlap;
+    //!                  0 = largest size supported by the GL
+    //! \note The result of the last render() call stays available, but
+    //!       the statistics (render time, tile count) describe the tiles.
+    bool renderTiled(TileIO& io, int width, int height, PixelFormat format=PixelFormat::DontCare, int maxNodes=-1, int firstNode=0, int tileSize=0);
+
+    //! render a single tile of a larger image; the result of the last
+    //! render() call (and its statistics) stay available
+    //! \param x, y         position of the tile in the whole image
+    //! \param fullWidth    size of the whole image
+    //! \param resultFormat receives the format of the result
+    //! \returns the tile's result texture, which stays valid until the
+    //!          next call, or 0 if rendering failed
+    GLuint renderTile(TileIO& io, int x, int y, int width, int height, int fullWidth, int fullHeight,
+                      PixelFormat& resultFormat, PixelFormat format=PixelFormat::DontCare, int maxNodes=-1, int firstNode=0);
+
+    //! release the buffers used for tiled rendering
+    void freeTileBuffers();
+
+    //! determine the overlap between tiles that a range of nodes requires
+    //! \returns -1 if any of the nodes can't be processed in tiles
+    int tileHalo(int maxNodes=-1, int firstNode=0) const;
+
+    //! check whether an image can be processed with renderTiled()
+    //! \returns nullptr if it can, or a message explaining why not
+    const char* checkTiling(int width, int height, int maxNodes=-1, int firstNode=0, int tileSize=0) const;
+
+    //! reason why the last tiled render (including the out-of-memory
+    //! fallback of render()) failed before rendering anything, or nullptr
+    inline const char* tilingError() const { return m_tilingError; }
+
+    //! render an identity lattice through a run of pointwise (color-only)
+    //! nodes and store the result as a 3D LUT
+    bool bakeLUT(LUT3D& lut, int size, int firstNode, int nodeCount);
 
     PixelFormat detectFormat() const;
 
+    //! determine the base format that render() uses for a requested format
+    PixelFormat resolveFormat(PixelFormat requested) const;
+
+    //! sRGB processing is only possible for 8-bit sources, as there are no
+    //! high-precision sRGB texture formats; for other sources, this returns
+    //! the linear format of matching precision to use instead
+    PixelFormat adjustFormatForSource(PixelFormat requested, PixelFormat sourceFormat) const;
+
     std::string serialize(int showIndex);
     int unserialize(char* data);
 
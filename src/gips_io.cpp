@@ -62,6 +62,8 @@ std::string Pipeline::serialize(int showIndex) {
         }
         if (!node.m_enabled) {
             f << ".enabled = 0\r\n";
+        } else if (node.isIdentity()) {
+            f << "; bypassed: all parameters at identity values\r\n";
         }
 
         for (size_t paramIndex = 0;  paramIndex < node.m_params.size();  ++paramIndex) {
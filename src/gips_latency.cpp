@@ -0,0 +1,116 @@
+// SPDX-FileCopyrightText: 2021 Martin J. Fiedler <keyj@emphy.de>
+// SPDX-License-Identifier: MIT
+
+#include <cstdio>
+
+#include <algorithm>
+
+#include "gips_latency.h"
+
+namespace GIPS {
+
+constexpr size_t MaxPendingEdits = 64;  //!< edits waiting for a result; older ones are dropped
+constexpr unsigned TraceSummaryInterval = 32;  //!< print a summary every N edits when tracing
+
+const float LatencyTracker::HistogramLimits_ms[LatencyTracker::HistogramBins] = {
+    8.0f, 17.0f, 33.0f, 50.0f, 100.0f, 250.0f, 1000.0f, 1.0e30f
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+void LatencyTracker::update(bool changed, unsigned generation) {
+    if (changed && m_hasInput) {
+        if (m_edits.size() >= MaxPendingEdits) { m_edits.erase(m_edits.begin()); }
+        Edit e;
+        e.generation = generation;
+        e.input = m_input;
+        e.change = Clock::now();
+        m_edits.push_back(e);
+    }
+    m_hasInput = false;
+}
+
+void LatencyTracker::rendered(unsigned generation) {
+    // results of outdated generations are never acquired, so their edits
+    // become visible with the first result of a later generation
+    auto now = Clock::now();
+    for (auto& e : m_edits) {
+        if (!e.rendered && (int(generation - e.generation) >= 0)) {
+            e.render = now;
+            e.rendered = true;
+        }
+    }
+}
+
+void LatencyTracker::presented() {
+    if (m_edits.empty()) { return; }
+    auto now = Clock::now();
+    size_t keep = 0;
+    for (size_t i = 0;  i < m_edits.size();  ++i) {
+        const Edit& e = m_edits[i];
+        if (!e.rendered) { m_edits[keep++] = e;  continue; }
+        Sample s;
+        s.change_ms  = ms(e.input,  e.change);
+        s.render_ms  = ms(e.change, e.render);
+        s.present_ms = ms(e.render, now);
+        if (m_history.size() < size_t(HistoryLength)) {
+            m_history.push_back(s);
+        } else {
+            m_history[m_historyPos] = s;
+        }
+        m_historyPos = (m_historyPos + 1u) % size_t(HistoryLength);
+        ++m_totalCount;
+        if (m_trace) {
+            fprintf(stderr, "latency: %.1f ms (input->change %.1f, render %.1f, present %.1f)\n",
+                    s.total_ms(), s.change_ms, s.render_ms, s.present_ms);
+            if (!(m_totalCount % TraceSummaryInterval)) { printStats(stderr); }
+        }
+    }
+    m_edits.resize(keep);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void LatencyTracker::getStats(Stats& stats) const {
+    stats = Stats();
+    stats.count = int(m_history.size());
+    if (m_history.empty()) { return; }
+    std::vector<float> totals;
+    totals.reserve(m_history.size());
+    for (const auto& s : m_history) {
+        float t = s.total_ms();
+        totals.push_back(t);
+        int bin = 0;
+        while ((bin < (HistogramBins - 1)) && (t > HistogramLimits_ms[bin])) { ++bin; }
+        ++stats.histogram[bin];
+    }
+    std::sort(totals.begin(), totals.end());
+    const auto percentile = [&totals] (int p) -> float {
+        return totals[std::min(totals.size() - 1u, (totals.size() * size_t(p)) / 100u)];
+    };
+    stats.p50_ms = percentile(50);
+    stats.p95_ms = percentile(95);
+    stats.p99_ms = percentile(99);
+    stats.max_ms = totals.back();
+}
+
+void LatencyTracker::printStats(FILE* f) const {
+    Stats stats;
+    getStats(stats);
+    if (!stats.count) { return; }
+    fprintf(f, "latency over the last %d edits: p50 %.1f ms, p95 %.1f ms, p99 %.1f ms, max %.1f ms\n",
+            stats.count, stats.p50_ms, stats.p95_ms, stats.p99_ms, stats.max_ms);
+    float lower = 0.0f;
+    for (int bin = 0;  bin < HistogramBins;  ++bin) {
+        if (bin < (HistogramBins - 1)) {
+            fprintf(f, "  %4.0f - %4.0f ms: %4d\n", lower, HistogramLimits_ms[bin], stats.histogram[bin]);
+        } else {
+            fprintf(f, "  %4.0f+       ms: %4d\n", lower, stats.histogram[bin]);
+        }
+        lower = HistogramLimits_ms[bin];
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+}  // namespace GIPS
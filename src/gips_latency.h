@@ -0,0 +1,95 @@
+// SPDX-FileCopyrightText: 2021 Martin J. Fiedler <keyj@emphy.de>
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <cstdio>
+
+#include <chrono>
+#include <vector>
+
+namespace GIPS {
+
+//! measures the delay between user input that changes the pipeline and
+//! the presentation of the first frame that shows the updated result
+//! ("input-to-photon" latency, minus the display's own delay); every edit
+//! is timestamped at four points:
+//! - input:   first input event (key, mouse, scroll) of the frame in which
+//!            the pipeline change was detected
+//! - change:  Pipeline::changed() reported the change
+//! - render:  a result of (at least) the changed pipeline was acquired
+//! - present: glfwSwapBuffers() returned after drawing that result
+class LatencyTracker {
+public:
+    using Clock = std::chrono::steady_clock;
+    static constexpr int HistoryLength = 256;  //!< number of edits the statistics cover
+    static constexpr int HistogramBins = 8;
+    static const float HistogramLimits_ms[HistogramBins];  //!< upper limits of the bins
+
+    struct Sample {
+        float change_ms = 0.0f;   //!< input -> change detected
+        float render_ms = 0.0f;   //!< change detected -> result available
+        float present_ms = 0.0f;  //!< result available -> frame presented
+        inline float total_ms() const { return change_ms + render_ms + present_ms; }
+    };
+
+    struct Stats {
+        int count = 0;
+        float p50_ms = 0.0f;
+        float p95_ms = 0.0f;
+        float p99_ms = 0.0f;
+        float max_ms = 0.0f;
+        int histogram[HistogramBins] = { 0, };
+    };
+
+private:
+    struct Edit {
+        unsigned generation = 0;
+        Clock::time_point input;
+        Clock::time_point change;
+        Clock::time_point render;
+        bool rendered = false;
+    };
+    std::vector<Edit> m_edits;      //!< edits that aren't on screen yet
+    std::vector<Sample> m_history;  //!< ring buffer of completed edits
+    size_t m_historyPos = 0;
+    Clock::time_point m_input;
+    bool m_hasInput = false;
+    bool m_trace = false;
+    unsigned m_totalCount = 0;
+
+    static inline float ms(Clock::time_point from, Clock::time_point to)
+        { return std::chrono::duration<float, std::milli>(to - from).count(); }
+
+public:
+    //! print every measurement (and a summary from time to time) to stderr
+    inline void setTrace(bool trace) { m_trace = trace; }
+    inline bool trace() const { return m_trace; }
+
+    //! note an input event; must be called from the GLFW input callbacks
+    inline void inputEvent() {
+        if (!m_hasInput) { m_input = Clock::now();  m_hasInput = true; }
+    }
+
+    //! to be called once per frame, after checking the pipeline for changes;
+    //! changes in frames without input (e.g. file reloads) aren't tracked
+    void update(bool changed, unsigned generation);
+
+    //! note that a result of the given pipeline generation is available
+    void rendered(unsigned generation);
+
+    //! note that the current frame has been presented
+    void presented();
+
+    void getStats(Stats& stats) const;
+    inline const Sample* lastSample() const
+        { return m_history.empty() ? nullptr : &m_history[(m_historyPos + m_history.size() - 1u) % m_history.size()]; }
+    inline unsigned totalCount() const { return m_totalCount; }
+    void printStats(FILE* f) const;
+
+    inline LatencyTracker() {}
+    LatencyTracker(const LatencyTracker&) = delete;
+};
+
+
+}  // namespace GIPS
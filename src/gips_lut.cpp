@@ -0,0 +1,230 @@
+// SPDX-FileCopyrightText: 2021 Martin J. Fiedler <keyj@emphy.de>
+// SPDX-License-Identifier: MIT
+
+#ifdef _MSC_VER
+    #define _CRT_SECURE_NO_WARNINGS  // prevent MSVC warnings
+#endif
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+
+#include <algorithm>
+#include <string>
+#include <sstream>
+#include <vector>
+
+#include "gl_header.h"
+#include "gl_util.h"
+#include "string_util.h"
+
+#include "gips_core.h"
+
+namespace GIPS {
+
+///////////////////////////////////////////////////////////////////////////////
+
+constexpr int MaxLUTSize = 256;
+
+bool LUT3D::load(const char* filename, std::string& err) {
+    int codeSize = 0;
+    char* code = StringUtil::loadTextFile(filename, codeSize);
+    if (!code) { err = "failed to load LUT file"; return false; }
+    title.clear();
+    size = 0;
+    data.clear();
+    for (int i = 0;  i < 3;  ++i) { domainMin[i] = 0.0f; domainMax[i] = 1.0f; }
+
+    size_t expected = 0;
+    bool ok = true;
+    char* line = code;
+    while (ok && line && *line) {
+        // split off the line and strip comments
+        char* next = strchr(line, '\n');
+        if (next) { *next++ = '\0'; }
+        char* hash = strchr(line, '#');
+        if (hash) { *hash = '\0'; }
+        line = StringUtil::skipWhitespace(line);
+        StringUtil::trimTrailingWhitespace(line);
+
+        // parse the line
+        float v[3];
+        if (!*line) {
+            // empty line
+        } else if (!strncmp(line, "TITLE", 5)) {
+            line = StringUtil::skipWhitespace(&line[5]);
+            if (*line == '"') { ++line; }
+            char* end = strchr(line, '"');
+            if (end) { *end = '\0'; }
+            title = line;
+        } else if (!strncmp(line, "LUT_3D_SIZE", 11)) {
+            size = atoi(&line[11]);
+            if ((size < 2) || (size > MaxLUTSize)) { err = "invalid LUT size"; ok = false; }
+            expected = size_t(size) * size_t(size) * size_t(size) * 3u;
+            data.reserve(expected);
+        } else if (!strncmp(line, "LUT_1D_SIZE", 11)) {
+            err = "1D LUTs are not supported"; ok = false;
+        } else if (sscanf(line, "DOMAIN_MIN %f %f %f", &v[0], &v[1], &v[2]) == 3) {
+            for (int i = 0;  i < 3;  ++i) { domainMin[i] = v[i]; }
+        } else if (sscanf(line, "DOMAIN_MAX %f %f %f", &v[0], &v[1], &v[2]) == 3) {
+            for (int i = 0;  i < 3;  ++i) { domainMax[i] = v[i]; }
+        } else if (sscanf(line, "LUT_3D_INPUT_RANGE %f %f", &v[0], &v[1]) == 2) {
+            for (int i = 0;  i < 3;  ++i) { domainMin[i] = v[0]; domainMax[i] = v[1]; }
+        } else if (sscanf(line, "%f %f %f", &v[0], &v[1], &v[2]) == 3) {
+            if (!size) { err = "LUT data before LUT_3D_SIZE"; ok = false; }
+            else if (data.size() >= expected) { err = "too much LUT data"; ok = false; }
+            else { data.insert(data.end(), v, v + 3); }
+        } else if (isupper(static_cast<unsigned char>(*line))) {
+            // unknown keyword -> ignore
+        } else {
+            err = "syntax error in LUT file"; ok = false;
+        }
+        line = next;
+    }
+    ::free(code);
+
+    if (ok && !size) { err = "no LUT_3D_SIZE found"; ok = false; }
+    if (ok && (data.size() != expected)) { err = "incomplete LUT data"; ok = false; }
+    for (int i = 0;  ok && (i < 3);  ++i) {
+        if (!(domainMax[i] > domainMin[i])) { err = "invalid LUT domain"; ok = false; }
+    }
+    if (!ok) { size = 0; data.clear(); }
+    return ok;
+}
+
+bool LUT3D::save(const char* filename) const {
+    if ((size < 2) || (data.size() != size_t(size) * size_t(size) * size_t(size) * 3u)) { return false; }
+    FILE* f = fopen(filename, "wb");
+    if (!f) { return false; }
+    if (!title.empty()) { fprintf(f, "TITLE \"%s\"\n", title.c_str()); }
+    fprintf(f, "LUT_3D_SIZE %d\n", size);
+    fprintf(f, "DOMAIN_MIN %.6f %.6f %.6f\n", domainMin[0], domainMin[1], domainMin[2]);
+    fprintf(f, "DOMAIN_MAX %.6f %.6f %.6f\n", domainMax[0], domainMax[1], domainMax[2]);
+    for (size_t i = 0;  i < data.size();  i += 3) {
+        fprintf(f, "%.6f %.6f %.6f\n", data[i], data[i+1], data[i+2]);
+    }
+    bool ok = !ferror(f);
+    return (fclose(f) == 0) && ok;
+}
+
+bool LUT3D::upload(GLuint& tex) const {
+    GLutil::clearError();
+    if (!tex) { glGenTextures(1, &tex); }
+    glBindTexture(GL_TEXTURE_3D, tex);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexImage3D(GL_TEXTURE_3D, 0, GL_RGB32F, size, size, size, 0, GL_RGB, GL_FLOAT, data.data());
+    glBindTexture(GL_TEXTURE_3D, 0);
+    return !GLutil::checkError("3D LUT upload");
+}
+
+std::string LUT3D::shaderCode() const {
+    // map the domain to [0,1], then to the texel centers of the LUT
+    std::ostringstream code;
+    double scale = double(size - 1) / double(size);
+    double offset = 0.5 / double(size);
+    code.precision(9);
+    code << "// @gips_version=1\n"
+            "uniform float strength = 1.0;  // @min=0 @max=1 @identity=0 Strength\n"
+            "vec3 run(vec3 color) {\n"
+            "    vec3 t = clamp((color - vec3(" << domainMin[0] << ", " << domainMin[1] << ", " << domainMin[2] << "))"
+                          " / vec3(" << (domainMax[0] - domainMin[0]) << ", " << (domainMax[1] - domainMin[1]) << ", " << (domainMax[2] - domainMin[2]) << "),"
+                          " 0.0, 1.0);\n"
+            "    vec3 c = texture(gips_lut, t * vec3(" << scale << ") + vec3(" << offset << ")).rgb;\n"
+            "    return mix(color, c, strength);\n"
+            "}\n";
+    return code.str();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void Node::freeLUT() {
+    if (m_lutTex && GLutil::initialized) {
+        glDeleteTextures(1, &m_lutTex);
+    }
+    m_lutTex = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool Pipeline::bakeLUT(LUT3D& lut, int size, int firstNode, int nodeCount) {
+    if ((size < 2) || (size > MaxLUTSize) || (firstNode < 0) || (nodeCount < 1)
+    || ((firstNode + nodeCount) > this->nodeCount())) { return false; }
+    lut.title.clear();
+    for (int i = firstNode;  i < (firstNode + nodeCount);  ++i) {
+        const Node& node = *m_nodes[size_t(i)];
+        if (!node.good() || !node.pointwise()) { return false; }
+        if (!node.enabled()) { continue; }
+        if (!lut.title.empty()) { lut.title += " + "; }
+        lut.title += node.name();
+    }
+
+    // generate the identity lattice; the blue slices are arranged
+    // horizontally, i.e. x = r + b * size, y = g
+    int width = size * size, height = size;
+    std::vector<float> lattice(size_t(width) * size_t(height) * 4u);
+    float scale = 1.0f / float(size - 1);
+    for (int b = 0;  b < size;  ++b) {
+        for (int g = 0;  g < size;  ++g) {
+            float* p = &lattice[(size_t(g) * size_t(width) + size_t(b) * size_t(size)) * 4u];
+            for (int r = 0;  r < size;  ++r) {
+                *p++ = float(r) * scale;
+                *p++ = float(g) * scale;
+                *p++ = float(b) * scale;
+                *p++ = 1.0f;
+            }
+        }
+    }
+    GLutil::clearError();
+    GLuint srcTex = 0;
+    glGenTextures(1, &srcTex);
+    glBindTexture(GL_TEXTURE_2D, srcTex);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, width, height, 0, GL_RGBA, GL_FLOAT, lattice.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+    if (GLutil::checkError("LUT lattice upload")) {
+        glDeleteTextures(1, &srcTex);
+        return false;
+    }
+
+    // run the lattice through the nodes (with their current parameter
+    // values) and read back the result
+    latchParameters();
+    render(srcTex, width, height, PixelFormat::Float32, firstNode + nodeCount, firstNode);
+    glBindTexture(GL_TEXTURE_2D, m_resultTex);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_FLOAT, lattice.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glDeleteTextures(1, &srcTex);
+    m_pipelineChanged = true;  // intermediate buffers don't contain the image any longer
+    if (GLutil::checkError("LUT readback")) { return false; }
+
+    // convert into .cube order (red fastest, then green, then blue)
+    lut.size = size;
+    for (int i = 0;  i < 3;  ++i) { lut.domainMin[i] = 0.0f; lut.domainMax[i] = 1.0f; }
+    lut.data.resize(size_t(size) * size_t(size) * size_t(size) * 3u);
+    float* dest = lut.data.data();
+    for (int b = 0;  b < size;  ++b) {
+        for (int g = 0;  g < size;  ++g) {
+            const float* p = &lattice[(size_t(g) * size_t(width) + size_t(b) * size_t(size)) * 4u];
+            for (int r = 0;  r < size;  ++r) {
+                *dest++ = *p++;
+                *dest++ = *p++;
+                *dest++ = *p++;
+                ++p;
+            }
+        }
+    }
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+}  // namespace GIPS
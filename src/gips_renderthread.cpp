@@ -0,0 +1,192 @@
+// SPDX-FileCopyrightText: 2021 Martin J. Fiedler <keyj@emphy.de>
+// SPDX-License-Identifier: MIT
+
+#include <cstdio>
+
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+#include "gl_header.h"
+#include "gl_util.h"
+
+#include "gips_renderthread.h"
+
+namespace GIPS {
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool RenderThread::start(GLFWwindow* mainWindow, Pipeline& pipeline) {
+    if (running()) { return true; }
+    // the render context is owned by an invisible 1x1 window; all other
+    // window hints are still the ones used for the main window
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    m_window = glfwCreateWindow(1, 1, "GIPS render thread", nullptr, mainWindow);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+    if (!m_window) {
+        const char* err = "unknown error";
+        glfwGetError(&err);
+        fprintf(stderr, "failed to create the render context: %s\n", err);
+        return false;
+    }
+    m_pipeline = &pipeline;
+    m_quit = false;
+    m_thread = std::thread([this] { run(); });
+    return true;
+}
+
+void RenderThread::stop() {
+    if (running()) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_quit = true;
+        }
+        m_cond.notify_all();
+        m_thread.join();
+    }
+    if (m_hasJob && m_job.fence) { glDeleteSync(m_job.fence); }
+    if (m_resultFence) { glDeleteSync(m_resultFence); }
+    m_hasJob = m_hasResult = false;
+    m_job.fence = m_resultFence = nullptr;
+    if (m_window) {
+        glfwDestroyWindow(m_window);
+        m_window = nullptr;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool RenderThread::busy() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_hasJob || m_rendering || m_hasResult;
+}
+
+bool RenderThread::rendering(float& progress, float& elapsed_ms) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_rendering) { return false; }
+    progress = m_pipeline->progress();
+    elapsed_ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - m_renderStart).count();
+    return true;
+}
+
+void RenderThread::cancel() {
+    // the cancellation flag is only ever set while rendering, and reset
+    // by the render thread afterwards, so no other render is affected
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_rendering) { m_pipeline->cancel(); }
+}
+
+void RenderThread::request(GLuint srcTex, int width, int height, PixelFormat format, int showIndex, unsigned generation) {
+    // the render thread must see everything the UI thread did to the
+    // source image and the pipeline so far
+    GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_hasJob && m_job.fence) { glDeleteSync(m_job.fence); }
+        m_job.srcTex = srcTex;
+        m_job.width = width;
+        m_job.height = height;
+        m_job.format = format;
+        m_job.showIndex = showIndex;
+        m_job.generation = generation;
+        m_job.fence = fence;
+        m_hasJob = true;
+    }
+    m_cond.notify_all();
+}
+
+bool RenderThread::poll(unsigned& generation) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_hasResult) { return false; }
+    if (m_resultFence) {
+        // the render thread has flushed its commands, so there's no need
+        // to do that here; just check whether they have been executed
+        GLenum status = glClientWaitSync(m_resultFence, 0, 0);
+        if ((status != GL_ALREADY_SIGNALED) && (status != GL_CONDITION_SATISFIED)) { return false; }
+        glDeleteSync(m_resultFence);
+        m_resultFence = nullptr;
+    }
+    generation = m_resultGeneration;
+    return true;
+}
+
+void RenderThread::release() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_resultFence) { glDeleteSync(m_resultFence); }
+        m_resultFence = nullptr;
+        m_hasResult = false;
+    }
+    m_cond.notify_all();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void RenderThread::run() {
+    glfwMakeContextCurrent(m_window);
+    // vertex array objects and FBOs aren't shared between contexts
+    GLuint vao = 0;
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+    GLutil::FBO fbo;
+    fbo.init();
+    #ifndef NDEBUG
+        fprintf(stderr, "render thread started\n");
+    #endif
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;) {
+        // wait for a job; the previous result must have been picked up
+        // first, as a new render would overwrite it
+        m_cond.wait(lock, [this] { return m_quit || (m_hasJob && !m_hasResult); });
+        if (m_quit) { break; }
+        Job job = m_job;
+        m_hasJob = false;
+        m_rendering = true;
+        m_renderStart = std::chrono::steady_clock::now();
+        m_pipeline->cancel(false);
+        lock.unlock();
+
+        m_pipelineMutex.lock();
+        if (job.fence) {
+            glWaitSync(job.fence, 0, GL_TIMEOUT_IGNORED);
+            glDeleteSync(job.fence);
+        }
+        m_pipeline->swapFramebuffer(fbo);
+        m_pipeline->setSliceBudget(SliceBudget_ms);
+        m_pipeline->render(job.srcTex, job.width, job.height, job.format, job.showIndex);
+        m_pipeline->setSliceBudget(0.0f);
+        m_pipeline->swapFramebuffer(fbo);
+        bool cancelled = m_pipeline->lastRenderCancelled();
+        GLsync fence = cancelled ? nullptr : glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        glFlush();
+        m_pipelineMutex.unlock();
+
+        // a cancelled render doesn't produce a result
+        lock.lock();
+        m_rendering = false;
+        m_pipeline->cancel(false);
+        if (!cancelled) {
+            m_hasResult = true;
+            m_resultGeneration = job.generation;
+            m_resultFence = fence;
+        }
+        #ifndef NDEBUG
+            if (cancelled) { fprintf(stderr, "render cancelled\n"); }
+        #endif
+        glfwPostEmptyEvent();  // wake up the UI thread
+    }
+
+    lock.unlock();
+    fbo.free();
+    glBindVertexArray(0);
+    glDeleteVertexArrays(1, &vao);
+    glFinish();
+    glfwMakeContextCurrent(nullptr);
+    #ifndef NDEBUG
+        fprintf(stderr, "render thread finished\n");
+    #endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+}  // namespace GIPS
@@ -0,0 +1,110 @@
+// SPDX-FileCopyrightText: 2021 Martin J. Fiedler <keyj@emphy.de>
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+#include "gl_header.h"
+#include "gl_util.h"
+
+#include "gips_core.h"
+
+struct GLFWwindow;
+
+namespace GIPS {
+
+//! executes the pipeline in a separate thread with its own GL context
+//! (sharing objects with the UI's context), so slow pipelines don't block
+//! the UI; the render thread renders one job at a time and keeps the
+//! result until the UI thread has picked it up or dropped it
+//! \note The pipeline must only be modified (nodes added or removed,
+//!       images uploaded, ...) while holding the lock. Parameter values
+//!       can be modified at any time, because rendering only uses the
+//!       values taken over with Pipeline::latchParameters().
+class RenderThread {
+    Pipeline* m_pipeline = nullptr;
+    GLFWwindow* m_window = nullptr;  //!< invisible window that owns the context
+    std::thread m_thread;
+    std::mutex m_pipelineMutex;      //!< protects the pipeline
+    std::mutex m_mutex;              //!< protects the job and result state
+    std::condition_variable m_cond;
+    bool m_quit = false;
+
+    // current job
+    struct Job {
+        GLuint srcTex = 0;
+        int width = 0;
+        int height = 0;
+        PixelFormat format = PixelFormat::DontCare;
+        int showIndex = 0;
+        unsigned generation = 0;
+        GLsync fence = nullptr;      //!< marks the UI thread's preceding GL commands
+    } m_job;
+    bool m_hasJob = false;
+    bool m_rendering = false;
+    std::chrono::steady_clock::time_point m_renderStart;
+
+    // completed result, waiting to be picked up
+    bool m_hasResult = false;
+    unsigned m_resultGeneration = 0;
+    GLsync m_resultFence = nullptr;
+
+    void run();
+
+public:
+    //! duration of a single band of a time-sliced render; this is roughly
+    //! the time that the UI may have to wait for the GPU
+    static constexpr float SliceBudget_ms = 8.0f;
+
+    //! create the render context and start the thread; must be called
+    //! from the main thread, with the UI context being current
+    //! \returns false if no shared context could be created; in this
+    //!          case, the caller needs to render by itself
+    bool start(GLFWwindow* mainWindow, Pipeline& pipeline);
+    inline bool running() const { return m_thread.joinable(); }
+    void stop();
+
+    //! lock the pipeline, waiting until a running render is finished
+    inline void lock()    { m_pipelineMutex.lock(); }
+    inline bool tryLock() { return m_pipelineMutex.try_lock(); }
+    inline void unlock()  { m_pipelineMutex.unlock(); }
+    class Lock {
+        RenderThread& m_rt;
+    public:
+        inline explicit Lock(RenderThread& rt) : m_rt(rt) { m_rt.lock(); }
+        inline ~Lock() { m_rt.unlock(); }
+        Lock(const Lock&) = delete;
+    };
+
+    //! check whether a job is queued or running, or a result is waiting
+    bool busy();
+
+    //! check whether a render is running, and for how long already
+    //! \param progress  receives the completed fraction of the render
+    bool rendering(float& progress, float& elapsed_ms);
+
+    //! stop the running render as soon as possible; its result is dropped,
+    //! and the render thread becomes idle again
+    void cancel();
+
+    //! queue rendering of the pipeline with the latched parameters
+    //! \param generation  arbitrary number to identify the result with
+    void request(GLuint srcTex, int width, int height, PixelFormat format, int showIndex, unsigned generation);
+
+    //! check for a completed result; if there is one, the pipeline's
+    //! result texture can be used until release() is called (the lock
+    //! needs to be acquired for that, but it will be available)
+    bool poll(unsigned& generation);
+    void release();
+
+    inline RenderThread() {}
+    RenderThread(const RenderThread&) = delete;
+    inline ~RenderThread() { stop(); }
+};
+
+
+}  // namespace GIPS
@@ -0,0 +1,367 @@
+// SPDX-FileCopyrightText: 2021 Martin J. Fiedler <keyj@emphy.de>
+// SPDX-License-Identifier: MIT
+
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+
+#include <algorithm>
+#include <vector>
+
+#include "gl_header.h"
+#include "gl_util.h"
+
+#include "gips_resample.h"
+
+namespace GIPS {
+
+///////////////////////////////////////////////////////////////////////////////
+
+//! upper limit for the size of the source tiles; keeps the temporary
+//! textures reasonably small even for floating-point images
+constexpr int MaxTileSize = 2048;
+
+//! number of source rows to keep in memory while streaming
+constexpr int StreamStripeRows = 256;
+
+const char* resampleFilterName(ResampleFilter filter) {
+    switch (filter) {
+        case ResampleFilter::Lanczos3: return "Lanczos-3";
+        default:                       return "Mitchell-Netravali";
+    }
+}
+
+static float filterRadius(ResampleFilter filter) {
+    return (filter == ResampleFilter::Lanczos3) ? 3.0f : 2.0f;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool Resampler::init(const GLutil::Shader& vs, int maxTextureSize) {
+    // one pass along a single axis; the output is normalized by the sum of
+    // the weights, so taps outside the image are simply dropped
+    GLutil::Shader fs(GL_FRAGMENT_SHADER,
+         "#version 330 core"
+    "\n" "uniform sampler2D gips_tex;"
+    "\n" "uniform ivec2 rs_axis;        // (1,0) = horizontal, (0,1) = vertical"
+    "\n" "uniform ivec2 rs_fragOffset;  // framebuffer position of the output region"
+    "\n" "uniform float rs_outOrigin;   // global output coordinate of the region"
+    "\n" "uniform float rs_srcOrigin;   // global source coordinate of texel 0"
+    "\n" "uniform int   rs_srcSize;     // number of source texels along the axis"
+    "\n" "uniform float rs_ratio;       // source pixels per output pixel"
+    "\n" "uniform float rs_kscale;      // kernel scale (< 1 when downscaling)"
+    "\n" "uniform float rs_support;     // kernel radius in source pixels"
+    "\n" "uniform int   rs_filter;"
+    "\n" "out vec4 gips_frag;"
+    "\n" "float kernel(float x) {"
+    "\n" "  x = abs(x);"
+    "\n" "  if (rs_filter == 1) {"
+    "\n" "    if (x < 1e-5) { return 1.0; }"
+    "\n" "    if (x >= 3.0) { return 0.0; }"
+    "\n" "    float px = 3.14159265 * x;"
+    "\n" "    return 3.0 * sin(px) * sin(px / 3.0) / (px * px);"
+    "\n" "  }"
+    "\n" "  if (x < 1.0) { return ((7.0 * x - 12.0) * x * x + 16.0 / 3.0) / 6.0; }"
+    "\n" "  if (x < 2.0) { return (((-7.0 / 3.0 * x + 12.0) * x - 20.0) * x + 32.0 / 3.0) / 6.0; }"
+    "\n" "  return 0.0;"
+    "\n" "}"
+    "\n" "void main() {"
+    "\n" "  ivec2 local = ivec2(gl_FragCoord.xy) - rs_fragOffset;"
+    "\n" "  float center = (float(local.x * rs_axis.x + local.y * rs_axis.y) + rs_outOrigin + 0.5) * rs_ratio - rs_srcOrigin;"
+    "\n" "  int i0 = max(int(floor(center - rs_support)), 0);"
+    "\n" "  int i1 = min(int(ceil(center + rs_support)), rs_srcSize - 1);"
+    "\n" "  ivec2 base = local * (ivec2(1) - rs_axis);"
+    "\n" "  vec4 sum = vec4(0.0);"
+    "\n" "  float wsum = 0.0;"
+    "\n" "  for (int i = i0;  i <= i1;  ++i) {"
+    "\n" "    float w = kernel((float(i) + 0.5 - center) * rs_kscale);"
+    "\n" "    sum += w * texelFetch(gips_tex, base + rs_axis * i, 0);"
+    "\n" "    wsum += w;"
+    "\n" "  }"
+    "\n" "  gips_frag = (abs(wsum) > 1e-6) ? (sum / wsum) : vec4(0.0);"
+    "\n" "}"
+    "\n");
+    if (!fs.good()) {
+        fprintf(stderr, "failed to compile the resampling fragment shader:\n%s\n", fs.getLog());
+        return false;
+    }
+    if (!m_prog.link(vs, fs)) {
+        fprintf(stderr, "failed to link the resampling shader program:\n%s\n", m_prog.getLog());
+        return false;
+    }
+    fs.free();
+    m_locPos2ndc     = m_prog.getUniformLocation("gips_pos2ndc");
+    m_locAxis        = m_prog.getUniformLocation("rs_axis");
+    m_locFragOffset  = m_prog.getUniformLocation("rs_fragOffset");
+    m_locOutOrigin   = m_prog.getUniformLocation("rs_outOrigin");
+    m_locSrcOrigin   = m_prog.getUniformLocation("rs_srcOrigin");
+    m_locSrcSize     = m_prog.getUniformLocation("rs_srcSize");
+    m_locRatio       = m_prog.getUniformLocation("rs_ratio");
+    m_locKernelScale = m_prog.getUniformLocation("rs_kscale");
+    m_locSupport     = m_prog.getUniformLocation("rs_support");
+    m_locFilter      = m_prog.getUniformLocation("rs_filter");
+
+    m_fbo.init();
+    GLuint tex[2];
+    glGenTextures(2, tex);
+    m_srcTex = tex[0];
+    m_tmpTex = tex[1];
+    for (int i = 0;  i < 2;  ++i) {
+        glBindTexture(GL_TEXTURE_2D, tex[i]);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    m_maxTileSize = std::min(maxTextureSize, MaxTileSize);
+    return !GLutil::checkError("resampler initialization");
+}
+
+void Resampler::free() {
+    if (GLutil::initialized) {
+        if (m_srcTex) { glDeleteTextures(1, &m_srcTex); }
+        if (m_tmpTex) { glDeleteTextures(1, &m_tmpTex); }
+    }
+    m_srcTex = m_tmpTex = 0;
+    m_fbo.free();
+    m_prog.free();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool Resampler::begin(int srcWidth, int srcHeight, int dstWidth, int dstHeight, ResampleFilter filter) {
+    if (!good() || (srcWidth < 1) || (srcHeight < 1) || (dstWidth < 1) || (dstHeight < 1)) { return false; }
+    const int srcSize[2] = { srcWidth, srcHeight };
+    const int dstSize[2] = { dstWidth, dstHeight };
+    for (int axis = 0;  axis < 2;  ++axis) {
+        m_ratio[axis] = float(srcSize[axis]) / float(dstSize[axis]);
+        m_support[axis] = filterRadius(filter) * std::max(m_ratio[axis], 1.0f);
+    }
+    m_prog.use();
+    glUniform4f(m_locPos2ndc, -1.0f, -1.0f, 2.0f, 2.0f);
+    glUniform1i(m_locFilter, static_cast<int>(filter));
+    glActiveTexture(GL_TEXTURE0);
+    return true;
+}
+
+int Resampler::outputTileSize(int axis) const {
+    // leave room for the kernel support on both sides, plus rounding
+    return int(std::floor((float(m_maxTileSize) - 2.0f * m_support[axis] - 4.0f) / m_ratio[axis]));
+}
+
+void Resampler::sourceRange(int axis, int outStart, int outEnd, int srcSize, int& srcStart, int& srcEnd) const {
+    srcStart = std::max(int(std::floor(float(outStart) * m_ratio[axis] - m_support[axis])) - 1, 0);
+    srcEnd   = std::min(int(std::ceil (float(outEnd)   * m_ratio[axis] + m_support[axis])) + 1, srcSize);
+}
+
+bool Resampler::renderRegion(GLuint srcTex, int sx0, int sy0, int sw, int sh,
+                             GLuint dstTex, int ox, int oy, int ow, int oh) {
+    // horizontal pass: source region -> (ow x sh) temporary texture
+    if (!m_fbo.begin(m_tmpTex)) { return false; }
+    glViewport(0, 0, ow, sh);
+    glBindTexture(GL_TEXTURE_2D, srcTex);
+    glUniform2i(m_locAxis, 1, 0);
+    glUniform2i(m_locFragOffset, 0, 0);
+    glUniform1f(m_locOutOrigin, float(ox));
+    glUniform1f(m_locSrcOrigin, float(sx0));
+    glUniform1i(m_locSrcSize, sw);
+    glUniform1f(m_locRatio, m_ratio[0]);
+    glUniform1f(m_locKernelScale, 1.0f / std::max(m_ratio[0], 1.0f));
+    glUniform1f(m_locSupport, m_support[0]);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+    // vertical pass: temporary texture -> output region
+    if (!m_fbo.begin(dstTex)) { return false; }
+    glViewport(ox, oy, ow, oh);
+    glBindTexture(GL_TEXTURE_2D, m_tmpTex);
+    glUniform2i(m_locAxis, 0, 1);
+    glUniform2i(m_locFragOffset, ox, oy);
+    glUniform1f(m_locOutOrigin, float(oy));
+    glUniform1f(m_locSrcOrigin, float(sy0));
+    glUniform1i(m_locSrcSize, sh);
+    glUniform1f(m_locRatio, m_ratio[1]);
+    glUniform1f(m_locKernelScale, 1.0f / std::max(m_ratio[1], 1.0f));
+    glUniform1f(m_locSupport, m_support[1]);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    m_fbo.end();
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool Resampler::beginTiles(int width, int height, PixelFormat format, int dstWidth, int dstHeight,
+                           int maxSourceRows, int& tileWidth, int& tileHeight) {
+    GLint srcFormat;
+    switch (format) {
+        case PixelFormat::Int8:    srcFormat = GL_RGBA8;   m_srcType = GL_UNSIGNED_BYTE;  break;
+        case PixelFormat::Int16:   srcFormat = GL_RGBA16;  m_srcType = GL_UNSIGNED_SHORT; break;
+        case PixelFormat::Float32: srcFormat = GL_RGBA32F; m_srcType = GL_FLOAT;          break;
+        default: return false;
+    }
+    tileWidth  = std::min(outputTileSize(0), dstWidth);
+    tileHeight = std::min(outputTileSize(1), dstHeight);
+    if (maxSourceRows > 0) {
+        int rows = int(std::floor((float(maxSourceRows) - 2.0f * m_support[1] - 4.0f) / m_ratio[1]));
+        tileHeight = std::min(tileHeight, std::max(rows, 1));
+    }
+    if ((tileWidth < 1) || (tileHeight < 1)) {
+        #ifndef NDEBUG
+            fprintf(stderr, "resampling ratio %.1fx%.1f is too large for tiling\n", m_ratio[0], m_ratio[1]);
+        #endif
+        return false;
+    }
+
+    // allocate the source and temporary textures once, for the largest tile
+    GLutil::clearError();
+    int maxSrcWidth = 0, maxSrcHeight = 0;
+    for (int ox = 0;  ox < dstWidth;  ox += tileWidth) {
+        int s0, s1;
+        sourceRange(0, ox, std::min(ox + tileWidth, dstWidth), width, s0, s1);
+        maxSrcWidth = std::max(maxSrcWidth, s1 - s0);
+    }
+    for (int oy = 0;  oy < dstHeight;  oy += tileHeight) {
+        int s0, s1;
+        sourceRange(1, oy, std::min(oy + tileHeight, dstHeight), height, s0, s1);
+        maxSrcHeight = std::max(maxSrcHeight, s1 - s0);
+    }
+    glBindTexture(GL_TEXTURE_2D, m_srcTex);
+    glTexImage2D(GL_TEXTURE_2D, 0, srcFormat, maxSrcWidth, maxSrcHeight, 0, GL_RGBA, m_srcType, nullptr);
+    glBindTexture(GL_TEXTURE_2D, m_tmpTex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, tileWidth, maxSrcHeight, 0, GL_RGBA, GL_FLOAT, nullptr);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, width);
+    return !GLutil::checkError("resampler texture allocation");
+}
+
+bool Resampler::processRowBlock(const void* rows, int firstRow, int width, int height,
+                                GLuint dstTex, int dstWidth, int oy, int oh, int tileWidth) {
+    // upload sub-rectangles of the source rows straight from the caller's
+    // buffer and process them one after another
+    int sy0, sy1;
+    sourceRange(1, oy, oy + oh, height, sy0, sy1);
+    if (sy0 < firstRow) { return false; }
+    for (int ox = 0;  ox < dstWidth;  ox += tileWidth) {
+        int ow = std::min(tileWidth, dstWidth - ox);
+        int sx0, sx1;
+        sourceRange(0, ox, ox + ow, width, sx0, sx1);
+        glPixelStorei(GL_UNPACK_SKIP_PIXELS, sx0);
+        glPixelStorei(GL_UNPACK_SKIP_ROWS, sy0 - firstRow);
+        glBindTexture(GL_TEXTURE_2D, m_srcTex);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, sx1 - sx0, sy1 - sy0, GL_RGBA, m_srcType, rows);
+        if (!renderRegion(m_srcTex, sx0, sy0, sx1 - sx0, sy1 - sy0, dstTex, ox, oy, ow, oh)
+        ||  GLutil::checkError("resampling tile")) { return false; }
+    }
+    return true;
+}
+
+void Resampler::endTiles() {
+    glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+    glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    // release the tile memory again
+    glBindTexture(GL_TEXTURE_2D, m_srcTex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindTexture(GL_TEXTURE_2D, m_tmpTex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glUseProgram(0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool Resampler::resampleImage(const void* data, int width, int height, PixelFormat format,
+                              GLuint dstTex, int dstWidth, int dstHeight, ResampleFilter filter) {
+    if (!data || !begin(width, height, dstWidth, dstHeight, filter)) { return false; }
+    int tileWidth, tileHeight;
+    bool ok = beginTiles(width, height, format, dstWidth, dstHeight, 0, tileWidth, tileHeight);
+    #ifndef NDEBUG
+        if (ok) {
+            fprintf(stderr, "resampling %dx%d -> %dx%d on the GPU, %dx%d tiles, %s filter\n",
+                    width, height, dstWidth, dstHeight, tileWidth, tileHeight, resampleFilterName(filter));
+        }
+    #endif
+    for (int oy = 0;  ok && (oy < dstHeight);  oy += tileHeight) {
+        ok = processRowBlock(data, 0, width, height, dstTex, dstWidth, oy, std::min(tileHeight, dstHeight - oy), tileWidth);
+    }
+    endTiles();
+    return ok;
+}
+
+bool Resampler::resampleRows(ImageUtil::RowReader& reader, GLuint dstTex, int dstWidth, int dstHeight, ResampleFilter filter) {
+    const int width = reader.width(), height = reader.height();
+    if (!begin(width, height, dstWidth, dstHeight, filter)) { return false; }
+    PixelFormat format = (reader.bytesPerSample() == 4) ? PixelFormat::Float32
+                       : (reader.bytesPerSample() == 2) ? PixelFormat::Int16
+                       :                                  PixelFormat::Int8;
+    // keep the stripes short, but make sure that one output row always fits
+    int maxRows = std::max(StreamStripeRows, int(std::ceil(2.0f * m_support[1] + m_ratio[1])) + 6);
+    int tileWidth, tileHeight;
+    bool ok = beginTiles(width, height, format, dstWidth, dstHeight, maxRows, tileWidth, tileHeight);
+    int bufferRows = 0;
+    for (int oy = 0;  ok && (oy < dstHeight);  oy += tileHeight) {
+        int s0, s1;
+        sourceRange(1, oy, std::min(oy + tileHeight, dstHeight), height, s0, s1);
+        bufferRows = std::max(bufferRows, s1 - s0);
+    }
+    #ifndef NDEBUG
+        if (ok) {
+            fprintf(stderr, "streaming %dx%d -> %dx%d on the GPU, %d-row stripes, %s filter\n",
+                    width, height, dstWidth, dstHeight, bufferRows, resampleFilterName(filter));
+        }
+    #endif
+
+    // the stripe buffer holds the source rows [bufStart, bufEnd); rows that
+    // are still needed by the next stripe are moved to the front
+    const size_t rowSize = reader.rowSize();
+    std::vector<uint8_t> buffer;
+    if (ok) { buffer.resize(size_t(bufferRows) * rowSize); }
+    int bufStart = 0, bufEnd = 0;
+    for (int oy = 0;  ok && (oy < dstHeight);  oy += tileHeight) {
+        int oh = std::min(tileHeight, dstHeight - oy);
+        int sy0, sy1;
+        sourceRange(1, oy, oy + oh, height, sy0, sy1);
+        if (sy0 >= bufEnd) {
+            // skip rows that aren't needed at all (only happens with
+            // extreme downscaling ratios)
+            while (ok && (bufEnd < sy0)) {
+                ok = reader.readRows(buffer.data(), 1);
+                ++bufEnd;
+            }
+            bufStart = bufEnd;
+        } else if (sy0 > bufStart) {
+            memmove(buffer.data(), &buffer[size_t(sy0 - bufStart) * rowSize], size_t(bufEnd - sy0) * rowSize);
+            bufStart = sy0;
+        }
+        if (ok && (sy1 > bufEnd)) {
+            ok = reader.readRows(&buffer[size_t(bufEnd - bufStart) * rowSize], sy1 - bufEnd);
+            bufEnd = sy1;
+        }
+        ok = ok && processRowBlock(buffer.data(), bufStart, width, height, dstTex, dstWidth, oy, oh, tileWidth);
+    }
+    endTiles();
+    return ok;
+}
+
+bool Resampler::resampleTexture(GLuint srcTex, int srcWidth, int srcHeight,
+                                GLuint dstTex, int dstWidth, int dstHeight, ResampleFilter filter) {
+    if (!begin(srcWidth, srcHeight, dstWidth, dstHeight, filter)) { return false; }
+    // the source already is a texture, so there's no need for tiling
+    GLutil::clearError();
+    glBindTexture(GL_TEXTURE_2D, m_tmpTex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, dstWidth, srcHeight, 0, GL_RGBA, GL_FLOAT, nullptr);
+    bool ok = !GLutil::checkError("resampler texture allocation")
+           && renderRegion(srcTex, 0, 0, srcWidth, srcHeight, dstTex, 0, 0, dstWidth, dstHeight)
+           && !GLutil::checkError("resampling");
+    glBindTexture(GL_TEXTURE_2D, m_tmpTex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glUseProgram(0);
+    return ok;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+}  // namespace GIPS
@@ -0,0 +1,87 @@
+// SPDX-FileCopyrightText: 2021 Martin J. Fiedler <keyj@emphy.de>
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include "gl_header.h"
+#include "gl_util.h"
+
+#include "image_util.h"
+
+#include "gips_core.h"
+
+namespace GIPS {
+
+enum class ResampleFilter {
+    Mitchell,   //!< Mitchell-Netravali cubic (B = C = 1/3), radius 2
+    Lanczos3,   //!< windowed sinc, radius 3; sharper, but may ring
+};
+const char* resampleFilterName(ResampleFilter filter);
+
+
+//! high-quality separable image resampler running on the GPU
+class Resampler {
+    GLutil::Program m_prog;
+    GLutil::FBO m_fbo;
+    GLuint m_srcTex = 0;
+    GLuint m_tmpTex = 0;
+    GLint m_locPos2ndc = -1;
+    GLint m_locAxis = -1;
+    GLint m_locFragOffset = -1;
+    GLint m_locOutOrigin = -1;
+    GLint m_locSrcOrigin = -1;
+    GLint m_locSrcSize = -1;
+    GLint m_locRatio = -1;
+    GLint m_locKernelScale = -1;
+    GLint m_locSupport = -1;
+    GLint m_locFilter = -1;
+    int m_maxTileSize = 0;
+    GLenum m_srcType = GL_UNSIGNED_BYTE;
+
+    // geometry of the current operation
+    float m_ratio[2] = { 1.0f, 1.0f };    //!< source pixels per output pixel
+    float m_support[2] = { 2.0f, 2.0f };  //!< kernel radius in source pixels
+    bool begin(int srcWidth, int srcHeight, int dstWidth, int dstHeight, ResampleFilter filter);
+    int outputTileSize(int axis) const;
+    void sourceRange(int axis, int outStart, int outEnd, int srcSize, int& srcStart, int& srcEnd) const;
+    bool renderRegion(GLuint srcTex, int sx0, int sy0, int sw, int sh,
+                      GLuint dstTex, int ox, int oy, int ow, int oh);
+    bool beginTiles(int width, int height, PixelFormat format, int dstWidth, int dstHeight,
+                    int maxSourceRows, int& tileWidth, int& tileHeight);
+    bool processRowBlock(const void* rows, int firstRow, int width, int height,
+                         GLuint dstTex, int dstWidth, int oy, int oh, int tileWidth);
+    void endTiles();
+
+public:
+    bool init(const GLutil::Shader& vs, int maxTextureSize);
+    inline bool good() const { return m_prog.good(); }
+
+    //! resample an RGBA image from system memory into an already allocated
+    //! texture; the source is uploaded in tiles, so it may be larger than
+    //! the maximum texture size
+    //! \param format  sample type of the source data: Int8 (uint8_t),
+    //!                Int16 (uint16_t) or Float32 (float)
+    bool resampleImage(const void* data, int width, int height, PixelFormat format,
+                       GLuint dstTex, int dstWidth, int dstHeight,
+                       ResampleFilter filter=ResampleFilter::Mitchell);
+
+    //! resample an image that is decoded row by row into an already
+    //! allocated texture; only a few stripes of the source are kept
+    //! in memory at any time
+    bool resampleRows(ImageUtil::RowReader& reader,
+                      GLuint dstTex, int dstWidth, int dstHeight,
+                      ResampleFilter filter=ResampleFilter::Mitchell);
+
+    //! resample a texture into another, already allocated texture
+    bool resampleTexture(GLuint srcTex, int srcWidth, int srcHeight,
+                         GLuint dstTex, int dstWidth, int dstHeight,
+                         ResampleFilter filter=ResampleFilter::Mitchell);
+
+    void free();
+    inline Resampler() {}
+    Resampler(const Resampler&) = delete;
+    inline ~Resampler() { free(); }
+};
+
+
+}  // namespace GIPS
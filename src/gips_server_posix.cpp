@@ -0,0 +1,599 @@
+// SPDX-FileCopyrightText: 2021 Martin J. Fiedler <keyj@emphy.de>
+// SPDX-License-Identifier: MIT
+
+// processing daemon ("gips --serve <socket>"); see README.md for the protocol
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <chrono>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "gl_header.h"
+#include "gl_util.h"
+#include "string_util.h"
+#include "file_util.h"
+#include "vfs.h"
+
+#include "gips_app.h"
+
+namespace GIPS {
+
+constexpr int MaxClients = 64;
+constexpr size_t MaxRequestLength = 65536;
+constexpr int MaxFDsPerMessage = 8;
+constexpr size_t MaxPendingFDs = 2 * MaxFDsPerMessage;
+constexpr int MaxQueuedJobsPerClient = 16;
+constexpr size_t MaxPendingOutput = 1 << 20;
+constexpr size_t MaxCachedPipelines = 32;
+constexpr long MaxImageSize = 1L << 20;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+inline float ms(Clock::time_point from, Clock::time_point to)
+    { return std::chrono::duration<float, std::milli>(to - from).count(); }
+
+volatile sig_atomic_t quitRequested = 0;
+void handleQuitSignal(int) { quitRequested = 1; }
+
+bool parseBufferType(const char* name, PixelFormat& fmt) {
+    if      (!strcmp(name, "int8"))    { fmt = PixelFormat::Int8; }
+    else if (!strcmp(name, "int16"))   { fmt = PixelFormat::Int16; }
+    else if (!strcmp(name, "float32")) { fmt = PixelFormat::Float32; }
+    else { return false; }
+    return true;
+}
+
+//! parse an image dimension; rejects trailing junk and absurd sizes
+bool parseDimension(const char* str, int& value) {
+    char* end = nullptr;
+    errno = 0;
+    long v = strtol(str, &end, 10);
+    if ((end == str) || *end || errno || (v < 1) || (v > MaxImageSize)) { return false; }
+    value = int(v);
+    return true;
+}
+
+//! parse a byte offset; rejects signs, trailing junk and overflow
+bool parseOffset(const char* str, uint64_t& value) {
+    if ((*str < '0') || (*str > '9')) { return false; }
+    char* end = nullptr;
+    errno = 0;
+    unsigned long long v = strtoull(str, &end, 10);
+    if (*end || errno) { return false; }
+    value = uint64_t(v);
+    return true;
+}
+
+bool parseFormat(const char* name, PixelFormat& fmt) {
+    if      (!strcmp(name, "default")) { fmt = PixelFormat::DontCare; }
+    else if (!strcmp(name, "srgb8"))   { fmt = PixelFormat::SRGB8; }
+    else if (!strcmp(name, "float16")) { fmt = PixelFormat::Float16; }
+    else { return parseBufferType(name, fmt); }
+    return true;
+}
+
+//! read-write or read-only mapping of (a part of) a shared memory object
+class SharedBuffer {
+    void* m_map = nullptr;
+    size_t m_mapSize = 0;
+public:
+    uint8_t* data = nullptr;
+    bool map(int fd, uint64_t offset, uint64_t size, bool writable) {
+        struct stat st;
+        if ((fd < 0) || fstat(fd, &st) || (st.st_size < 0)) { return false; }
+        uint64_t fileSize = uint64_t(st.st_size);
+        if ((size > fileSize) || (offset > (fileSize - size))
+        ||  ((offset + size) > uint64_t(SIZE_MAX))) { return false; }
+        m_mapSize = size_t(offset + size);
+        m_map = mmap(nullptr, m_mapSize, writable ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, fd, 0);
+        if (m_map == MAP_FAILED) { m_map = nullptr;  return false; }
+        data = static_cast<uint8_t*>(m_map) + offset;
+        return true;
+    }
+    inline SharedBuffer() {}
+    SharedBuffer(const SharedBuffer&) = delete;
+    inline ~SharedBuffer() { if (m_map) { munmap(m_map, m_mapSize); } }
+};
+
+//! a pipeline that stays loaded between jobs, along with the parameter
+//! values and node states from its file, which every job starts with
+struct CachedPipeline {
+    Pipeline pipeline;
+    FileUtil::FileFingerprint fp;
+    int showIndex = 0;
+    std::vector<float> values;  //!< 4 per parameter, in node order
+    std::vector<bool> enabled;
+    unsigned lastUsed = 0;
+
+    void snapshot() {
+        values.clear();
+        enabled.clear();
+        for (int i = 0;  i < pipeline.nodeCount();  ++i) {
+            const Node& node = pipeline.node(i);
+            enabled.push_back(node.enabled());
+            for (int j = 0;  j < node.paramCount();  ++j) {
+                values.insert(values.end(), node.param(j).value(), node.param(j).value() + 4);
+            }
+        }
+    }
+
+    void restore() {
+        size_t pos = 0;
+        for (int i = 0;  (i < pipeline.nodeCount()) && (size_t(i) < enabled.size());  ++i) {
+            Node& node = pipeline.node(i);
+            node.setEnabled(enabled[size_t(i)]);
+            for (int j = 0;  (j < node.paramCount()) && ((pos + 4u) <= values.size());  ++j, pos += 4u) {
+                memcpy(node.param(j).value(), &values[pos], 4 * sizeof(float));
+            }
+        }
+    }
+};
+
+class Server {
+    int m_listenFD = -1;
+    std::string m_path;
+
+    struct Client {
+        std::string input;      //!< request lines not yet queued
+        std::string output;     //!< replies not yet sent
+        std::deque<int> fds;    //!< received file descriptors not yet used by a job
+        int queued = 0;         //!< number of jobs in the queue
+    };
+    std::map<int, Client> m_clients;  //!< by socket
+
+    struct Job {
+        int client = -1;        //!< socket of the client, or -1 if it disconnected
+        std::string request;
+        int fds[2] = { -1, -1 };
+        Clock::time_point received;
+    };
+    std::deque<Job> m_queue;
+
+    std::map<std::string, CachedPipeline*> m_pipelines;  //!< by filename
+    unsigned m_jobCount = 0;
+
+    void acceptClient();
+    bool receive(int sock);
+    bool queueRequests(int sock, Client& client);
+    bool flush(int sock, Client& client);
+    void dropClient(int sock);
+    void processJob();
+    std::string handleRequest(Job& job);
+    std::string handleRun(Job& job, std::vector<char*>& args);
+    CachedPipeline* getPipeline(const char* filename, float& load_ms, std::string& error);
+
+public:
+    bool open(const char* path);
+    int run();
+    void close();
+    inline Server() {}
+    Server(const Server&) = delete;
+    inline ~Server() { close(); }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool Server::open(const char* path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "socket path too long: %s\n", path);
+        return false;
+    }
+    strcpy(addr.sun_path, path);
+
+    // remove a stale socket of a previous instance (but nothing else)
+    struct stat st;
+    if (!stat(path, &st) && S_ISSOCK(st.st_mode)) { unlink(path); }
+
+    m_listenFD = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (m_listenFD < 0) {
+        perror("socket");
+        return false;
+    }
+    fcntl(m_listenFD, F_SETFD, FD_CLOEXEC);
+    if (bind(m_listenFD, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr))
+    ||  listen(m_listenFD, MaxClients)) {
+        fprintf(stderr, "can't listen on %s: %s\n", path, strerror(errno));
+        ::close(m_listenFD);
+        m_listenFD = -1;
+        return false;
+    }
+    m_path = path;
+    return true;
+}
+
+void Server::close() {
+    while (!m_clients.empty()) { dropClient(m_clients.begin()->first); }
+    for (auto& job : m_queue) {
+        for (int fd : job.fds) { if (fd >= 0) { ::close(fd); } }
+    }
+    m_queue.clear();
+    for (auto& p : m_pipelines) { delete p.second; }
+    m_pipelines.clear();
+    if (m_listenFD >= 0) {
+        ::close(m_listenFD);
+        m_listenFD = -1;
+        unlink(m_path.c_str());
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int Server::run() {
+    std::vector<struct pollfd> pfds;
+    while (!quitRequested) {
+        // wait for connections, requests and writable sockets; while jobs
+        // are queued, just check for new ones between jobs; clients with
+        // a full queue aren't read from until some of their jobs are done
+        pfds.clear();
+        pfds.push_back({ m_listenFD, POLLIN, 0 });
+        for (const auto& c : m_clients) {
+            short events = (c.second.queued < MaxQueuedJobsPerClient) ? POLLIN : 0;
+            if (!c.second.output.empty()) { events |= POLLOUT; }
+            pfds.push_back({ c.first, events, 0 });
+        }
+        int res = poll(pfds.data(), nfds_t(pfds.size()), m_queue.empty() ? -1 : 0);
+        if ((res < 0) && (errno != EINTR)) {
+            perror("poll");
+            return 1;
+        }
+        if (res > 0) {
+            for (size_t i = 1;  i < pfds.size();  ++i) {
+                int sock = pfds[i].fd;
+                short rev = pfds[i].revents;
+                if (!rev) { continue; }
+                if ((rev & POLLOUT) && !flush(sock, m_clients[sock])) { dropClient(sock);  continue; }
+                if ((rev & (POLLIN | POLLHUP | POLLERR)) && !receive(sock)) { dropClient(sock); }
+            }
+            if (pfds[0].revents & POLLIN) { acceptClient(); }
+        }
+        if (!m_queue.empty()) { processJob(); }
+    }
+    return 0;
+}
+
+void Server::acceptClient() {
+    int sock = accept(m_listenFD, nullptr, nullptr);
+    if (sock < 0) { return; }
+    if (int(m_clients.size()) >= MaxClients) {
+        static const char msg[] = "ERROR too many clients\n";
+        (void)!write(sock, msg, sizeof(msg) - 1);
+        ::close(sock);
+        return;
+    }
+    fcntl(sock, F_SETFD, FD_CLOEXEC);
+    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL) | O_NONBLOCK);
+    m_clients[sock] = Client();
+    #ifndef NDEBUG
+        fprintf(stderr, "server: client %d connected\n", sock);
+    #endif
+}
+
+bool Server::receive(int sock) {
+    auto& client = m_clients[sock];
+    char buf[4096];
+    union {
+        char data[CMSG_SPACE(MaxFDsPerMessage * sizeof(int))];
+        struct cmsghdr align;
+    } ctrl;
+    struct iovec iov = { buf, sizeof(buf) };
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctrl.data;
+    msg.msg_controllen = sizeof(ctrl.data);
+    ssize_t n = recvmsg(sock, &msg, 0);
+    if ((n < 0) && ((errno == EINTR) || (errno == EAGAIN) || (errno == EWOULDBLOCK))) { return true; }
+    if (n <= 0) { return false; }
+
+    // collect the file descriptors that came with the data
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);  cmsg;  cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if ((cmsg->cmsg_level != SOL_SOCKET) || (cmsg->cmsg_type != SCM_RIGHTS)) { continue; }
+        size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        for (size_t i = 0;  i < count;  ++i) {
+            int fd;
+            memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+            fcntl(fd, F_SETFD, FD_CLOEXEC);
+            client.fds.push_back(fd);
+        }
+    }
+    if (msg.msg_flags & MSG_CTRUNC) { return false; }  // lost descriptors, can't continue
+    if (client.fds.size() > MaxPendingFDs) { return false; }  // descriptors without requests
+
+    client.input.append(buf, size_t(n));
+    return queueRequests(sock, client);
+}
+
+bool Server::queueRequests(int sock, Client& client) {
+    // split into requests; RUN requests take the next two descriptors
+    size_t start = 0, end;
+    while ((client.queued < MaxQueuedJobsPerClient)
+    &&     ((end = client.input.find('\n', start)) != std::string::npos)) {
+        Job job;
+        job.client = sock;
+        job.request = client.input.substr(start, end - start);
+        job.received = Clock::now();
+        if (!job.request.empty() && (job.request.back() == '\r')) { job.request.pop_back(); }
+        if (!strncmp(job.request.c_str(), "RUN ", 4)) {
+            for (int& fd : job.fds) {
+                if (client.fds.empty()) { break; }
+                fd = client.fds.front();
+                client.fds.pop_front();
+            }
+        }
+        m_queue.push_back(job);
+        ++client.queued;
+        start = end + 1;
+    }
+    client.input.erase(0, start);
+    // with a full queue, the rest of the input is parsed later; it can't
+    // grow much further, as the client isn't read from in the meantime
+    return (client.queued >= MaxQueuedJobsPerClient) || (client.input.size() <= MaxRequestLength);
+}
+
+bool Server::flush(int sock, Client& client) {
+    while (!client.output.empty()) {
+        ssize_t n = send(sock, client.output.data(), client.output.size(), 0);
+        if ((n < 0) && (errno == EINTR)) { continue; }
+        if ((n < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK))) { break; }
+        if (n <= 0) { return false; }
+        client.output.erase(0, size_t(n));
+    }
+    // a client that doesn't read its replies is eventually dropped
+    return (client.output.size() <= MaxPendingOutput);
+}
+
+void Server::dropClient(int sock) {
+    auto it = m_clients.find(sock);
+    if (it == m_clients.end()) { return; }
+    for (int fd : it->second.fds) { ::close(fd); }
+    m_clients.erase(it);
+    ::close(sock);
+    // queued jobs are still processed (to release their descriptors in
+    // order), but their replies are dropped
+    for (auto& job : m_queue) {
+        if (job.client == sock) { job.client = -1; }
+    }
+    #ifndef NDEBUG
+        fprintf(stderr, "server: client %d disconnected\n", sock);
+    #endif
+}
+
+void Server::processJob() {
+    Job job = m_queue.front();
+    m_queue.pop_front();
+    std::string reply = (job.client >= 0) ? handleRequest(job) : std::string();
+    for (int fd : job.fds) { if (fd >= 0) { ::close(fd); } }
+    if (job.client < 0) { return; }
+    auto& client = m_clients[job.client];
+    --client.queued;
+    client.output += reply;
+    client.output += '\n';
+    if (!flush(job.client, client) || !queueRequests(job.client, client)) {
+        dropClient(job.client);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+std::string Server::handleRequest(Job& job) {
+    // split the request into whitespace-separated arguments
+    std::vector<char*> args;
+    for (char* arg = strtok(&job.request[0], " \t");  arg;  arg = strtok(nullptr, " \t")) {
+        args.push_back(arg);
+    }
+    if (args.empty()) { return "ERROR empty request"; }
+    const char* cmd = args[0];
+    if (!strcmp(cmd, "PING")) {
+        return "OK";
+    }
+    if (!strcmp(cmd, "STATS")) {
+        char s[128];
+        snprintf(s, sizeof(s), "OK clients=%d queued=%d pipelines=%d jobs=%u",
+                 int(m_clients.size()), int(m_queue.size()), int(m_pipelines.size()), m_jobCount);
+        return s;
+    }
+    if (!strcmp(cmd, "LOAD")) {
+        if (args.size() != 2) { return "ERROR usage: LOAD <pipeline>"; }
+        float load_ms = 0.0f;
+        std::string error;
+        CachedPipeline* cp = getPipeline(args[1], load_ms, error);
+        if (!cp) { return "ERROR " + error; }
+        int errorCount = 0;
+        for (int i = 0;  i < cp->pipeline.nodeCount();  ++i) {
+            if (cp->pipeline.node(i).hasErrors()) { ++errorCount; }
+        }
+        char s[128];
+        snprintf(s, sizeof(s), "OK load=%.1f nodes=%d errors=%d", double(load_ms), cp->pipeline.nodeCount(), errorCount);
+        return s;
+    }
+    if (!strcmp(cmd, "RUN")) {
+        return handleRun(job, args);
+    }
+    return "ERROR unknown command";
+}
+
+std::string Server::handleRun(Job& job, std::vector<char*>& args) {
+    auto t0 = Clock::now();
+    if (args.size() < 6) {
+        return "ERROR usage: RUN <pipeline> <width> <height> <srcType> <destType> [options]";
+    }
+    int width = 0, height = 0;
+    PixelFormat srcType, destType, format = PixelFormat::DontCare;
+    if (!parseDimension(args[2], width) || !parseDimension(args[3], height)) { return "ERROR invalid image size"; }
+    if (!parseBufferType(args[4], srcType) || !parseBufferType(args[5], destType)) {
+        return "ERROR invalid buffer type (must be int8, int16 or float32)";
+    }
+    if ((job.fds[0] < 0) || (job.fds[1] < 0)) { return "ERROR RUN requires two file descriptors"; }
+
+    float load_ms = 0.0f;
+    std::string error;
+    CachedPipeline* cp = getPipeline(args[1], load_ms, error);
+    if (!cp) { return "ERROR " + error; }
+
+    // every job starts from the pipeline file's state
+    cp->restore();
+    int showIndex = cp->showIndex;
+    uint64_t srcOffset = 0, destOffset = 0;
+    for (size_t i = 6;  i < args.size();  ++i) {
+        char* key = args[i];
+        char* value = strchr(key, '=');
+        if (!value) { return "ERROR invalid option '" + std::string(key) + "'"; }
+        *value++ = '\0';
+        if (!strcmp(key, "format")) {
+            if (!parseFormat(value, format)) { return "ERROR invalid format"; }
+        } else if (!strcmp(key, "show")) {
+            showIndex = atoi(value);
+        } else if (!strcmp(key, "srcoffset")) {
+            if (!parseOffset(value, srcOffset)) { return "ERROR invalid source offset"; }
+        } else if (!strcmp(key, "destoffset")) {
+            if (!parseOffset(value, destOffset)) { return "ERROR invalid destination offset"; }
+        } else {
+            // parameter assignment: [<node index>:]<name>=<value>[,<value>...]
+            int nodeIndex = -1;
+            char* colon = strchr(key, ':');
+            if (colon) {
+                *colon = '\0';
+                nodeIndex = atoi(key);
+                key = colon + 1;
+            }
+            float v[4];
+            int count = 0;
+            for (char* p = value;  *p && (count < 4);  ++count) {
+                char* end = nullptr;
+                v[count] = strtof(p, &end);
+                if (end == p) { return "ERROR invalid value for parameter '" + std::string(key) + "'"; }
+                p = (*end == ',') ? (end + 1) : end;
+            }
+            int setCount = 0;
+            for (int n = 0;  n < cp->pipeline.nodeCount();  ++n) {
+                if ((nodeIndex >= 0) && (n != nodeIndex)) { continue; }
+                Parameter* param = cp->pipeline.node(n).findParam(key);
+                if (!param) { continue; }
+                memcpy(param->value(), v, size_t(count) * sizeof(float));
+                ++setCount;
+            }
+            if (!setCount) { return "ERROR unknown parameter '" + std::string(key) + "'"; }
+        }
+    }
+
+    // map the shared memory buffers (sizes can't overflow 64 bits,
+    // as the dimensions are limited to MaxImageSize)
+    uint64_t pixels = uint64_t(width) * uint64_t(height);
+    SharedBuffer src, dest;
+    if (!src.map(job.fds[0], srcOffset, pixels * uint64_t(getBytesPerPixel(srcType)), false)) {
+        return "ERROR can't map the source buffer (too small?)";
+    }
+    if (!dest.map(job.fds[1], destOffset, pixels * uint64_t(getBytesPerPixel(destType)), true)) {
+        return "ERROR can't map the destination buffer (too small or read-only?)";
+    }
+
+    // process
+    auto t1 = Clock::now();
+    cp->pipeline.changed();
+    cp->pipeline.latchParameters();
+    MemoryTileIO io(src.data, width, srcType, dest.data, width, destType);
+    bool ok = cp->pipeline.renderTiled(io, width, height, format, showIndex);
+    auto t2 = Clock::now();
+    ++m_jobCount;
+    if (!ok) { return std::string("ERROR ") + (cp->pipeline.tilingError() ? cp->pipeline.tilingError() : "rendering failed"); }
+    char s[128];
+    snprintf(s, sizeof(s), "OK wait=%.1f load=%.1f render=%.1f total=%.1f",
+             double(ms(job.received, t0)), double(load_ms), double(ms(t1, t2)), double(ms(job.received, t2)));
+    return s;
+}
+
+CachedPipeline* Server::getPipeline(const char* filename, float& load_ms, std::string& error) {
+    auto t0 = Clock::now();
+    FileUtil::FileFingerprint fp(filename);
+    auto it = m_pipelines.find(filename);
+    if ((it != m_pipelines.end()) && (it->second->fp == fp)) {
+        // shaders that have been changed are still reloaded
+        it->second->pipeline.reload();
+        it->second->lastUsed = m_jobCount;
+        load_ms = ms(t0, Clock::now());
+        return it->second;
+    }
+    if (it != m_pipelines.end()) {
+        delete it->second;
+        m_pipelines.erase(it);
+    }
+    #ifndef NDEBUG
+        fprintf(stderr, "server: loading pipeline '%s'\n", filename);
+    #endif
+
+    // evict the least recently used pipeline if there are too many
+    if (m_pipelines.size() >= MaxCachedPipelines) {
+        auto lru = m_pipelines.begin();
+        for (auto i = m_pipelines.begin();  i != m_pipelines.end();  ++i) {
+            if (i->second->lastUsed < lru->second->lastUsed) { lru = i; }
+        }
+        delete lru->second;
+        m_pipelines.erase(lru);
+    }
+
+    char* data = StringUtil::loadTextFile(filename);
+    if (!data) { error = "can't read pipeline file";  return nullptr; }
+    CachedPipeline* cp = new CachedPipeline;
+    VFS::TemporaryRoot tempRoot;
+    tempRoot.begin(filename);
+    cp->showIndex = cp->pipeline.init() ? cp->pipeline.unserialize(data) : -1;
+    tempRoot.end();
+    ::free(data);
+    if (cp->showIndex < 0) {
+        delete cp;
+        error = "invalid pipeline file";
+        return nullptr;
+    }
+    cp->fp = fp;
+    cp->lastUsed = m_jobCount;
+    cp->snapshot();
+    m_pipelines[filename] = cp;
+    load_ms = ms(t0, Clock::now());
+    return cp;
+}
+
+}  // anonymous namespace
+
+///////////////////////////////////////////////////////////////////////////////
+
+int App::runServer(const char* socketPath) {
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = handleQuitSignal;  // no SA_RESTART, so poll() is interrupted
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+    signal(SIGPIPE, SIG_IGN);
+
+    Server server;
+    if (!server.open(socketPath)) { return 1; }
+    fprintf(stderr, "GIPS server listening on %s\n", socketPath);
+    int res = server.run();
+    server.close();
+    fprintf(stderr, "GIPS server stopped\n");
+    return res;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+}  // namespace GIPS
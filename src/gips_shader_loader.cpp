@@ -29,6 +29,19 @@ namespace GIPS {
 
 constexpr float MaxSupportedVersionCode = 1.0;
 
+//! output conversion for single-channel pipeline formats: only the red
+//! channel is stored, so put the luminance there
+static const char monoOutputCode[] =
+    "  if (gips_mono > 0.5) { gips_frag.r = dot(gips_frag.rgb, vec3(0.2126, 0.7152, 0.0722)); }\n";
+
+//! pixel positions in the whole image instead of the current tile;
+//! references to gl_FragCoord in user code are renamed to use this
+static const char tileOffsetCode[] =
+    "uniform vec2 gips_tile_offset;\n"
+    "#define gips_tiled_gl_FragCoord (gl_FragCoord + vec4(gips_tile_offset, 0.0, 0.0))\n";
+static const std::vector<std::string> fragCoordNames { "gl_FragCoord" };
+static const char fragCoordPrefix[] = "gips_tiled_";
+
 enum class GLSLToken : int {
     Other       = 0,
     Ignored     = -1,
@@ -37,43 +50,77 @@ enum class GLSLToken : int {
     Vec2        = 2,
     Vec3        = 3,
     Vec4        = 4,
+    MapFunc     = 98,
     RunSingle   = 99,
-    RunPass1    = 100,
-    RunPass2    = 200,
-    RunPass3    = 300,
-    RunPass4    = 400,
+    RunPass     = 100,
     OpenParens  = 90,
     CloseParens = 91,
+    InputRef    = 50,
+    PosRef      = 51,
 };
 
 enum class PassInput { Coord, RGB, RGBA };
 enum class PassOutput { RGB, RGBA };
 
 static const StringUtil::LookupEntry<GLSLToken> tokenMap[] = {
-    { "in",        GLSLToken::Ignored },
-    { "uniform",   GLSLToken::Uniform },
-    { "float",     GLSLToken::Float },
-    { "vec2",      GLSLToken::Vec2 },
-    { "vec3",      GLSLToken::Vec3 },
-    { "vec4",      GLSLToken::Vec4 },
-    { "run",       GLSLToken::RunSingle },
-    { "run_pass1", GLSLToken::RunPass1 },
-    { "run_pass2", GLSLToken::RunPass2 },
-    { "run_pass3", GLSLToken::RunPass3 },
-    { "run_pass4", GLSLToken::RunPass4 },
-    { "(",         GLSLToken::OpenParens },
-    { ")",         GLSLToken::CloseParens },
-    { "){",        GLSLToken::CloseParens },
-    { nullptr,     GLSLToken::Other },
+    { "in",              GLSLToken::Ignored },
+    { "uniform",         GLSLToken::Uniform },
+    { "float",           GLSLToken::Float },
+    { "vec2",            GLSLToken::Vec2 },
+    { "vec3",            GLSLToken::Vec3 },
+    { "vec4",            GLSLToken::Vec4 },
+    { "map",             GLSLToken::MapFunc },
+    { "run",             GLSLToken::RunSingle },
+    { "(",               GLSLToken::OpenParens },
+    { ")",               GLSLToken::CloseParens },
+    { "){",              GLSLToken::CloseParens },
+    { "pixel",           GLSLToken::InputRef },
+    { "pixel_lod",       GLSLToken::InputRef },
+    { "gips_tex",        GLSLToken::InputRef },
+    { "gips_pos",        GLSLToken::PosRef },
+    { "gips_image_size", GLSLToken::PosRef },
+    { "gl_FragCoord",    GLSLToken::PosRef },
+    { nullptr,           GLSLToken::Other },
 };
 
+//! get the pass index from a "run_passN" identifier (-1 if it isn't one)
+static int getRunPassIndex(const char* ident) {
+    if (strncmp(ident, "run_pass", 8) || !isdigit(ident[8])) { return -1; }
+    char* end = nullptr;
+    long n = strtol(&ident[8], &end, 10);
+    return ((n >= 1) && (n <= 1000) && end && !*end) ? int(n - 1) : -1;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 
+//! prefix all occurrences of the specified (global) identifiers in GLSL code
+static std::string renameIdentifiers(const std::string& code, const std::vector<std::string>& names, const std::string& prefix) {
+    std::string res;
+    StringUtil::Tokenizer tok(code.c_str(), int(code.size()));
+    int pos = 0;
+    while (tok.next()) {
+        res.append(code, size_t(pos), size_t(tok.start() - pos));
+        pos = tok.end();
+        std::string token(tok.stringFromStart(), size_t(tok.length()));
+        if (isalpha(token[0]) || (token[0] == '_')) {
+            // only consider the part before a member access / swizzle
+            std::string base(token, 0, token.find('.'));
+            if (std::find(names.begin(), names.end(), base) != names.end()) {
+                res += prefix;
+            }
+        }
+        res += token;
+    }
+    res.append(code, size_t(pos), std::string::npos);
+    return res;
+}
+
 bool Node::load(const char* filename, const GLutil::Shader& vs, const FileUtil::FileFingerprint* fp) {
     // Declare all variables right here, C89-style.
     // This is required because we're using "goto end"-style error handling
     // here, and we can't jump over class initializations.
     char *code = nullptr;
+    std::string userCode;
     std::vector<Parameter> newParams;
     std::ostringstream shader;
     std::ostringstream err;
@@ -85,12 +132,30 @@ bool Node::load(const char* filename, const GLutil::Shader& vs, const FileUtil::
     int paramValueIndex = -1;
     bool inParamStatement = false;
     int currentPass = 0;
-    int passMask = 0;
+    int runPassIndex = 0;
+    int passCount = 0;
+    std::vector<bool> passDefined;
     bool singlePass = false;
-    PassInput inputs[MaxPasses];
-    PassOutput outputs[MaxPasses];
+    std::vector<PassInput> inputs;
+    std::vector<PassOutput> outputs;
+    std::string pendingOutput;
+    int bodyPass = -1;
+    std::vector<std::pair<std::string, int>> bufferRefs;
     bool texFilter = true;
     CoordMapMode coordMode = CoordMapMode::None;
+    float passScale = 1.0f;
+    bool mipmap = false;
+    PixelFormat passFormat = PixelFormat::DontCare;
+    bool readsInput = false;
+    bool readsPosition = false;
+    bool declaredNoInput = false;
+    LUT3D lut;
+    std::string lutErr;
+    bool mapFound = false;
+    int scopeDepth = 0;
+    std::string lastIdent;
+    std::vector<std::string> globalNames;
+    static unsigned loadSerial = 0;
     static constexpr int GLSLTokenHistorySize = 4;
     GLSLToken tt[GLSLTokenHistorySize] = { GLSLToken::Other, };
 
@@ -104,15 +169,40 @@ bool Node::load(const char* filename, const GLutil::Shader& vs, const FileUtil::
     // initialize member variables to pessimistic defaults
     m_programChanged = true;
     m_passCount = 0;
+    m_passes.clear();
+    m_buffers.clear();
     m_filename = filename;
     {
         const char *basename = StringUtil::pathBaseName(filename);
         m_name = std::string(basename, size_t(StringUtil::pathExtStartIndex(basename)));
     }
     m_preferredFormat = PixelFormat::DontCare;
-
-    // load the file
-    code = StringUtil::loadTextFile(filename);
+    m_halo = -1;
+    m_inputIndependent = false;
+    m_pointwise = false;
+    m_pixelLocal = false;
+    m_isMap = false;
+    m_mapCode.clear();
+    m_globalNames.clear();
+    m_loadSerial = ++loadSerial;
+    freeCache();
+
+    // load the file; 3D LUTs are turned into a generated shader that
+    // samples the LUT as a 3D texture
+    if (StringUtil::extractExtCode(filename) == StringUtil::makeExtCode("cube")) {
+        if (!lut.load(filename, lutErr)) {
+            err << "(GIPS) " << lutErr << "\n";
+            goto load_finalize;
+        }
+        if (!lut.upload(m_lutTex)) {
+            err << "(GIPS) failed to create 3D LUT texture\n";
+            goto load_finalize;
+        }
+        code = StringUtil::copy(lut.shaderCode().c_str());
+    } else {
+        freeLUT();
+        code = StringUtil::loadTextFile(filename);
+    }
     if (!code) {
         err << "(GIPS) failed to load input file '" << filename << "'\n";
         goto load_finalize;
@@ -218,21 +308,63 @@ bool Node::load(const char* filename, const GLutil::Shader& vs, const FileUtil::
                 } else if (isKey("color")  && needParam()) {
                     setParamType(GLSLToken::Vec3, ParameterType::RGB, false) ||
                     setParamType(GLSLToken::Vec4, ParameterType::RGBA, true);
+                } else if (isKey("identity") && needParam()) {
+                    if (!value || needNum()) {
+                        // without a value, the parameter's default is its identity value
+                        for (int i = 0;  i < 4;  ++i) {
+                            param->m_identityValue[i] = value ? fval : param->m_defaultValue[i];
+                        }
+                        param->m_hasIdentity = true;
+                    }
                 } else if ((isKey("coord") || isKey("coords") || isKey("map")) && needGlobal() && needValue()) {
                          if (isValue("pixel")) { coordMode = CoordMapMode::Pixel; }
                     else if (isValue("none"))  { coordMode = CoordMapMode::None; }
                     else if (isValue("relative") || isValue("rel")) { coordMode = CoordMapMode::Relative; }
                     else { err << "(GIPS) unrecognized coordinate mapping mode '" << value << "'\n"; }
                 } else if ((isKey("format") || isKey("fmt")) && needGlobal() && needValue()) {
-                         if (isValue("int8") || isValue("8") || isValue("i8") || isValue("u8")) { m_preferredFormat = PixelFormat::Int8; }
-                    else if (isValue("int16") || isValue("16") || isValue("i16") || isValue("u16")) { m_preferredFormat = PixelFormat::Int16; }
-                    else if (isValue("float16") || isValue("116") || isValue("f16") || isValue("fp16")) { m_preferredFormat = PixelFormat::Float16; }
-                    else if (isValue("float32") || isValue("132") || isValue("f32") || isValue("fp32")) { m_preferredFormat = PixelFormat::Float32; }
+                         if (isValue("int8") || isValue("8") || isValue("i8") || isValue("u8")) { passFormat = PixelFormat::Int8; }
+                    else if (isValue("int16") || isValue("16") || isValue("i16") || isValue("u16")) { passFormat = PixelFormat::Int16; }
+                    else if (isValue("float16") || isValue("116") || isValue("f16") || isValue("fp16")) { passFormat = PixelFormat::Float16; }
+                    else if (isValue("float32") || isValue("132") || isValue("f32") || isValue("fp32")) { passFormat = PixelFormat::Float32; }
+                    else if (isValue("gray8") || isValue("grey8") || isValue("r8")) { passFormat = PixelFormat::Gray8; }
+                    else if (isValue("srgb") || isValue("srgb8") || isValue("linear")) { passFormat = PixelFormat::SRGB8; }
+                    else if (isValue("gray16f") || isValue("grey16f") || isValue("r16f")) { passFormat = PixelFormat::Gray16F; }
+                    else if (isValue("rgb10a2") || isValue("rgb10_a2") || isValue("10")) { passFormat = PixelFormat::RGB10A2; }
+                    else if (isValue("rgb11f") || isValue("r11g11b10f") || isValue("r11f_g11f_b10f")) { passFormat = PixelFormat::RGB11F; }
+                    else if (isValue("auto") || isValue("default")) { passFormat = PixelFormat::DontCare; }
                     else { err << "(GIPS) unrecognized pixel format '" << value << "'\n"; }
+                    // the node as a whole prefers a format that suits all of its passes
+                    m_preferredFormat = mergePixelFormats(m_preferredFormat, passFormat);
+                } else if (isKey("input") && needGlobal() && needValue()) {
+                         if (isValue("none") || isValue("0") || isValue("off")) { declaredNoInput = true; }
+                    else if (isValue("image") || isValue("1") || isValue("on")) { declaredNoInput = false; }
+                    else { err << "(GIPS) unrecognized input mode '" << value << "'\n"; }
+                } else if (isKey("output") && needGlobal() && needValue()) {
+                    pendingOutput = value;
+                    for (const char* c = value;  *c;  ++c) {
+                        if (!isalnum(static_cast<unsigned char>(*c)) && (*c != '_')) { pendingOutput.clear(); }
+                    }
+                    if (pendingOutput.empty()) {
+                        err << "(GIPS) invalid output buffer name '" << value << "'\n";
+                    } else if (pendingOutput == "lod") {
+                        // pixel_lod() is the built-in mipmap accessor
+                        err << "(GIPS) output buffer name 'lod' is reserved\n";
+                        pendingOutput.clear();
+                    }
                 } else if ((isKey("filter") || isKey("filt")) && needGlobal() && needValue()) {
                          if (isValue("1") || isValue("on")  || isValue("linear")  || isValue("bilinear")) { texFilter = true; }
                     else if (isValue("0") || isValue("off") || isValue("nearest") || isValue("point"))    { texFilter = false; }
                     else { err << "(GIPS) unrecognized texture filtering mode '" << value << "'\n"; }
+                } else if ((isKey("mipmap") || isKey("mipmaps") || isKey("lod")) && needGlobal()) {
+                         if (!value || isValue("1") || isValue("on"))  { mipmap = true; }
+                    else if (isValue("0") || isValue("off")) { mipmap = false; }
+                    else { err << "(GIPS) unrecognized mipmap mode '" << value << "'\n"; }
+                } else if (isKey("scale") && needGlobal() && needNum()) {
+                    if ((fval >= 0.01f) && (fval <= 1.0f)) { passScale = fval; }
+                    else { err << "(GIPS) pass scale must be between 0.01 and 1\n"; }
+                } else if (isKey("halo") && needGlobal() && needNum()) {
+                    if (fval >= 0.0f) { m_halo = int(std::ceil(fval)); }
+                    else { err << "(GIPS) halo size must not be negative\n"; }
                 } else if ((isKey("version") || isKey("gips_version")) && needGlobal() && needNum()) {
                     if (fval > MaxSupportedVersionCode) {
                         err << "(GIPS) shader requires GIPS version " << fval << ", but only " << MaxSupportedVersionCode << " is supported\n";
@@ -259,11 +391,48 @@ bool Node::load(const char* filename, const GLutil::Shader& vs, const FileUtil::
             continue;
         }   // END of comment handling
 
+        // keep track of identifiers declared at global scope
+        // (they need to be renamed when composing map() functions)
+        // and of the passes that read named buffers
+        if (isalpha(tok.token()[0]) || (tok.token()[0] == '_')) {
+            lastIdent = std::string(tok.stringFromStart(), size_t(tok.length()));
+            if (lastIdent.find('.') != std::string::npos) { lastIdent.clear(); }
+            if (scopeDepth && !strncmp(tok.token(), "pixel_", 6) && strcmp(tok.token(), "pixel_lod")) {
+                bufferRefs.emplace_back(std::string(tok.stringFromStart() + 6, size_t(tok.length() - 6)), bodyPass);
+            }
+        } else {
+            if (!scopeDepth && !lastIdent.empty() && strchr("(=;,[", tok.token()[0])
+            && (std::find(globalNames.begin(), globalNames.end(), lastIdent) == globalNames.end())) {
+                globalNames.push_back(lastIdent);
+            }
+            if (!scopeDepth && !lastIdent.empty() && (tok.token()[0] == '(')) {
+                // function definition: note which pass it belongs to;
+                // helper functions might be called from any pass
+                bodyPass = ((lastIdent == "run") || (lastIdent == "map")) ? 0 : getRunPassIndex(lastIdent.c_str());
+            }
+            const char* t = tok.stringFromStart();
+            for (int i = tok.length();  i;  --i, ++t) {
+                     if ((*t == '(') || (*t == '{')) { ++scopeDepth; }
+                else if ((*t == ')') || (*t == '}')) { --scopeDepth; }
+            }
+            lastIdent.clear();
+        }
+
         // add token type to history
         GLSLToken newTT = StringUtil::lookup(tokenMap,tok.token());
         if (newTT == GLSLToken::Ignored) {
             continue;
         }
+        if ((newTT == GLSLToken::Other) && (getRunPassIndex(tok.token()) >= 0)) {
+            newTT = GLSLToken::RunPass;
+            runPassIndex = getRunPassIndex(tok.token());
+        }
+        if (newTT == GLSLToken::InputRef) {
+            readsInput = true;
+        }
+        if (newTT == GLSLToken::PosRef) {
+            readsPosition = true;
+        }
         for (int i = GLSLTokenHistorySize - 1;  i;  --i) { tt[i] = tt[i-1]; }
         tt[0] = newTT;
 
@@ -322,20 +491,23 @@ bool Node::load(const char* filename, const GLutil::Shader& vs, const FileUtil::
         // check pass definition
         // pattern: [3]="vec3/4", [2]="run[_passX]", [1]="(", [0]="vec2/3/4"
         if (((tt[3] == GLSLToken::Vec3) || (tt[3] == GLSLToken::Vec4))
-        &&  ((tt[2] == GLSLToken::RunSingle) || (tt[2] == GLSLToken::RunPass1) || (tt[2] == GLSLToken::RunPass2) || (tt[2] == GLSLToken::RunPass3) || (tt[2] == GLSLToken::RunPass4))
+        &&  ((tt[2] == GLSLToken::RunSingle) || (tt[2] == GLSLToken::RunPass))
         &&   (tt[1] == GLSLToken::OpenParens)
         &&  ((tt[0] == GLSLToken::Vec2) || (tt[0] == GLSLToken::Vec3) || (tt[0] == GLSLToken::Vec4)))
         {
-            switch (tt[2]) {
-                case GLSLToken::RunSingle: currentPass = 0; singlePass = true; break;
-                case GLSLToken::RunPass1:  currentPass = 0; singlePass = false; break;
-                case GLSLToken::RunPass2:  currentPass = 1; break;
-                case GLSLToken::RunPass3:  currentPass = 2; break;
-                case GLSLToken::RunPass4:  currentPass = 3; break;
-                default: assert(0);
+            if (tt[2] == GLSLToken::RunSingle) {
+                currentPass = 0; singlePass = true;
+            } else {
+                currentPass = runPassIndex;
+                if (!currentPass) { singlePass = false; }
+            }
+            if (size_t(currentPass) >= passDefined.size()) {
+                passDefined.resize(size_t(currentPass + 1), false);
+                inputs.resize(size_t(currentPass + 1), PassInput::Coord);
+                outputs.resize(size_t(currentPass + 1), PassOutput::RGBA);
+                m_passes.resize(size_t(currentPass + 1));
             }
-            passMask |= (1 << currentPass);
-            if (currentPass >= MaxPasses) { continue; }
+            passDefined[size_t(currentPass)] = true;
             switch (tt[0]) {
                 case GLSLToken::Vec2: inputs[currentPass] = PassInput::Coord; break;
                 case GLSLToken::Vec3: inputs[currentPass] = PassInput::RGB;   break;
@@ -348,8 +520,38 @@ bool Node::load(const char* filename, const GLutil::Shader& vs, const FileUtil::
                 default: assert(0);
             }
             // apply pass settings
-            m_passes[currentPass].texFilter = texFilter;
-            m_passes[currentPass].coordMode = coordMode;
+            m_passes[size_t(currentPass)].texFilter = texFilter;
+            m_passes[size_t(currentPass)].coordMode = coordMode;
+            m_passes[size_t(currentPass)].scale = passScale;
+            m_passes[size_t(currentPass)].mipmap = mipmap;
+            m_passes[size_t(currentPass)].format = passFormat;
+            if (!pendingOutput.empty()) {
+                int b = 0;
+                while ((b < int(m_buffers.size())) && (m_buffers[size_t(b)].name != pendingOutput)) { ++b; }
+                if (b >= MaxNamedBuffers) {
+                    err << "(GIPS) too many output buffers, at most " << MaxNamedBuffers << " are supported\n";
+                } else if (b < int(m_buffers.size())) {
+                    err << "(GIPS) output buffer '" << pendingOutput << "' is written by multiple passes\n";
+                } else {
+                    m_buffers.emplace_back();
+                    m_buffers.back().name = pendingOutput;
+                    m_buffers.back().producer = currentPass;
+                    m_passes[size_t(currentPass)].outputBuffer = b;
+                }
+                pendingOutput.clear();
+            }
+            continue;
+        }
+
+        // check coordinate mapping function definition
+        // pattern: [3]="vec2", [2]="map", [1]="(", [0]="vec2"
+        if ((tt[3] == GLSLToken::Vec2) && (tt[2] == GLSLToken::MapFunc)
+        &&  (tt[1] == GLSLToken::OpenParens) && (tt[0] == GLSLToken::Vec2)) {
+            mapFound = true;
+            if (m_passes.empty()) { m_passes.resize(1); }
+            m_passes[0].texFilter = texFilter;
+            m_passes[0].coordMode = coordMode;
+            m_passes[0].format = passFormat;
             continue;
         }
     }   // END of GLSL tokenizer loop
@@ -378,18 +580,88 @@ bool Node::load(const char* filename, const GLutil::Shader& vs, const FileUtil::
         }
     }
 
+    // a map() function defines an implicit single pass
+    // that samples the input at the mapped position
+    if (mapFound) {
+        if (!passDefined.empty()) {
+            err << "(GIPS) 'map' and 'run' functions can't be used in the same shader\n";
+            goto load_finalize;
+        }
+        passDefined.push_back(true);
+        singlePass = true;
+        inputs.push_back(PassInput::Coord);
+        outputs.push_back(PassOutput::RGBA);
+        m_isMap = true;
+    }
+
     // first pass defined?
-    if (!(passMask & 1)) {
+    if (passDefined.empty() || !passDefined[0]) {
         err << "(GIPS) no valid 'run' or 'run_pass1' function found\n";
         goto load_finalize;
     }
 
+    // all passes defined?
+    while ((size_t(passCount) < passDefined.size()) && passDefined[size_t(passCount)]) { ++passCount; }
+    if (size_t(passCount) < passDefined.size()) {
+        err << "(GIPS) intermediate passes are missing, truncating pipeline\n";
+    }
+
+    // if the last pass runs at reduced resolution, its result needs to be
+    // brought back to full size; do this in an implicit extra pass
+    if (!m_isMap && (m_passes[size_t(passCount - 1)].scale != 1.0f)) {
+        m_passes.resize(size_t(passCount + 1));
+        inputs.resize(size_t(passCount + 1));
+        outputs.resize(size_t(passCount + 1));
+        inputs[size_t(passCount)] = PassInput::RGBA;
+        outputs[size_t(passCount)] = PassOutput::RGBA;
+        m_passes[size_t(passCount)].upsample = true;
+        m_passes[size_t(passCount)].format = m_passes[size_t(passCount - 1)].format;
+        ++passCount;
+    }
+
+    // determine the lifetime of the named buffers
+    for (const auto& ref : bufferRefs) {
+        for (auto& buf : m_buffers) {
+            if (buf.name != ref.first) { continue; }
+            int reader = (ref.second < 0) ? (passCount - 1) : ref.second;
+            buf.lastReader = std::max(buf.lastReader, reader);
+        }
+    }
+
+    // a node whose first pass never samples the input image doesn't depend
+    // on anything upstream; this is either declared explicitly (which is
+    // necessary for multi-pass shaders that use pixel() in later passes)
+    // or detected by the absence of any reference to the input texture
+    if (declaredNoInput && (inputs[0] != PassInput::Coord)) {
+        err << "(GIPS) '@input=none' is incompatible with a color-input 'run' function\n";
+    }
+    m_inputIndependent = (inputs[0] == PassInput::Coord) && !m_isMap && (declaredNoInput || !readsInput);
+
+    // a node that only ever sees the pixel it's writing doesn't need any
+    // overlap in tiled mode; if it only sees its RGB color (keeping alpha)
+    // and doesn't depend on the position either, it can be baked into
+    // a 3D LUT
+    m_pixelLocal = !m_isMap && !readsInput && m_buffers.empty();
+    for (currentPass = 0;  currentPass < passCount;  ++currentPass) {
+        if (inputs[size_t(currentPass)] == PassInput::Coord) { m_pixelLocal = false; }
+        if (m_passes[size_t(currentPass)].scale != 1.0f) { m_pixelLocal = false; }
+        if (m_passes[size_t(currentPass)].mipmap) { m_pixelLocal = false; }
+    }
+    m_pointwise = m_pixelLocal && !readsPosition;
+    for (currentPass = 0;  currentPass < passCount;  ++currentPass) {
+        if (inputs[size_t(currentPass)] != PassInput::RGB) { m_pointwise = false; }
+        if (outputs[size_t(currentPass)] != PassOutput::RGB) { m_pointwise = false; }
+    }
+
     // generate code for the passes
-    for (currentPass = 0;  (currentPass < MaxPasses) && ((passMask >> currentPass) & 1);  ++currentPass) {
-        auto& pass = m_passes[currentPass];
-        passMask &= ~(1 << currentPass);
-        PassInput input = inputs[currentPass];
-        PassOutput output = outputs[currentPass];
+    userCode = renameIdentifiers(code, fragCoordNames, fragCoordPrefix);
+    for (auto& p : newParams) {
+        p.m_location.assign(size_t(passCount), -1);
+    }
+    for (currentPass = 0;  currentPass < passCount;  ++currentPass) {
+        auto& pass = m_passes[size_t(currentPass)];
+        PassInput input = inputs[size_t(currentPass)];
+        PassOutput output = outputs[size_t(currentPass)];
         if (input != PassInput::Coord) {
             // coordinate remapping not needed (nor wanted) for RGB(A)->RGB(A) filters
             pass.coordMode = CoordMapMode::None;
@@ -403,46 +675,93 @@ bool Node::load(const char* filename, const GLutil::Shader& vs, const FileUtil::
                   "in vec2 gips_pos;\n"
                   "out vec4 gips_frag;\n"
                   "uniform sampler2D gips_tex;\n"
-                  "uniform vec2 gips_image_size;\n";
+                  "uniform vec2 gips_image_size;\n"
+                  "uniform float gips_mono;\n"
+               << tileOffsetCode;
+        if (m_lutTex) {
+            shader << "uniform sampler3D gips_lut;\n";
+        }
+        if ((input == PassInput::Coord) || !m_buffers.empty()) {
+            shader << "uniform vec4 gips_map2tex;\n";
+        }
         if (input == PassInput::Coord) {
-            shader << "uniform vec4 gips_map2tex;\n"
-                      "vec4 pixel(in vec2 pos) {\n"
+            shader << "vec4 pixel(in vec2 pos) {\n"
                       "  return textureLod(gips_tex, gips_map2tex.xy + pos * gips_map2tex.zw, 0.0);\n"
+                      "}\n"
+                      "vec4 pixel_lod(in vec2 pos, in float lod) {\n"
+                      "  return textureLod(gips_tex, gips_map2tex.xy + pos * gips_map2tex.zw, lod);\n"
                       "}\n";
         }
-
-        // fragment shader assembly: add user code
-        shader << "#line 1 " << (currentPass + 1) << "\n" << code;
-
-        // fragment shader assembly: main() function prologue
-        shader << "\n#line 9000 0\n"
-                  "void main() {\n";
-        if (input != PassInput::Coord) {
-            // Coord->RGB(A) case: implicit texture lookup
-            shader << "  vec4 color = texture(gips_tex, gips_pos);\n";
+        for (const auto& buf : m_buffers) {
+            // since the code of all passes is compiled into every pass,
+            // the accessors need to be present everywhere, too
+            shader << "uniform sampler2D gips_buf_" << buf.name << ";\n"
+                      "vec4 pixel_" << buf.name << "(in vec2 pos) {\n"
+                      "  return textureLod(gips_buf_" << buf.name << ", gips_map2tex.xy + pos * gips_map2tex.zw, 0.0);\n"
+                      "}\n"
+                      "vec4 pixel_" << buf.name << "() {\n"
+                      "  return textureLod(gips_buf_" << buf.name << ", gips_map2tex.xy + gips_pos * gips_map2tex.zw, 0.0);\n"
+                      "}\n";
         }
 
-        // fragment shader assembly: output statement generation
-        shader << "  gips_frag = ";
-        if (output == PassOutput::RGB) {
-            shader << "vec4(";  // if output isn't already RGBA, convert it
-        }
-        shader << "run";
-        if (currentPass || !singlePass) { shader << "_pass" << (currentPass + 1); }
-        switch (input) {
-            case PassInput::Coord: shader << "(gips_pos)";  break;
-            case PassInput::RGB:   shader << "(color.rgb)"; break;
-            case PassInput::RGBA:  shader << "(color)";     break;
-            // do default; all enumerants are expected to be covered
-        }
-        if (output == PassOutput::RGB) {
-            if (input == PassInput::Coord) {
-                shader << ", 1.0)";  // Coord->RGB case: set alpha to 1
+        if (pass.upsample) {
+            // implicit upsampling pass: bicubic B-spline interpolation,
+            // using four bilinear lookups instead of sixteen point samples
+            shader << "\n#line 9000 0\n"
+                      "void main() {\n"
+                      "  vec2 size = vec2(textureSize(gips_tex, 0));\n"
+                      "  vec2 p = gips_pos * size - 0.5;\n"
+                      "  vec2 f = fract(p);  p -= f;\n"
+                      "  vec2 g = 1.0 - f;\n"
+                      "  vec2 w0 = g * g * g / 6.0;\n"
+                      "  vec2 w1 = (4.0 - 6.0 * f * f + 3.0 * f * f * f) / 6.0;\n"
+                      "  vec2 w3 = f * f * f / 6.0;\n"
+                      "  vec2 w2 = 1.0 - w0 - w1 - w3;\n"
+                      "  vec2 s0 = w0 + w1, s1 = w2 + w3;\n"
+                      "  vec2 t0 = (p - 0.5 + w1 / s0) / size;\n"
+                      "  vec2 t1 = (p + 1.5 + w3 / s1) / size;\n"
+                      "  gips_frag = s0.y * (s0.x * texture(gips_tex, vec2(t0.x, t0.y)) + s1.x * texture(gips_tex, vec2(t1.x, t0.y)))\n"
+                      "            + s1.y * (s0.x * texture(gips_tex, vec2(t0.x, t1.y)) + s1.x * texture(gips_tex, vec2(t1.x, t1.y)));\n"
+                      "}\n";
+        } else {
+            // fragment shader assembly: add user code
+            shader << "#line 1 " << (currentPass + 1) << "\n" << userCode;
+
+            // fragment shader assembly: main() function prologue
+            shader << "\n#line 9000 0\n"
+                      "void main() {\n";
+            if (input != PassInput::Coord) {
+                // Coord->RGB(A) case: implicit texture lookup
+                shader << "  vec4 color = texture(gips_tex, gips_pos);\n";
+            }
+
+            // fragment shader assembly: output statement generation
+            shader << "  gips_frag = ";
+            if (m_isMap) {
+                // map() node: implicit texture lookup at the mapped position
+                shader << "pixel(map(gips_pos))";
             } else {
-                shader << ", color.a)";  // RGB(A)->RGB case: keep source alpha
+                if (output == PassOutput::RGB) {
+                    shader << "vec4(";  // if output isn't already RGBA, convert it
+                }
+                shader << "run";
+                if (currentPass || !singlePass) { shader << "_pass" << (currentPass + 1); }
+                switch (input) {
+                    case PassInput::Coord: shader << "(gips_pos)";  break;
+                    case PassInput::RGB:   shader << "(color.rgb)"; break;
+                    case PassInput::RGBA:  shader << "(color)";     break;
+                    // do default; all enumerants are expected to be covered
+                }
+                if (output == PassOutput::RGB) {
+                    if (input == PassInput::Coord) {
+                        shader << ", 1.0)";  // Coord->RGB case: set alpha to 1
+                    } else {
+                        shader << ", color.a)";  // RGB(A)->RGB case: keep source alpha
+                    }
+                }
             }
+            shader << ";\n" << monoOutputCode << "}\n";
         }
-        shader << ";\n}\n";
 
         // compile shader and link program
         fs.compile(GL_FRAGMENT_SHADER, shader.str().c_str());
@@ -465,9 +784,16 @@ bool Node::load(const char* filename, const GLutil::Shader& vs, const FileUtil::
         glUniform4f(prog->getUniformLocation("gips_pos2ndc"), -1.0f, -1.0f, 2.0f, 2.0f);
         pass.locImageSize = prog->getUniformLocation("gips_image_size");
         pass.locRel2Map = prog->getUniformLocation("gips_rel2map");
-        pass.locMap2Tex = (input == PassInput::Coord) ? prog->getUniformLocation("gips_map2tex") : (-1);
+        pass.locMap2Tex = prog->getUniformLocation("gips_map2tex");
+        pass.locMono = prog->getUniformLocation("gips_mono");
+        pass.locTileOffset = prog->getUniformLocation("gips_tile_offset");
+        for (size_t b = 0;  b < m_buffers.size();  ++b) {
+            glUniform1i(prog->getUniformLocation(("gips_buf_" + m_buffers[b].name).c_str()), GLint(2 + b));
+        }
+        pass.locLUT = m_lutTex ? prog->getUniformLocation("gips_lut") : (-1);
+        if (pass.locLUT >= 0) { glUniform1i(pass.locLUT, 1); }
         for (auto& p : newParams) {
-            p.m_location[currentPass] = prog->getUniformLocation(p.m_name.c_str());
+            p.m_location[size_t(currentPass)] = prog->getUniformLocation(p.m_name.c_str());
         }
         GLutil::checkError("node uniform lookup");
 
@@ -475,13 +801,12 @@ bool Node::load(const char* filename, const GLutil::Shader& vs, const FileUtil::
         glUseProgram(0);
     }   // END of pass instantiation loop
 
-    // all passes processed?
-    if (passMask) {
-        err << "(GIPS) intermediate passes are missing, truncating pipeline\n";
-    }
-
     // setup done, proclaim success
     m_passCount = currentPass;
+    if (m_isMap) {
+        m_mapCode = userCode;
+        m_globalNames = globalNames;
+    }
 
 load_finalize:
     ::free(code);
@@ -492,4 +817,84 @@ load_finalize:
 
 ///////////////////////////////////////////////////////////////////////////////
 
+bool Pipeline::buildMapChain(MapChain& chain) {
+    std::ostringstream shader;
+    GLutil::Shader fs;
+    size_t nodeCount = chain.nodes.size();
+    const auto prefix = [] (size_t i) -> std::string {
+        return "gips_n" + std::to_string(i + 1) + "_";
+    };
+
+    // boilerplate
+    shader << "#version 330 core\n"
+              "#line 8000 0\n"
+              "in vec2 gips_pos;\n"
+              "out vec4 gips_frag;\n"
+              "uniform sampler2D gips_tex;\n"
+              "uniform vec2 gips_image_size;\n"
+              "uniform float gips_mono;\n"
+           << tileOffsetCode;
+    for (size_t i = 0;  i < nodeCount;  ++i) {
+        shader << "uniform vec4 " << prefix(i) << "rel2map;\n"
+                  "uniform vec4 " << prefix(i) << "map2tex;\n";
+    }
+
+    // user code, with global identifiers made unique
+    for (size_t i = 0;  i < nodeCount;  ++i) {
+        const Node& node = *chain.nodes[i];
+        shader << "#line 1 " << (i + 1) << "\n"
+               << renameIdentifiers(node.m_mapCode, node.m_globalNames, prefix(i)) << "\n";
+    }
+
+    // main function: starting with the texture coordinate of the output
+    // pixel, go upstream through all mapping functions
+    shader << "#line 9000 0\n"
+              "void main() {\n"
+              "  vec2 t = gips_pos;\n";
+    for (size_t i = nodeCount;  i--;) {
+        std::string p = prefix(i);
+        shader << "  t = " << p << "map2tex.xy + " << p << "map2tex.zw * "
+               << p << "map(" << p << "rel2map.xy + t * " << p << "rel2map.zw);\n";
+    }
+    shader << "  gips_frag = textureLod(gips_tex, t, 0.0);\n"
+           << monoOutputCode << "}\n";
+
+    // compile shader and link program
+    fs.compile(GL_FRAGMENT_SHADER, shader.str().c_str());
+    if (!fs.good()) {
+        #ifndef NDEBUG
+            fprintf(stderr, "composing map() functions failed:\n%s\n", fs.getLog());
+        #endif
+        return false;
+    }
+    chain.program.link(m_vs, fs);
+    fs.free();
+    if (!chain.program.good()) { return false; }
+
+    // get uniform locations; the output pixel position is passed through
+    // as a plain texture coordinate
+    chain.program.use();
+    glUniform4f(chain.program.getUniformLocation("gips_pos2ndc"), -1.0f, -1.0f, 2.0f, 2.0f);
+    glUniform4f(chain.program.getUniformLocation("gips_rel2map"), 0.0f, 0.0f, 1.0f, 1.0f);
+    chain.locImageSize = chain.program.getUniformLocation("gips_image_size");
+    chain.locMono = chain.program.getUniformLocation("gips_mono");
+    chain.locTileOffset = chain.program.getUniformLocation("gips_tile_offset");
+    for (size_t i = 0;  i < nodeCount;  ++i) {
+        const Node& node = *chain.nodes[i];
+        chain.locRel2Map.push_back(chain.program.getUniformLocation((prefix(i) + "rel2map").c_str()));
+        chain.locMap2Tex.push_back(chain.program.getUniformLocation((prefix(i) + "map2tex").c_str()));
+        for (const auto& param : node.m_params) {
+            chain.locParams.push_back(chain.program.getUniformLocation((prefix(i) + param.m_name).c_str()));
+        }
+    }
+    glUseProgram(0);
+    GLutil::checkError("map chain setup");
+    #ifndef NDEBUG
+        fprintf(stderr, "composed %d map() nodes into a single pass\n", int(nodeCount));
+    #endif
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
 }  // namespace GIPS
@@ -0,0 +1,470 @@
+// SPDX-FileCopyrightText: 2021 Martin J. Fiedler <keyj@emphy.de>
+// SPDX-License-Identifier: MIT
+
+#include <cstdio>
+#include <cmath>
+
+#include <algorithm>
+#include <vector>
+#include <chrono>
+
+#include "gl_header.h"
+#include "gl_util.h"
+
+#include "gips_tileview.h"
+
+namespace GIPS {
+
+///////////////////////////////////////////////////////////////////////////////
+
+constexpr int TilePayload = 254;   //!< image pixels per tile and axis
+constexpr int SlotSize = 256;      //!< tile size in the atlas, including a 1-pixel border
+constexpr int MaxAtlasSize = 4096;
+constexpr int MaxSourceSize = 4096;  //!< largest full-resolution region read for a single tile
+constexpr int MaxPages = 64;       //!< maximum page table size (= visible tiles per axis)
+constexpr float FrameBudget_ms = 25.0f;  //!< time to spend on rendering tiles per frame
+constexpr uint8_t NoTile = 255;    //!< page table marker: use the interactive result
+
+//! tile source for the downscaled pyramid levels: reads the corresponding
+//! full-resolution region and resamples it on the GPU
+class LevelTileIO : public TileIO {
+    TileIO& m_io;
+    Resampler& m_resampler;
+    ResampleFilter m_filter;
+    GLuint m_srcTex;
+    int m_level, m_width, m_height;
+public:
+    LevelTileIO(TileIO& io, Resampler& resampler, ResampleFilter filter, GLuint srcTex, int level, int width, int height)
+        : m_io(io), m_resampler(resampler), m_filter(filter), m_srcTex(srcTex), m_level(level), m_width(width), m_height(height) {}
+    PixelFormat sourceFormat() const override { return m_io.sourceFormat(); }
+    bool readSource(GLuint tex, int x, int y, int width, int height) override {
+        int sx0 = x << m_level,  sx1 = std::min((x + width)  << m_level, m_width);
+        int sy0 = y << m_level,  sy1 = std::min((y + height) << m_level, m_height);
+        // the full-resolution region is kept in the source's own precision
+        GLint glfmt;
+        switch (m_io.sourceFormat()) {
+            case PixelFormat::Int16:   glfmt = GL_RGBA16;  break;
+            case PixelFormat::Float16: glfmt = GL_RGBA16F; break;
+            case PixelFormat::Float32: glfmt = GL_RGBA32F; break;
+            default:                   glfmt = GL_RGBA8;   break;
+        }
+        GLutil::clearError();
+        glBindTexture(GL_TEXTURE_2D, m_srcTex);
+        glTexImage2D(GL_TEXTURE_2D, 0, glfmt, sx1 - sx0, sy1 - sy0, 0, GL_RGBA, GL_FLOAT, nullptr);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        if (GLutil::checkError("tile view source allocation")) { return false; }
+        return m_io.readSource(m_srcTex, sx0, sy0, sx1 - sx0, sy1 - sy0)
+            && m_resampler.resampleTexture(m_srcTex, sx1 - sx0, sy1 - sy0, tex, width, height, m_filter);
+    }
+    bool writeResult(GLuint, PixelFormat, int, int, int, int, int, int) override { return false; }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool TileViewer::init(const GLutil::Shader& vs, int maxTextureSize) {
+    // the display shader finds the tile for each pixel in the page table;
+    // if it isn't resident, a coarser tile or the interactive result is used
+    GLutil::Shader fs(GL_FRAGMENT_SHADER,
+         "#version 330 core"
+    "\n" "uniform sampler2D gips_tex;      // tile atlas"
+    "\n" "uniform sampler2D vt_base;       // interactive result"
+    "\n" "uniform usampler2D vt_pages;     // (slot x, slot y, level delta, -)"
+    "\n" "uniform vec2  vt_imageSize;      // full-resolution image size"
+    "\n" "uniform float vt_scale;          // full-resolution pixels per level pixel"
+    "\n" "uniform ivec2 vt_pageOrigin;     // tile index of the first page table entry"
+    "\n" "uniform vec2  vt_atlasSize;"
+    "\n" "uniform float vt_alpha;"
+    "\n" "uniform float gips_encode;"
+    "\n" "in vec2 gips_pos;"
+    "\n" "out vec4 gips_frag;"
+    "\n" "const float payload = 254.0;"
+    "\n" "vec4 encode(vec4 c) {"
+    "\n" "  if (gips_encode < 0.5) { return c; }"
+    "\n" "  vec3 e = mix(12.92 * c.rgb, 1.055 * pow(c.rgb, vec3(1.0 / 2.4)) - 0.055, step(0.0031308, c.rgb));"
+    "\n" "  return vec4(e, c.a);"
+    "\n" "}"
+    "\n" "void main() {"
+    "\n" "  vec2 p = clamp(gips_pos, vec2(0.0), vec2(1.0)) * vt_imageSize;"
+    "\n" "  ivec2 page = clamp(ivec2(floor(p / (vt_scale * payload))) - vt_pageOrigin, ivec2(0), textureSize(vt_pages, 0) - 1);"
+    "\n" "  uvec4 e = texelFetch(vt_pages, page, 0);"
+    "\n" "  vec4 color;"
+    "\n" "  if (e.z == 255u) {"
+    "\n" "    color = texture(vt_base, gips_pos);"
+    "\n" "  } else {"
+    "\n" "    float s = vt_scale * exp2(float(e.z));"
+    "\n" "    vec2 q = clamp(p / s, vec2(0.5), ceil(vt_imageSize / s) - 0.5);"
+    "\n" "    vec2 tile = floor(vec2(page + vt_pageOrigin) / exp2(float(e.z)));"
+    "\n" "    vec2 a = vec2(e.xy) * 256.0 + 1.0 + (q - tile * payload);"
+    "\n" "    color = texture(gips_tex, a / vt_atlasSize);"
+    "\n" "  }"
+    "\n" "  color = encode(color);"
+    "\n" "  if (vt_alpha > 0.5) {"
+    "\n" "    vec2 cb = mod(floor(gl_FragCoord.xy * 0.125), 2.0);"
+    "\n" "    gips_frag = vec4(mix(vec3(0.5 + 0.25 * abs(cb.x - cb.y)), color.rgb, color.a), 1.0);"
+    "\n" "  } else {"
+    "\n" "    gips_frag = color;"
+    "\n" "  }"
+    "\n" "}"
+    "\n");
+    if (!fs.good()) {
+        fprintf(stderr, "failed to compile the tile view fragment shader:\n%s\n", fs.getLog());
+        return false;
+    }
+    if (!m_prog.link(vs, fs)) {
+        fprintf(stderr, "failed to link the tile view shader program:\n%s\n", m_prog.getLog());
+        return false;
+    }
+    fs.free();
+
+    // copying rendered tiles into the atlas is done by drawing, as the
+    // result may have any format (including single-channel and sRGB)
+    GLutil::Shader copyFS(GL_FRAGMENT_SHADER,
+         "#version 330 core"
+    "\n" "uniform sampler2D gips_tex;"
+    "\n" "uniform ivec2 vt_offset;"
+    "\n" "out vec4 gips_frag;"
+    "\n" "void main() {"
+    "\n" "  gips_frag = texelFetch(gips_tex, ivec2(gl_FragCoord.xy) + vt_offset, 0);"
+    "\n" "}"
+    "\n");
+    if (!copyFS.good() || !m_copyProg.link(vs, copyFS)) {
+        fprintf(stderr, "failed to build the tile copy shader program:\n%s%s\n", copyFS.getLog(), m_copyProg.getLog());
+        return false;
+    }
+    copyFS.free();
+
+    m_prog.use();
+    m_locPos2ndc    = m_prog.getUniformLocation("gips_pos2ndc");
+    m_locImageSize  = m_prog.getUniformLocation("vt_imageSize");
+    m_locLevelScale = m_prog.getUniformLocation("vt_scale");
+    m_locPageOrigin = m_prog.getUniformLocation("vt_pageOrigin");
+    m_locAtlasSize  = m_prog.getUniformLocation("vt_atlasSize");
+    m_locEncode     = m_prog.getUniformLocation("gips_encode");
+    m_locAlpha      = m_prog.getUniformLocation("vt_alpha");
+    glUniform4f(m_prog.getUniformLocation("gips_rel2map"), 0.0f, 0.0f, 1.0f, 1.0f);
+    glUniform1i(m_prog.getUniformLocation("gips_tex"), 0);
+    glUniform1i(m_prog.getUniformLocation("vt_base"), 1);
+    glUniform1i(m_prog.getUniformLocation("vt_pages"), 2);
+    m_copyProg.use();
+    m_locCopyOffset = m_copyProg.getUniformLocation("vt_offset");
+    glUniform4f(m_copyProg.getUniformLocation("gips_pos2ndc"), -1.0f, -1.0f, 2.0f, 2.0f);
+    glUniform4f(m_copyProg.getUniformLocation("gips_rel2map"), 0.0f, 0.0f, 1.0f, 1.0f);
+    glUseProgram(0);
+
+    m_fbo.init();
+    GLuint tex[3];
+    glGenTextures(3, tex);
+    m_atlasTex = tex[0];
+    m_pageTex  = tex[1];
+    m_srcTex   = tex[2];
+    for (int i = 0;  i < 3;  ++i) {
+        glBindTexture(GL_TEXTURE_2D, tex[i]);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    m_atlasSlots = std::min(maxTextureSize, MaxAtlasSize) / SlotSize;
+    m_maxSourceSize = std::min(maxTextureSize, MaxSourceSize);
+    m_slots.assign(size_t(m_atlasSlots) * size_t(m_atlasSlots), Slot());
+    return !GLutil::checkError("tile view initialization");
+}
+
+void TileViewer::free() {
+    if (GLutil::initialized) {
+        if (m_atlasTex) { glDeleteTextures(1, &m_atlasTex); }
+        if (m_pageTex)  { glDeleteTextures(1, &m_pageTex); }
+        if (m_srcTex)   { glDeleteTextures(1, &m_srcTex); }
+    }
+    m_atlasTex = m_pageTex = m_srcTex = 0;
+    m_atlasFormat = PixelFormat::DontCare;
+    m_fbo.free();
+    m_prog.free();
+    m_copyProg.free();
+    m_slots.clear();
+    m_resident.clear();
+    m_io = nullptr;
+}
+
+void TileViewer::setSource(TileIO* io, int width, int height, int baseWidth, int baseHeight) {
+    m_io = ((width > 0) && (height > 0)) ? io : nullptr;
+    m_width = width;
+    m_height = height;
+    m_baseWidth = baseWidth;
+    m_baseHeight = baseHeight;
+    invalidate();
+}
+
+void TileViewer::invalidate() {
+    for (auto& slot : m_slots) { slot.level = -1; }
+    m_resident.clear();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int TileViewer::findSlot(int level, int tx, int ty) const {
+    auto it = m_resident.find(tileKey(level, tx, ty));
+    return (it != m_resident.end()) ? it->second : -1;
+}
+
+int TileViewer::allocateSlot() {
+    // take an unused slot, or evict the least recently used tile; tiles
+    // that are visible in the current frame are never evicted
+    int best = -1;
+    for (int i = 0;  i < int(m_slots.size());  ++i) {
+        const Slot& slot = m_slots[size_t(i)];
+        if (slot.level < 0) { return i; }
+        if ((slot.lastUsed != m_frame) && ((best < 0) || (slot.lastUsed < m_slots[size_t(best)].lastUsed))) { best = i; }
+    }
+    if (best >= 0) {
+        Slot& slot = m_slots[size_t(best)];
+        m_resident.erase(tileKey(slot.level, slot.tx, slot.ty));
+        slot.level = -1;
+    }
+    return best;
+}
+
+bool TileViewer::setAtlasFormat(PixelFormat format) {
+    if (format == m_atlasFormat) { return true; }
+    invalidate();
+    GLint glfmt = (format == PixelFormat::SRGB8)   ? GL_SRGB8_ALPHA8
+                : (format == PixelFormat::Float16) ? GL_RGBA16F : GL_RGBA8;
+    int size = m_atlasSlots * SlotSize;
+    GLutil::clearError();
+    glBindTexture(GL_TEXTURE_2D, m_atlasTex);
+    glTexImage2D(GL_TEXTURE_2D, 0, glfmt, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    if (GLutil::checkError("tile atlas allocation")) {
+        m_atlasFormat = PixelFormat::DontCare;
+        return false;
+    }
+    #ifndef NDEBUG
+        fprintf(stderr, "tile view: %dx%d atlas (%d tiles), %s\n", size, size, int(m_slots.size()), pixelFormatName(format));
+    #endif
+    m_atlasFormat = format;
+    return true;
+}
+
+bool TileViewer::renderTile(Pipeline& pipeline, Resampler& resampler,
+                            PixelFormat format, int showIndex, int level, int tx, int ty) {
+    int slotIndex = allocateSlot();
+    if (slotIndex < 0) { return false; }
+
+    // the region to render contains the tile, its border and the halo;
+    // it has the same size for all tiles of a level (it's shifted inwards
+    // at the edges), so the pipeline doesn't need to re-allocate anything
+    const int halo = pipeline.tileHalo(showIndex);
+    const int lw = levelWidth(level), lh = levelHeight(level);
+    const int px0 = tx * TilePayload - 1, py0 = ty * TilePayload - 1;  // slot origin in level pixels
+    const int rw = std::min(SlotSize + 2 * halo, lw);
+    const int rh = std::min(SlotSize + 2 * halo, lh);
+    const int rx0 = std::max(0, std::min(px0 - halo, lw - rw));
+    const int ry0 = std::max(0, std::min(py0 - halo, lh - rh));
+    PixelFormat resultFormat;
+    GLuint result;
+    if (level > 0) {
+        LevelTileIO io(*m_io, resampler, m_filter, m_srcTex, level, m_width, m_height);
+        result = pipeline.renderTile(io, rx0, ry0, rw, rh, lw, lh, resultFormat, format, showIndex);
+    } else {
+        result = pipeline.renderTile(*m_io, rx0, ry0, rw, rh, lw, lh, resultFormat, format, showIndex);
+    }
+    if (!result) { return false; }
+
+    // copy the part that's covered by the slot into the atlas
+    int sx = (slotIndex % m_atlasSlots) * SlotSize;
+    int sy = (slotIndex / m_atlasSlots) * SlotSize;
+    int cx0 = std::max(rx0, px0), cx1 = std::min(rx0 + rw, px0 + SlotSize);
+    int cy0 = std::max(ry0, py0), cy1 = std::min(ry0 + rh, py0 + SlotSize);
+    GLutil::clearError();
+    if (!m_fbo.begin(m_atlasTex)) { return false; }
+    if (m_atlasFormat == PixelFormat::SRGB8) { glEnable(GL_FRAMEBUFFER_SRGB); }
+    glViewport(sx + cx0 - px0, sy + cy0 - py0, cx1 - cx0, cy1 - cy0);
+    m_copyProg.use();
+    glUniform2i(m_locCopyOffset, px0 - rx0 - sx, py0 - ry0 - sy);
+    glBindTexture(GL_TEXTURE_2D, result);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glUseProgram(0);
+    glDisable(GL_FRAMEBUFFER_SRGB);
+    m_fbo.end();
+    if (GLutil::checkError("tile copy")) { return false; }
+
+    Slot& slot = m_slots[size_t(slotIndex)];
+    slot.level = level;
+    slot.tx = tx;
+    slot.ty = ty;
+    slot.lastUsed = m_frame;
+    m_resident[tileKey(level, tx, ty)] = slotIndex;
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool TileViewer::update(Pipeline& pipeline, Resampler& resampler, ResampleFilter filter,
+                        PixelFormat format, int showIndex,
+                        int screenWidth, int screenHeight, int x0, int y0, float zoom) {
+    m_busy = false;
+    m_lastRenderCount = 0;
+    m_level = -1;
+    m_visible = false;
+    if (!good() || !m_io || (m_baseWidth < 1) || (m_baseHeight < 1) || (zoom <= 0.0f)) { return false; }
+
+    // select the pyramid level: the coarsest one that's still at least as
+    // detailed as the screen; if that's not more detailed than the
+    // interactive result, there's nothing to gain
+    const float fullZoom = zoom * float(m_baseWidth) / float(m_width);  // screen pixels per source pixel
+    const float ratio = float(m_width) / float(m_baseWidth);
+    int level = std::max(0, int(std::ceil(std::log2(1.0f / fullZoom) - 1e-3f)));
+    if (float(1 << level) >= ratio) { return false; }
+    int halo = pipeline.tileHalo(showIndex);
+    if (halo < 0) { return false; }  // pipeline can't be processed in tiles
+    if ((std::min(SlotSize + 2 * halo, levelWidth(level))  << level) > m_maxSourceSize
+    ||  (std::min(SlotSize + 2 * halo, levelHeight(level)) << level) > m_maxSourceSize) {
+        return false;  // downscaled region wouldn't fit into a texture
+    }
+    m_level = level;
+    if (filter != m_filter) {
+        invalidate();  // downscaled levels look different now
+        m_filter = filter;
+    }
+
+    // the atlas format follows the precision of the interactive result
+    PixelFormat baseFormat = pipeline.resultFormat();
+    if (!setAtlasFormat((baseFormat == PixelFormat::SRGB8) ? PixelFormat::SRGB8
+                      : isHighPrecision(baseFormat) ? PixelFormat::Float16 : PixelFormat::Int8)) { return false; }
+    m_encode = (baseFormat == PixelFormat::SRGB8);
+    ++m_frame;
+
+    // determine the visible tiles
+    const float levelZoom = fullZoom * float(1 << level);  // screen pixels per level pixel
+    const float tileSpan = levelZoom * float(TilePayload);
+    const int tilesX = (levelWidth(level)  + TilePayload - 1) / TilePayload;
+    const int tilesY = (levelHeight(level) + TilePayload - 1) / TilePayload;
+    int tx0 = std::max(0,          int(std::floor(float(-x0) / tileSpan)));
+    int ty0 = std::max(0,          int(std::floor(float(-y0) / tileSpan)));
+    int tx1 = std::min(tilesX - 1, int(std::floor(float(screenWidth  - x0) / tileSpan)));
+    int ty1 = std::min(tilesY - 1, int(std::floor(float(screenHeight - y0) / tileSpan)));
+    if ((tx1 < tx0) || (ty1 < ty0)) { return true; }  // nothing visible
+    tx1 = std::min(tx1, tx0 + MaxPages - 1);
+    ty1 = std::min(ty1, ty0 + MaxPages - 1);
+    const int pagesX = tx1 - tx0 + 1, pagesY = ty1 - ty0 + 1;
+
+    // mark resident tiles as used, and render missing ones, starting
+    // at the center of the screen, until the time budget is exhausted
+    struct Missing { int tx, ty; float dist; };
+    std::vector<Missing> missing;
+    float cx = (float(screenWidth)  * 0.5f - float(x0)) / tileSpan - 0.5f;
+    float cy = (float(screenHeight) * 0.5f - float(y0)) / tileSpan - 0.5f;
+    for (int ty = ty0;  ty <= ty1;  ++ty) {
+        for (int tx = tx0;  tx <= tx1;  ++tx) {
+            int slot = findSlot(level, tx, ty);
+            if (slot >= 0) {
+                m_slots[size_t(slot)].lastUsed = m_frame;
+            } else {
+                missing.push_back({ tx, ty, (float(tx) - cx) * (float(tx) - cx) + (float(ty) - cy) * (float(ty) - cy) });
+            }
+        }
+    }
+    std::sort(missing.begin(), missing.end(), [] (const Missing& a, const Missing& b) { return a.dist < b.dist; });
+    auto t0 = std::chrono::high_resolution_clock::now();
+    bool failed = false;
+    for (const auto& m : missing) {
+        if (m_lastRenderCount
+        && (std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - t0).count() > FrameBudget_ms)) {
+            break;
+        }
+        if (!renderTile(pipeline, resampler, format, showIndex, level, m.tx, m.ty)) { failed = true;  break; }
+        ++m_lastRenderCount;
+    }
+    m_busy = !failed && (m_lastRenderCount < int(missing.size()));
+    #ifndef NDEBUG
+        if (m_lastRenderCount) {
+            fprintf(stderr, "tile view: level %d, %dx%d tiles visible, %d rendered, %d missing\n",
+                    level, pagesX, pagesY, m_lastRenderCount, int(missing.size()) - m_lastRenderCount);
+        }
+    #endif
+
+    // build the page table; tiles that are still missing are substituted
+    // by coarser tiles if there are any, or by the interactive result
+    std::vector<uint8_t> pages(size_t(pagesX) * size_t(pagesY) * 4u);
+    uint8_t* entry = pages.data();
+    for (int ty = ty0;  ty <= ty1;  ++ty) {
+        for (int tx = tx0;  tx <= tx1;  ++tx) {
+            int slot = -1, delta = 0;
+            for (int l = level;  (slot < 0) && (l < 16) && ((1 << l) < ratio);  ++l) {
+                delta = l - level;
+                slot = findSlot(l, tx >> delta, ty >> delta);
+            }
+            if (slot >= 0) {
+                m_slots[size_t(slot)].lastUsed = m_frame;
+                entry[0] = uint8_t(slot % m_atlasSlots);
+                entry[1] = uint8_t(slot / m_atlasSlots);
+                entry[2] = uint8_t(delta);
+            } else {
+                entry[0] = entry[1] = 0;
+                entry[2] = NoTile;
+            }
+            entry[3] = 0;
+            entry += 4;
+        }
+    }
+    GLutil::clearError();
+    glBindTexture(GL_TEXTURE_2D, m_pageTex);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8UI, pagesX, pagesY, 0, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, pages.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+    m_pageOriginX = tx0;
+    m_pageOriginY = ty0;
+    m_visible = !GLutil::checkError("page table upload");
+    return true;
+}
+
+void TileViewer::draw(int screenWidth, int screenHeight, int x0, int y0, float zoom, GLuint baseTex, bool showAlpha) {
+    if ((m_level < 0) || !m_visible) { return; }
+    const float fullZoom = zoom * float(m_baseWidth) / float(m_width);
+
+    // draw the whole image with the page table shader
+    GLutil::clearError();
+    glViewport(0, 0, screenWidth, screenHeight);
+    m_prog.use();
+    float scaleX =  2.0f / float(screenWidth);
+    float scaleY = -2.0f / float(screenHeight);
+    glUniform4f(m_locPos2ndc,
+        scaleX * float(x0) - 1.0f,
+        scaleY * float(y0) + 1.0f,
+        scaleX * zoom * float(m_baseWidth),
+        scaleY * zoom * float(m_baseHeight));
+    glUniform2f(m_locImageSize, float(m_width), float(m_height));
+    glUniform1f(m_locLevelScale, float(1 << m_level));
+    glUniform2i(m_locPageOrigin, m_pageOriginX, m_pageOriginY);
+    glUniform2f(m_locAtlasSize, float(m_atlasSlots * SlotSize), float(m_atlasSlots * SlotSize));
+    glUniform1f(m_locEncode, m_encode ? 1.0f : 0.0f);
+    glUniform1f(m_locAlpha, showAlpha ? 1.0f : 0.0f);
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_2D, m_pageTex);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, baseTex);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, m_atlasTex);
+    // pixel-exact display at 1:1 and above, like the interactive result
+    GLint texFilter = ((m_level == 0) && (fullZoom >= 1.0f)) ? GL_NEAREST : GL_LINEAR;
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, texFilter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, texFilter);
+    GLutil::checkError("tile view setup");
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    GLutil::checkError("tile view draw");
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glUseProgram(0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+}  // namespace GIPS
@@ -0,0 +1,122 @@
+// SPDX-FileCopyrightText: 2021 Martin J. Fiedler <keyj@emphy.de>
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <cstdint>
+
+#include <vector>
+#include <unordered_map>
+
+#include "gl_header.h"
+#include "gl_util.h"
+
+#include "gips_core.h"
+#include "gips_resample.h"
+
+namespace GIPS {
+
+//! virtual-texture display of the pipeline's result for a source image
+//! that's larger than the (downscaled) interactive one: when zooming in
+//! beyond the interactive image's resolution, the visible part of the
+//! result is computed on demand in tiles, at the pyramid level that fits
+//! the zoom factor, and kept in a fixed-size tile cache in video memory;
+//! a page table tells the display shader where to find each tile
+class TileViewer {
+    GLutil::Program m_prog;
+    GLutil::Program m_copyProg;
+    GLutil::FBO m_fbo;
+    GLint m_locPos2ndc = -1;
+    GLint m_locImageSize = -1;
+    GLint m_locLevelScale = -1;
+    GLint m_locPageOrigin = -1;
+    GLint m_locAtlasSize = -1;
+    GLint m_locEncode = -1;
+    GLint m_locAlpha = -1;
+    GLint m_locCopyOffset = -1;
+    GLuint m_atlasTex = 0;   //!< tile cache
+    GLuint m_pageTex = 0;    //!< page table for the visible tiles
+    GLuint m_srcTex = 0;     //!< full-resolution source region for downscaled levels
+    PixelFormat m_atlasFormat = PixelFormat::DontCare;
+    int m_atlasSlots = 0;    //!< tile slots per row and column
+    int m_maxSourceSize = 0;
+
+    // source image
+    TileIO* m_io = nullptr;
+    int m_width = 0;
+    int m_height = 0;
+    int m_baseWidth = 0;     //!< size of the interactive image
+    int m_baseHeight = 0;
+    ResampleFilter m_filter = ResampleFilter::Mitchell;  //!< filter used for the current tiles
+
+    // tile cache state
+    struct Slot {
+        int level = -1;      //!< -1 = unused
+        int tx = 0;
+        int ty = 0;
+        unsigned lastUsed = 0;
+    };
+    std::vector<Slot> m_slots;
+    std::unordered_map<uint64_t, int> m_resident;  //!< tile -> slot index
+    unsigned m_frame = 0;
+    int m_level = -1;        //!< pyramid level of the last update() call
+    bool m_visible = false;  //!< page table is valid and any tiles are visible
+    bool m_encode = false;   //!< tiles need to be sRGB-encoded for display
+    int m_pageOriginX = 0;   //!< tile index of the first page table entry
+    int m_pageOriginY = 0;
+    bool m_busy = false;
+    int m_lastRenderCount = 0;
+
+    static inline uint64_t tileKey(int level, int tx, int ty)
+        { return (uint64_t(level) << 48) | (uint64_t(uint32_t(ty)) << 24) | uint64_t(uint32_t(tx)); }
+    inline int levelWidth(int level)  const { return (m_width  + (1 << level) - 1) >> level; }
+    inline int levelHeight(int level) const { return (m_height + (1 << level) - 1) >> level; }
+    int findSlot(int level, int tx, int ty) const;
+    int allocateSlot();
+    bool setAtlasFormat(PixelFormat format);
+    bool renderTile(Pipeline& pipeline, Resampler& resampler,
+                    PixelFormat format, int showIndex, int level, int tx, int ty);
+
+public:
+    bool init(const GLutil::Shader& vs, int maxTextureSize);
+    inline bool good() const { return m_prog.good() && m_copyProg.good(); }
+
+    //! set the full-resolution source image
+    //! \param io          source of the image data (only readSource() is
+    //!                    used); must stay valid until the next call
+    //! \param baseWidth   size of the interactive (downscaled) image
+    void setSource(TileIO* io, int width, int height, int baseWidth, int baseHeight);
+    inline bool hasSource() const { return m_io != nullptr; }
+
+    //! discard all tiles, e.g. because the pipeline's result changed
+    void invalidate();
+
+    //! render missing tiles (within a time budget) and update the page table
+    //! \param x0, y0     screen position of the image's top-left corner
+    //! \param zoom       screen pixels per interactive image pixel
+    //! \returns false if the interactive result has enough resolution for
+    //!          the current zoom factor; in this case, draw() does nothing
+    bool update(Pipeline& pipeline, Resampler& resampler, ResampleFilter filter,
+                PixelFormat format, int showIndex,
+                int screenWidth, int screenHeight, int x0, int y0, float zoom);
+
+    //! draw the image into the current framebuffer, using the geometry
+    //! of the last update() call
+    //! \param baseTex    interactive result, used where tiles are missing
+    void draw(int screenWidth, int screenHeight, int x0, int y0, float zoom,
+              GLuint baseTex, bool showAlpha);
+
+    //! check whether visible tiles are still missing after the last update()
+    inline bool busy() const { return m_busy; }
+    inline int  level() const { return m_level; }
+    inline int  residentTiles() const { return int(m_resident.size()); }
+    inline int  lastRenderCount() const { return m_lastRenderCount; }
+
+    void free();
+    inline TileViewer() {}
+    TileViewer(const TileViewer&) = delete;
+    inline ~TileViewer() { free(); }
+};
+
+
+}  // namespace GIPS
@@ -19,6 +19,8 @@
 extern "C" const char* git_rev;
 extern "C" const char* git_branch;
 
+constexpr float ProgressDelay_ms = 250.0f;  //!< show progress for renders that take longer than this
+
 ///////////////////////////////////////////////////////////////////////////////
 
 struct StatusWindow {
@@ -144,6 +146,16 @@ static bool TreeNodeForGIPSNode(GIPS::App& app, int nodeIndex=0, GIPS::Node* nod
         if (ImGui::Selectable("restore defaults")) {
             node->reset();
         }
+        if (node->pointwise() && node->enabled() && ImGui::Selectable("bake color chain to LUT ...")) {
+            std::string path(pfd_save_file_wrapper("Save Baked 3D LUT", "",
+                             { "3D LUT Files (*.cube)", "*.cube", "All Files", "*" }));
+            if (!path.empty()) {
+                if (!StringUtil::extractExtCode(path.c_str())) {
+                    path += ".cube";  // add default extension
+                }
+                app.requestBakeLUT(nodeIndex, path.c_str());
+            }
+        }
         if (ImGui::Selectable("reload")) {
             app.requestReloadNode(nodeIndex);
         }
@@ -198,6 +210,17 @@ void GIPS::App::drawUI() {
         }
     }
 
+    // progress of long renders; while rendering, the UI is kept running
+    // to update the display (the render thread only wakes it up when done)
+    float progress = 0.0f, elapsed_ms = 0.0f;
+    if (m_renderThread.rendering(progress, elapsed_ms)) {
+        if (elapsed_ms >= ProgressDelay_ms) {
+            StatusWindow _("Processing", 1.0f, 0.0f);
+            ImGui::ProgressBar(progress, ImVec2(160.0f, 0.0f));
+        }
+        requestFrames(1);
+    }
+
     // status message
     if (m_statusVisible) {
         StatusWindow _(
@@ -259,9 +282,51 @@ void GIPS::App::drawUI() {
                         }
                     };
                     handlePixelFormat(GIPS::PixelFormat::Int8);
+                    handlePixelFormat(GIPS::PixelFormat::SRGB8);
+                    if (processingFormat() != m_requestedFormat) {
+                        ImGui::Text("  (not for %s images, using %s)", GIPS::pixelFormatName(m_imgFormat), GIPS::pixelFormatName(processingFormat()));
+                    }
+                    handlePixelFormat(GIPS::PixelFormat::RGB10A2);
                     handlePixelFormat(GIPS::PixelFormat::Int16);
+                    handlePixelFormat(GIPS::PixelFormat::RGB11F);
                     handlePixelFormat(GIPS::PixelFormat::Float16);
                     handlePixelFormat(GIPS::PixelFormat::Float32);
+                    ImGui::Separator();
+                    handlePixelFormat(GIPS::PixelFormat::Gray8);
+                    handlePixelFormat(GIPS::PixelFormat::Gray16F);
+                    ImGui::Separator();
+                    bool mixed = m_pipeline.mixedPrecision();
+                    if (ImGui::MenuItem("mixed precision (per filter)", nullptr, &mixed, (m_requestedFormat == GIPS::PixelFormat::DontCare))) {
+                        GIPS::RenderThread::Lock lock(m_renderThread);
+                        m_pipeline.setMixedPrecision(mixed);
+                    }
+                    ImGui::EndMenu();
+                }
+                if (ImGui::BeginMenu("Resampling Filter", m_resampler.good())) {
+                    auto handleFilter = [this] (GIPS::ResampleFilter filter) {
+                        bool sel = (m_resampleFilter == filter);
+                        if (ImGui::MenuItem(GIPS::resampleFilterName(filter), nullptr, &sel)) {
+                            m_resampleFilter = filter;
+                            if (m_imgSource == ImageSource::Image) { requestUpdateSource(); }
+                        }
+                    };
+                    handleFilter(GIPS::ResampleFilter::Mitchell);
+                    handleFilter(GIPS::ResampleFilter::Lanczos3);
+                    ImGui::EndMenu();
+                }
+                if (ImGui::BeginMenu("Export Size", m_resampler.good())) {
+                    static const int percentages[] = { 100, 75, 50, 33, 25 };
+                    for (int p : percentages) {
+                        bool sel = !m_exportFullRes && (m_exportPercent == p);
+                        if (ImGui::MenuItem((std::to_string(p) + "%").c_str(), nullptr, &sel)) {
+                            m_exportPercent = p;
+                            m_exportFullRes = false;
+                        }
+                    }
+                    ImGui::Separator();
+                    if (ImGui::MenuItem("Full Source Resolution (tiled)", nullptr, &m_exportFullRes)) {
+                        m_exportPercent = 100;
+                    }
                     ImGui::EndMenu();
                 }
                 ImGui::Separator();
@@ -361,6 +426,9 @@ void GIPS::App::drawUI() {
             }
 
             ImGui::Text("Current Size: %dx%d", m_imgWidth, m_imgHeight);
+            if (m_imgFormat != PixelFormat::Int8) {
+                ImGui::Text("Current Format: %s", GIPS::pixelFormatName(m_imgFormat));
+            }
             ImGui::TreePop();
         }
 
@@ -422,6 +490,13 @@ void GIPS::App::drawUI() {
                     ImGui::PopID();
                 }   // END parameter iteration
 
+                // bypass indicator
+                if (node.bypassed()) {
+                    ImGui::PushStyleColor(ImGuiCol_Text, 0xFF808080);
+                    ImGui::TextUnformatted("(bypassed: all parameters at identity values)");
+                    ImGui::PopStyleColor(1);
+                }
+
                 // error messages (if present)
                 if (node.errors()[0]) {
                     if (node.passCount()) {
@@ -495,22 +570,78 @@ void GIPS::App::drawUI() {
         ImGui::TextUnformatted(m_glVendor.c_str());
         ImGui::TextUnformatted(m_glRenderer.c_str());
         ImGui::Separator();
-        ImGui::Text("pipeline format: %dx%d, %s",
-            m_imgWidth, m_imgHeight, GIPS::pixelFormatName(m_pipeline.format()));
-        // video memory estimator:
-        // - 1x 8-bit RGBA input image buffer
-        // - 1x 8-bit RGBA export buffer (if not running in 8-bit mode)
-        // - 2x variable-format processing buffers
-        // - 2x 8-bit RGBA buffers for the display screen
-        uint64_t area = uint64_t(m_imgWidth * m_imgHeight);
-        uint64_t mem = area * 4ull  // input
-                     + 2ull * area * getBytesPerPixel(m_pipeline.format())  // processing
-                     + 2ull * uint64_t(m_io->DisplaySize.x * m_io->DisplaySize.y) * 4ull;  // display
-        if (m_pipeline.format() != GIPS::PixelFormat::Int8) {
-            mem += area * 4ull;  // export
+        // the pipeline's state can only be inspected while it isn't rendering
+        if (!m_renderThread.tryLock()) {
+            ImGui::TextUnformatted("processing ...");
+        } else {
+            ImGui::Text("pipeline format: %dx%d, %s%s",
+                m_imgWidth, m_imgHeight, GIPS::pixelFormatName(m_pipeline.format()),
+                m_pipeline.mixedPrecision() && (m_requestedFormat == GIPS::PixelFormat::DontCare) ? " (mixed)" : "");
+            if (processingFormat() != m_requestedFormat) {
+                ImGui::Text("(sRGB processing isn't possible for %s images)", GIPS::pixelFormatName(m_imgFormat));
+            }
+            // video memory estimator:
+            // - 1x variable-format input image buffer
+            // - 1x 8-bit RGBA export buffer (if not running in 8-bit mode)
+            // - 2x variable-format processing buffers, plus pooled buffers
+            // - 1x variable-format copy of the result for display
+            // - 3x 8-bit RGBA buffers for the display screen (including the cached view)
+            uint64_t area = uint64_t(m_imgWidth * m_imgHeight);
+            uint64_t mem = area * getBytesPerPixel(m_imgFormat)  // input
+                         + 2ull * area * getBytesPerPixel(m_pipeline.format())  // processing
+                         + m_pipeline.poolMemory()
+                         + area * getBytesPerPixel(m_resultFormat)  // result copy
+                         + 3ull * uint64_t(m_io->DisplaySize.x * m_io->DisplaySize.y) * 4ull;  // display
+            if (m_resultFormat != GIPS::PixelFormat::Int8) {
+                mem += area * 4ull;  // export
+            }
+            ImGui::Text("estimated video memory usage: %.1f MiB", double(mem) / 1048576.0);
+            ImGui::Text("processing time: %.1f ms", m_pipeline.lastRenderTime_ms());
+            if (m_pipeline.lastBypassCount() > 0) {
+                ImGui::Text("bypassed nodes: %d", m_pipeline.lastBypassCount());
+            }
+            if (m_pipeline.lastSkipCount() > 0) {
+                ImGui::Text("skipped upstream nodes: %d", m_pipeline.lastSkipCount());
+            }
+            if (m_pipeline.poolSize() > 0) {
+                ImGui::Text("pooled intermediate buffers: %d", m_pipeline.poolSize());
+            }
+            if (m_pipeline.lastComposedCount() > 0) {
+                ImGui::Text("composed map() nodes: %d", m_pipeline.lastComposedCount());
+            }
+            if (m_pipeline.lastTileCount() > 0) {
+                ImGui::Text("rendered in tiles (out of video memory): %d", m_pipeline.lastTileCount());
+            }
+            if (m_pipeline.tilingError()) {
+                ImGui::Text("out of video memory, and %s", m_pipeline.tilingError());
+            }
+            if (m_tileView.level() >= 0) {
+                ImGui::Text("full-resolution view: 1:%d, %d cached tiles", 1 << m_tileView.level(), m_tileView.residentTiles());
+            }
+            m_renderThread.unlock();
+        }
+        if (m_showDebug) {
+            // input-to-photon latency of interactive edits
+            ImGui::Separator();
+            GIPS::LatencyTracker::Stats stats;
+            m_latency.getStats(stats);
+            if (!stats.count) {
+                ImGui::TextUnformatted("input latency: no edits yet");
+            } else {
+                ImGui::Text("input latency (last %d edits):", stats.count);
+                ImGui::Text("p50 %.1f ms, p95 %.1f ms, p99 %.1f ms", stats.p50_ms, stats.p95_ms, stats.p99_ms);
+                const auto* last = m_latency.lastSample();
+                ImGui::Text("last: %.1f ms = %.1f input + %.1f render + %.1f present",
+                    last->total_ms(), last->change_ms, last->render_ms, last->present_ms);
+                float hist[GIPS::LatencyTracker::HistogramBins];
+                for (int i = 0;  i < GIPS::LatencyTracker::HistogramBins;  ++i) {
+                    hist[i] = float(stats.histogram[i]);
+                }
+                ImGui::PlotHistogram("##latency", hist, GIPS::LatencyTracker::HistogramBins, 0,
+                    nullptr, 0.0f, FLT_MAX, ImVec2(0.0f, 48.0f));
+                ImGui::TextUnformatted("bins: <8, <17, <33, <50, <100, <250, <1000, more ms");
+            }
         }
-        ImGui::Text("estimated video memory usage: %.1f MiB", double(mem) / 1048576.0);
-        ImGui::Text("processing time: %.1f ms", m_pipeline.lastRenderTime_ms());
         ImGui::End();
     }   // END info window
 }
@@ -520,8 +651,8 @@ void GIPS::App::drawUI() {
 void GIPS::App::showLoadUI(bool imagesOnly) {
     std::vector<std::string> filters;
     static const std::string extP("*gips");
-    static const std::string extI("*.jpg *.jpeg *.png *.bmp *.tga *.pgm *.ppm *.gif *.psd");
-    static const std::string extS("*.glsl *.frag *.fs");
+    static const std::string extI("*.jpg *.jpeg *.png *.bmp *.tga *.pgm *.ppm *.pam *.pfm *.hdr *.qoi *.gif *.psd");
+    static const std::string extS("*.glsl *.frag *.fs *.cube");
     if (!imagesOnly) {
         filters.push_back("All Supported Files");
         filters.push_back(extP + " " + extI + " " + extS);
@@ -550,7 +681,7 @@ void GIPS::App::showSaveUI(bool useLastPath) {
         pfd_save_file_wrapper(
             "Save Pipeline or Result Image", m_lastSaveFilename,
             { "GIPS Pipelines (*.gips)", "*.gips",
-            "Image Files (*.jpg *.png *.bmp *.tga)", "*.jpg *.png *.bmp *.tga",
+            "Image Files (*.jpg *.png *.bmp *.tga *.qoi *.tif *.pam *.pfm *.hdr)", "*.jpg *.png *.bmp *.tga *.qoi *.tif *.tiff *.pam *.pfm *.hdr",
             "All Files", "*" }
         ));
     if (!path.empty()) {
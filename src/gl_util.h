@@ -62,6 +62,10 @@ public:
     inline GLint getUniformLocation(const char* name) const { return initialized ? glGetUniformLocation(id, name) : -1; }
     inline Program() {}
     inline Program(GLuint vs, GLuint fs) { link(vs, fs); }
+    Program(const Program&) = delete;
+    inline Program(Program&& other) noexcept
+        : logAlloc(other.logAlloc), id(other.id), log(other.log), ok(other.ok)
+        { other.logAlloc = 0; other.id = 0; other.log = nullptr; other.ok = false; }
     inline ~Program() { free(); }
     inline operator GLuint() const { return id; }
 };
@@ -0,0 +1,1375 @@
+// SPDX-FileCopyrightText: 2021 Martin J. Fiedler <keyj@emphy.de>
+// SPDX-License-Identifier: MIT
+
+#ifdef _MSC_VER
+    #define _CRT_SECURE_NO_WARNINGS  // prevent MSVC warnings
+#endif
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+
+#include <algorithm>
+#include <vector>
+
+#include "image_util.h"
+
+// stb_image_write's deflate implementation is exported, but not declared
+// in the header; it returns a malloc'd zlib stream
+extern "C" unsigned char* stbi_zlib_compress(unsigned char* data, int data_len, int* out_len, int quality);
+
+namespace ImageUtil {
+
+///////////////////////////////////////////////////////////////////////////////
+
+static inline bool isLittleEndian() {
+    const uint16_t probe = 1;
+    return (*reinterpret_cast<const uint8_t*>(&probe) == 1);
+}
+
+static uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc=0) {
+    static uint32_t table[256] = { 0, };
+    if (!table[1]) {
+        for (uint32_t i = 0;  i < 256;  ++i) {
+            uint32_t c = i;
+            for (int k = 0;  k < 8;  ++k) { c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1); }
+            table[i] = c;
+        }
+    }
+    crc = ~crc;
+    while (size--) { crc = table[(crc ^ *data++) & 0xFF] ^ (crc >> 8); }
+    return ~crc;
+}
+
+static inline void putBE32(uint8_t* p, uint32_t x) {
+    p[0] = uint8_t(x >> 24);  p[1] = uint8_t(x >> 16);  p[2] = uint8_t(x >> 8);  p[3] = uint8_t(x);
+}
+
+static bool writeChunk(FILE* f, const char* type, const uint8_t* data, size_t size) {
+    uint8_t header[8], crc[4];
+    putBE32(header, uint32_t(size));
+    memcpy(&header[4], type, 4);
+    putBE32(crc, crc32(data, size, crc32(&header[4], 4)));
+    return (fwrite(header, 8, 1, f) == 1)
+        && (!size || (fwrite(data, size, 1, f) == 1))
+        && (fwrite(crc, 4, 1, f) == 1);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool writePNG16(const char* filename, int width, int height, const uint16_t* data) {
+    if (!filename || !data || (width < 1) || (height < 1)) { return false; }
+
+    // serialize into big-endian scanlines, each with a 'Sub' filter
+    // (difference to the previous pixel), which compresses much better
+    // than no filter at all for photographic content
+    const size_t stride = size_t(width) * 8u + 1u;
+    std::vector<uint8_t> raw(stride * size_t(height));
+    for (int y = 0;  y < height;  ++y) {
+        uint8_t* line = &raw[size_t(y) * stride];
+        const uint16_t* src = &data[size_t(y) * size_t(width) * 4u];
+        *line++ = 1;  // filter type: Sub
+        uint16_t prev[4] = { 0, 0, 0, 0 };
+        for (int x = 0;  x < width;  ++x) {
+            for (int c = 0;  c < 4;  ++c) {
+                uint16_t s = *src++;
+                *line++ = uint8_t((s >> 8) - (prev[c] >> 8));
+                *line++ = uint8_t((s & 0xFF) - (prev[c] & 0xFF));
+                prev[c] = s;
+            }
+        }
+    }
+    int zsize = 0;
+    uint8_t* zdata = stbi_zlib_compress(raw.data(), int(raw.size()), &zsize, 8);
+    if (!zdata) { return false; }
+
+    uint8_t ihdr[13];
+    putBE32(&ihdr[0], uint32_t(width));
+    putBE32(&ihdr[4], uint32_t(height));
+    ihdr[8]  = 16;  // bit depth
+    ihdr[9]  = 6;   // color type: RGBA
+    ihdr[10] = 0;   // compression: deflate
+    ihdr[11] = 0;   // filter method: adaptive
+    ihdr[12] = 0;   // no interlacing
+
+    bool ok = false;
+    FILE* f = fopen(filename, "wb");
+    if (f) {
+        static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+        ok = (fwrite(signature, 8, 1, f) == 1)
+          && writeChunk(f, "IHDR", ihdr, sizeof(ihdr))
+          && writeChunk(f, "IDAT", zdata, size_t(zsize))
+          && writeChunk(f, "IEND", nullptr, 0);
+        ok = (fclose(f) == 0) && ok;
+    }
+    ::free(zdata);
+    return ok;
+}
+
+bool writePAM16(const char* filename, int width, int height, const uint16_t* data) {
+    if (!filename || !data || (width < 1) || (height < 1)) { return false; }
+    FILE* f = fopen(filename, "wb");
+    if (!f) { return false; }
+    fprintf(f, "P7\nWIDTH %d\nHEIGHT %d\nDEPTH 4\nMAXVAL 65535\nTUPLTYPE RGB_ALPHA\nENDHDR\n", width, height);
+    const size_t count = size_t(width) * size_t(height) * 4u;
+    bool ok = true;
+    if (isLittleEndian()) {
+        // PAM samples are big-endian; convert line by line
+        std::vector<uint16_t> line(size_t(width) * 4u);
+        for (int y = 0;  ok && (y < height);  ++y) {
+            const uint16_t* src = &data[size_t(y) * line.size()];
+            for (size_t i = 0;  i < line.size();  ++i) {
+                line[i] = uint16_t((src[i] >> 8) | (src[i] << 8));
+            }
+            ok = (fwrite(line.data(), line.size() * 2u, 1, f) == 1);
+        }
+    } else {
+        ok = (fwrite(data, count * 2u, 1, f) == 1);
+    }
+    return (fclose(f) == 0) && ok;
+}
+
+bool writePFM(const char* filename, int width, int height, const float* data) {
+    if (!filename || !data || (width < 1) || (height < 1)) { return false; }
+    FILE* f = fopen(filename, "wb");
+    if (!f) { return false; }
+    // the sign of the scale factor signals the byte order
+    fprintf(f, "PF\n%d %d\n%s\n", width, height, isLittleEndian() ? "-1.0" : "1.0");
+    std::vector<float> line(size_t(width) * 3u);
+    bool ok = true;
+    for (int y = height - 1;  ok && (y >= 0);  --y) {  // PFM is stored bottom-up
+        const float* src = &data[size_t(y) * size_t(width) * 4u];
+        float* dest = line.data();
+        for (int x = 0;  x < width;  ++x) {
+            *dest++ = *src++;
+            *dest++ = *src++;
+            *dest++ = *src++;
+            ++src;
+        }
+        ok = (fwrite(line.data(), line.size() * sizeof(float), 1, f) == 1);
+    }
+    return (fclose(f) == 0) && ok;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace QOI {
+    constexpr uint8_t OpIndex = 0x00;
+    constexpr uint8_t OpDiff  = 0x40;
+    constexpr uint8_t OpLuma  = 0x80;
+    constexpr uint8_t OpRun   = 0xC0;
+    constexpr uint8_t OpRGB   = 0xFE;
+    constexpr uint8_t OpRGBA  = 0xFF;
+    constexpr uint8_t OpMask  = 0xC0;
+    constexpr size_t HeaderSize = 14;
+    constexpr size_t PaddingSize = 8;
+    constexpr uint64_t MaxPixels = 400000000u;
+    static inline int hash(const uint8_t* px) {
+        return (px[0] * 3 + px[1] * 5 + px[2] * 7 + px[3] * 11) & 63;
+    }
+}
+
+//! sequential QOI decoder
+class QOIReader : public RowReader {
+    const uint8_t* m_data;
+    size_t m_pos = QOI::HeaderSize;
+    size_t m_end = 0;
+    int m_run = 0;
+    uint8_t m_px[4] = { 0, 0, 0, 255 };
+    uint8_t m_index[64][4];
+public:
+    QOIReader(const uint8_t* data, size_t size) : m_data(data) {
+        memset(m_index, 0, sizeof(m_index));
+        if (!data || (size < (QOI::HeaderSize + QOI::PaddingSize)) || memcmp(data, "qoif", 4)) { return; }
+        uint32_t w = (uint32_t(data[4]) << 24) | (uint32_t(data[5]) << 16) | (uint32_t(data[6]) << 8) | data[7];
+        uint32_t h = (uint32_t(data[8]) << 24) | (uint32_t(data[9]) << 16) | (uint32_t(data[10]) << 8) | data[11];
+        if (!w || !h || (w > 0x7FFFFFFFu) || (h > 0x7FFFFFFFu)
+        || (data[12] < 3) || (data[12] > 4)) { return; }
+        m_end = size - QOI::PaddingSize;
+        m_width = int(w);
+        m_height = int(h);
+    }
+
+    bool readRows(void* dest, int count) override {
+        if (!good() || (count < 0) || ((m_row + count) > m_height)) { return false; }
+        uint8_t* out = static_cast<uint8_t*>(dest);
+        const uint8_t* data = m_data;
+        for (size_t i = size_t(count) * size_t(m_width);  i;  --i) {
+            if (m_run > 0) {
+                --m_run;
+            } else if (m_pos < m_end) {
+                uint8_t b1 = data[m_pos++];
+                if (b1 == QOI::OpRGB) {
+                    if ((m_pos + 3) > m_end) { return false; }
+                    m_px[0] = data[m_pos++];  m_px[1] = data[m_pos++];  m_px[2] = data[m_pos++];
+                } else if (b1 == QOI::OpRGBA) {
+                    if ((m_pos + 4) > m_end) { return false; }
+                    m_px[0] = data[m_pos++];  m_px[1] = data[m_pos++];  m_px[2] = data[m_pos++];  m_px[3] = data[m_pos++];
+                } else if ((b1 & QOI::OpMask) == QOI::OpIndex) {
+                    memcpy(m_px, m_index[b1], 4);
+                } else if ((b1 & QOI::OpMask) == QOI::OpDiff) {
+                    m_px[0] = uint8_t(m_px[0] + ((b1 >> 4) & 3) - 2);
+                    m_px[1] = uint8_t(m_px[1] + ((b1 >> 2) & 3) - 2);
+                    m_px[2] = uint8_t(m_px[2] + ( b1       & 3) - 2);
+                } else if ((b1 & QOI::OpMask) == QOI::OpLuma) {
+                    if (m_pos >= m_end) { return false; }
+                    uint8_t b2 = data[m_pos++];
+                    int vg = (b1 & 0x3F) - 32;
+                    m_px[0] = uint8_t(m_px[0] + vg - 8 + ((b2 >> 4) & 0x0F));
+                    m_px[1] = uint8_t(m_px[1] + vg);
+                    m_px[2] = uint8_t(m_px[2] + vg - 8 + (b2 & 0x0F));
+                } else {  // OpRun
+                    m_run = b1 & 0x3F;
+                }
+                memcpy(m_index[QOI::hash(m_px)], m_px, 4);
+            }
+            memcpy(out, m_px, 4);
+            out += 4;
+        }
+        m_row += count;
+        return true;
+    }
+};
+
+uint8_t* decodeQOI(const uint8_t* data, size_t size, int& width, int& height) {
+    QOIReader reader(data, size);
+    if (!reader.good() || ((uint64_t(reader.width()) * uint64_t(reader.height())) > QOI::MaxPixels)) { return nullptr; }
+    uint8_t* image = static_cast<uint8_t*>(malloc(size_t(reader.height()) * reader.rowSize()));
+    if (!image) { return nullptr; }
+    if (!reader.readRows(image, reader.height())) { ::free(image); return nullptr; }
+    width = reader.width();
+    height = reader.height();
+    return image;
+}
+
+bool writeQOI(const char* filename, int width, int height, const uint8_t* data) {
+    if (!filename || !data || (width < 1) || (height < 1)
+    || ((uint64_t(width) * uint64_t(height)) > QOI::MaxPixels)) { return false; }
+    size_t pixelCount = size_t(width) * size_t(height);
+    std::vector<uint8_t> out;
+    out.reserve(QOI::HeaderSize + pixelCount * 2u + QOI::PaddingSize);
+    const uint8_t header[QOI::HeaderSize] = { 'q', 'o', 'i', 'f',
+        uint8_t(width >> 24), uint8_t(width >> 16), uint8_t(width >> 8), uint8_t(width),
+        uint8_t(height >> 24), uint8_t(height >> 16), uint8_t(height >> 8), uint8_t(height),
+        4,    // channels: RGBA
+        0 };  // color space: sRGB with linear alpha
+    out.insert(out.end(), header, header + QOI::HeaderSize);
+
+    uint8_t index[64][4];
+    memset(index, 0, sizeof(index));
+    uint8_t prev[4] = { 0, 0, 0, 255 };
+    int run = 0;
+    for (size_t i = 0;  i < pixelCount;  ++i) {
+        const uint8_t* px = &data[i * 4u];
+        if (!memcmp(px, prev, 4)) {
+            ++run;
+            if ((run == 62) || ((i + 1) == pixelCount)) {
+                out.push_back(uint8_t(QOI::OpRun | (run - 1)));
+                run = 0;
+            }
+            continue;
+        }
+        if (run > 0) {
+            out.push_back(uint8_t(QOI::OpRun | (run - 1)));
+            run = 0;
+        }
+        int h = QOI::hash(px);
+        if (!memcmp(index[h], px, 4)) {
+            out.push_back(uint8_t(QOI::OpIndex | h));
+        } else {
+            memcpy(index[h], px, 4);
+            if (px[3] == prev[3]) {
+                int vr = int(int8_t(uint8_t(px[0] - prev[0])));
+                int vg = int(int8_t(uint8_t(px[1] - prev[1])));
+                int vb = int(int8_t(uint8_t(px[2] - prev[2])));
+                int vgr = vr - vg, vgb = vb - vg;
+                if ((vr >= -2) && (vr <= 1) && (vg >= -2) && (vg <= 1) && (vb >= -2) && (vb <= 1)) {
+                    out.push_back(uint8_t(QOI::OpDiff | ((vr + 2) << 4) | ((vg + 2) << 2) | (vb + 2)));
+                } else if ((vgr >= -8) && (vgr <= 7) && (vg >= -32) && (vg <= 31) && (vgb >= -8) && (vgb <= 7)) {
+                    out.push_back(uint8_t(QOI::OpLuma | (vg + 32)));
+                    out.push_back(uint8_t(((vgr + 8) << 4) | (vgb + 8)));
+                } else {
+                    out.push_back(QOI::OpRGB);
+                    out.insert(out.end(), px, px + 3);
+                }
+            } else {
+                out.push_back(QOI::OpRGBA);
+                out.insert(out.end(), px, px + 4);
+            }
+        }
+        memcpy(prev, px, 4);
+    }
+    static const uint8_t padding[QOI::PaddingSize] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+    out.insert(out.end(), padding, padding + QOI::PaddingSize);
+
+    FILE* f = fopen(filename, "wb");
+    if (!f) { return false; }
+    bool ok = (fwrite(out.data(), out.size(), 1, f) == 1);
+    return (fclose(f) == 0) && ok;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+//! extract the next whitespace-delimited token from a Netpbm header,
+//! skipping comments
+static bool nextHeaderToken(const uint8_t* data, size_t size, size_t& pos, char* token, size_t maxLen) {
+    for (;;) {
+        while ((pos < size) && isspace(data[pos])) { ++pos; }
+        if ((pos >= size) || (data[pos] != '#')) { break; }
+        while ((pos < size) && (data[pos] != '\n')) { ++pos; }
+    }
+    size_t len = 0;
+    while ((pos < size) && !isspace(data[pos]) && (len < (maxLen - 1))) { token[len++] = char(data[pos++]); }
+    token[len] = '\0';
+    return (len > 0);
+}
+
+//! parse an image dimension in a Netpbm header; 0 if invalid
+static int parseDimension(const char* token) {
+    constexpr long MaxDimension = 1L << 20;
+    char* end = nullptr;
+    long v = strtol(token, &end, 10);
+    return (end && (end != token) && !*end && (v > 0) && (v <= MaxDimension)) ? int(v) : 0;
+}
+
+bool RawImageInfo::needsByteSwap() const {
+    return (bytesPerSample > 1) && (bigEndian == isLittleEndian());
+}
+
+bool parseRawImageHeader(const uint8_t* data, size_t size, RawImageInfo& info) {
+    info = RawImageInfo();
+    if (!data || (size < 3) || (data[0] != 'P')) { return false; }
+    char token[32];
+    size_t pos = 0;
+    if (!nextHeaderToken(data, size, pos, token, sizeof(token))) { return false; }
+    int maxval = 0;
+    if (!strcmp(token, "P6") || !strcmp(token, "PF")) {
+        // PPM or PFM: width, height, maxval or scale
+        bool isFloat = (token[1] == 'F');
+        if (!nextHeaderToken(data, size, pos, token, sizeof(token))) { return false; }
+        info.width = parseDimension(token);
+        if (!nextHeaderToken(data, size, pos, token, sizeof(token))) { return false; }
+        info.height = parseDimension(token);
+        if (!nextHeaderToken(data, size, pos, token, sizeof(token))) { return false; }
+        info.channels = 3;
+        if (isFloat) {
+            // the sign of the scale determines the byte order
+            info.bytesPerSample = 4;
+            info.bigEndian = (atof(token) > 0.0);
+            info.bottomUp = true;
+        } else {
+            maxval = atoi(token);
+        }
+    } else if (!strcmp(token, "P7")) {
+        // PAM: key/value header lines
+        for (;;) {
+            if (!nextHeaderToken(data, size, pos, token, sizeof(token))) { return false; }
+            if (!strcmp(token, "ENDHDR")) { break; }
+            char key[32];
+            strcpy(key, token);
+            if (!nextHeaderToken(data, size, pos, token, sizeof(token))) { return false; }
+                 if (!strcmp(key, "WIDTH"))    { info.width = parseDimension(token); }
+            else if (!strcmp(key, "HEIGHT"))   { info.height = parseDimension(token); }
+            else if (!strcmp(key, "DEPTH"))    { info.channels = atoi(token); }
+            else if (!strcmp(key, "MAXVAL"))   { maxval = atoi(token); }
+            else if (!strcmp(key, "TUPLTYPE")) { /* implied by DEPTH */ }
+        }
+    } else {
+        return false;
+    }
+    if (!info.bytesPerSample) {
+        if (maxval == 255) { info.bytesPerSample = 1; }
+        else if (maxval == 65535) { info.bytesPerSample = 2; info.bigEndian = true; }
+        else { return false; }
+    }
+    info.offset = pos + 1;  // exactly one whitespace character after the header
+    if ((info.width <= 0) || (info.height <= 0) || ((info.channels != 3) && (info.channels != 4)) || (info.offset > size)) {
+        return false;
+    }
+    // the dimensions are limited, so this can't overflow; once the data
+    // is known to fit into the file, dataSize() can't overflow either
+    uint64_t dataSize = uint64_t(info.width) * uint64_t(info.height) * uint64_t(info.channels) * uint64_t(info.bytesPerSample);
+    return (dataSize <= uint64_t(size - info.offset));
+}
+
+//! reader for raw PPM/PAM/PFM data (converts to RGBA, host byte order)
+class RawReader : public RowReader {
+    const uint8_t* m_data;
+    RawImageInfo m_info;
+public:
+    RawReader(const uint8_t* data, const RawImageInfo& info) : m_data(data), m_info(info) {
+        m_width = info.width;
+        m_height = info.height;
+        m_bytesPerSample = info.bytesPerSample;
+    }
+
+    bool readRows(void* dest, int count) override {
+        if (!good() || !readRawImageRegion(m_data, m_info, 0, m_row, m_width, count, dest)) { return false; }
+        m_row += count;
+        return true;
+    }
+};
+
+bool readRawImageRegion(const uint8_t* data, const RawImageInfo& info, int x0, int y0, int width, int height, void* dest) {
+    if (!data || !dest || (x0 < 0) || (y0 < 0) || (width < 0) || (height < 0)
+    || ((x0 + width) > info.width) || ((y0 + height) > info.height)) { return false; }
+    const bool swap = info.needsByteSwap();
+    const int bps = info.bytesPerSample;
+    uint8_t* out = static_cast<uint8_t*>(dest);
+    for (int y = y0;  y < (y0 + height);  ++y) {
+        const uint8_t* src = &data[info.offset + size_t(info.bottomUp ? (info.height - 1 - y) : y) * info.rowSize()
+                                   + size_t(x0) * size_t(info.channels) * size_t(bps)];
+        for (int x = 0;  x < width;  ++x) {
+            for (int c = 0;  c < 4;  ++c) {
+                if (c < info.channels) {
+                    for (int b = 0;  b < bps;  ++b) { out[b] = src[swap ? (bps - 1 - b) : b]; }
+                    src += bps;
+                } else if (bps == 4) {  // opaque alpha
+                    const float one = 1.0f;
+                    memcpy(out, &one, 4);
+                } else {
+                    memset(out, 0xFF, size_t(bps));
+                }
+                out += bps;
+            }
+        }
+    }
+    return true;
+}
+
+void* convertRawImage(const uint8_t* data, const RawImageInfo& info) {
+    RawReader reader(data, info);
+    void* image = malloc(size_t(reader.height()) * reader.rowSize());
+    if (!image) { return nullptr; }
+    if (!reader.readRows(image, reader.height())) { ::free(image); return nullptr; }
+    return image;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Inflate {
+    constexpr int FastBits = 9;
+    constexpr uint32_t WindowSize = 32768;
+    static const uint16_t lengthBase[29] = {
+        3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+        35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+    static const uint8_t lengthExtra[29] = {
+        0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+        3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+    static const uint16_t distBase[30] = {
+        1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+        257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+    static const uint8_t distExtra[30] = {
+        0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+        7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+    static const uint8_t codeLengthOrder[19] = {
+        16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+    static inline uint32_t reverseBits(uint32_t x, int bits) {
+        uint32_t r = 0;
+        while (bits--) { r = (r << 1) | (x & 1);  x >>= 1; }
+        return r;
+    }
+
+    //! canonical Huffman decoding table, with a fast lookup for short codes
+    struct Huffman {
+        uint16_t fast[1 << FastBits];  //!< (length << 9) | symbol, or 0
+        uint32_t maxCode[17];          //!< per length, left-aligned to 16 bits
+        uint16_t firstCode[16];
+        uint16_t firstSymbol[16];
+        uint8_t  size[288];
+        uint16_t value[288];
+        int count = 0;
+
+        bool build(const uint8_t* lengths, int n) {
+            int sizes[16] = { 0, };
+            memset(fast, 0, sizeof(fast));
+            for (int i = 0;  i < n;  ++i) { ++sizes[lengths[i]]; }
+            sizes[0] = 0;
+            uint32_t nextCode[16];
+            uint32_t code = 0;
+            int k = 0;
+            for (int i = 1;  i < 16;  ++i) {
+                nextCode[i] = code;
+                firstCode[i] = uint16_t(code);
+                firstSymbol[i] = uint16_t(k);
+                code += uint32_t(sizes[i]);
+                if (sizes[i] && ((code - 1) >= (1u << i))) { return false; }  // over-subscribed
+                maxCode[i] = code << (16 - i);
+                code <<= 1;
+                k += sizes[i];
+            }
+            maxCode[16] = 0x10000u;
+            count = k;
+            for (int i = 0;  i < n;  ++i) {
+                int s = lengths[i];
+                if (!s) { continue; }
+                int c = int(nextCode[s] - firstCode[s] + firstSymbol[s]);
+                size[c] = uint8_t(s);
+                value[c] = uint16_t(i);
+                if (s <= FastBits) {
+                    for (uint32_t j = reverseBits(nextCode[s], s);  j < (1u << FastBits);  j += (1u << s)) {
+                        fast[j] = uint16_t((s << 9) | i);
+                    }
+                }
+                ++nextCode[s];
+            }
+            return true;
+        }
+    };
+}
+
+//! sequential PNG decoder with a built-in streaming inflate; supports
+//! non-interlaced images with 8 or 16 bits per sample
+class PNGReader : public RowReader {
+    // chunk and bit input
+    const uint8_t* m_data;
+    size_t m_size;
+    size_t m_nextChunk = 0;           //!< offset of the chunk after the current IDAT
+    const uint8_t* m_in = nullptr;    //!< current position in the current IDAT
+    size_t m_inLeft = 0;
+    uint32_t m_bitBuf = 0;
+    int m_bitCount = 0;
+    int m_padBytes = 0;               //!< bytes read past the end of the data
+
+    // inflate state
+    enum class Block { None, Stored, Huffman } m_block = Block::None;
+    bool m_finalBlock = false;
+    uint32_t m_storedLeft = 0;
+    uint32_t m_matchLen = 0;
+    uint32_t m_matchDist = 0;
+    uint64_t m_totalOut = 0;
+    std::vector<uint8_t> m_window;
+    Inflate::Huffman m_lit, m_dist;
+
+    // image format
+    int m_colorType = 0;
+    int m_channels = 0;
+    int m_bpp = 1;  //!< bytes per complete pixel, for filtering
+    size_t m_stride = 0;
+    std::vector<uint8_t> m_prev, m_cur;
+    uint8_t m_palette[256][4];
+    bool m_hasKey = false;
+    uint16_t m_key[3] = { 0, 0, 0 };
+
+    static inline uint32_t getBE32(const uint8_t* p) {
+        return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+    }
+
+    bool nextIDAT() {
+        if ((m_nextChunk + 12) > m_size) { return false; }
+        const uint8_t* chunk = &m_data[m_nextChunk];
+        uint32_t len = getBE32(chunk);
+        if (memcmp(&chunk[4], "IDAT", 4) || (len > (m_size - m_nextChunk - 12))) { return false; }
+        m_in = &chunk[8];
+        m_inLeft = len;
+        m_nextChunk += size_t(len) + 12u;
+        return true;
+    }
+
+    inline void fill(int n) {
+        while (m_bitCount < n) {
+            while (!m_inLeft) {
+                if (!nextIDAT()) { ++m_padBytes;  m_bitCount += 8;  break; }
+            }
+            if (m_inLeft) {
+                m_bitBuf |= uint32_t(*m_in++) << m_bitCount;
+                --m_inLeft;
+                m_bitCount += 8;
+            }
+        }
+    }
+    inline uint32_t getBits(int n) {
+        if (!n) { return 0; }
+        fill(n);
+        uint32_t v = m_bitBuf & ((1u << n) - 1u);
+        m_bitBuf >>= n;
+        m_bitCount -= n;
+        return v;
+    }
+
+    int decode(const Inflate::Huffman& h) {
+        fill(16);
+        uint32_t f = h.fast[m_bitBuf & ((1u << Inflate::FastBits) - 1u)];
+        if (f) {
+            int s = int(f >> 9);
+            m_bitBuf >>= s;
+            m_bitCount -= s;
+            return int(f & 511);
+        }
+        uint32_t k = Inflate::reverseBits(m_bitBuf & 0xFFFFu, 16);
+        int s = Inflate::FastBits + 1;
+        while (k >= h.maxCode[s]) { ++s; }
+        if (s >= 16) { return -1; }
+        int idx = int(k >> (16 - s)) - h.firstCode[s] + h.firstSymbol[s];
+        if ((idx < 0) || (idx >= h.count) || (h.size[idx] != s)) { return -1; }
+        m_bitBuf >>= s;
+        m_bitCount -= s;
+        return h.value[idx];
+    }
+
+    bool readDynamicTables() {
+        int hlit  = int(getBits(5)) + 257;
+        int hdist = int(getBits(5)) + 1;
+        int hclen = int(getBits(4)) + 4;
+        if ((hlit > 286) || (hdist > 30)) { return false; }
+        uint8_t clen[19] = { 0, };
+        for (int i = 0;  i < hclen;  ++i) { clen[Inflate::codeLengthOrder[i]] = uint8_t(getBits(3)); }
+        Inflate::Huffman ch;
+        if (!ch.build(clen, 19)) { return false; }
+        uint8_t lengths[286 + 30];
+        int n = 0;
+        while (n < (hlit + hdist)) {
+            int c = decode(ch);
+            int rep = 0;
+            uint8_t fillValue = 0;
+            if ((c < 0) || (c > 18)) { return false; }
+            if (c < 16) { lengths[n++] = uint8_t(c);  continue; }
+            if (c == 16) {
+                if (!n) { return false; }
+                rep = int(getBits(2)) + 3;
+                fillValue = lengths[n - 1];
+            } else if (c == 17) {
+                rep = int(getBits(3)) + 3;
+            } else {
+                rep = int(getBits(7)) + 11;
+            }
+            if ((n + rep) > (hlit + hdist)) { return false; }
+            memset(&lengths[n], fillValue, size_t(rep));
+            n += rep;
+        }
+        return m_lit.build(lengths, hlit) && m_dist.build(&lengths[hlit], hdist);
+    }
+
+    inline void output(uint8_t b, uint8_t*& out) {
+        m_window[size_t(m_totalOut++ & (Inflate::WindowSize - 1u))] = b;
+        *out++ = b;
+    }
+
+    bool inflate(uint8_t* out, size_t n) {
+        while (n) {
+            if (m_padBytes > 4) { return false; }  // truncated stream
+            if (m_matchLen) {
+                size_t count = std::min(n, size_t(m_matchLen));
+                for (size_t i = count;  i;  --i) {
+                    output(m_window[size_t((m_totalOut - m_matchDist) & (Inflate::WindowSize - 1u))], out);
+                }
+                m_matchLen -= uint32_t(count);
+                n -= count;
+                continue;
+            }
+            if (m_block == Block::None) {
+                if (m_finalBlock) { return false; }  // more data requested than available
+                m_finalBlock = (getBits(1) != 0);
+                switch (getBits(2)) {
+                    case 0: {
+                        getBits(m_bitCount & 7);  // align to byte boundary
+                        uint32_t len = getBits(16);
+                        uint32_t nlen = getBits(16);
+                        if ((len ^ 0xFFFFu) != nlen) { return false; }
+                        m_storedLeft = len;
+                        m_block = Block::Stored;
+                        break; }
+                    case 1: {
+                        uint8_t lengths[288 + 32];
+                        memset(&lengths[0],   8, 144);
+                        memset(&lengths[144], 9, 112);
+                        memset(&lengths[256], 7,  24);
+                        memset(&lengths[280], 8,   8);
+                        memset(&lengths[288], 5,  32);
+                        if (!m_lit.build(lengths, 288) || !m_dist.build(&lengths[288], 32)) { return false; }
+                        m_block = Block::Huffman;
+                        break; }
+                    case 2:
+                        if (!readDynamicTables()) { return false; }
+                        m_block = Block::Huffman;
+                        break;
+                    default:
+                        return false;
+                }
+                continue;
+            }
+            if (m_block == Block::Stored) {
+                if (!m_storedLeft) { m_block = Block::None;  continue; }
+                output(uint8_t(getBits(8)), out);
+                --m_storedLeft;
+                --n;
+                continue;
+            }
+            int sym = decode(m_lit);
+            if (sym < 0) { return false; }
+            if (sym < 256) {
+                output(uint8_t(sym), out);
+                --n;
+            } else if (sym == 256) {
+                m_block = Block::None;
+            } else {
+                sym -= 257;
+                if (sym >= 29) { return false; }
+                m_matchLen = Inflate::lengthBase[sym] + getBits(Inflate::lengthExtra[sym]);
+                int d = decode(m_dist);
+                if ((d < 0) || (d >= 30)) { return false; }
+                m_matchDist = Inflate::distBase[d] + getBits(Inflate::distExtra[d]);
+                if (m_matchDist > m_totalOut) { return false; }
+            }
+        }
+        return true;
+    }
+
+public:
+    PNGReader(const uint8_t* data, size_t size) : m_data(data), m_size(size) {
+        static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+        if (!data || (size < 33) || memcmp(data, signature, 8) || memcmp(&data[12], "IHDR", 4)) { return; }
+        int w = int(getBE32(&data[16]));
+        int h = int(getBE32(&data[20]));
+        int depth = data[24];
+        m_colorType = data[25];
+        if ((w < 1) || (h < 1) || data[26] || data[27] || data[28]) { return; }  // no interlacing
+        switch (m_colorType) {
+            case 0: m_channels = 1; break;
+            case 2: m_channels = 3; break;
+            case 3: m_channels = 1; if (depth != 8) { return; } break;
+            case 4: m_channels = 2; break;
+            case 6: m_channels = 4; break;
+            default: return;
+        }
+        if ((depth != 8) && (depth != 16)) { return; }
+        m_bytesPerSample = depth / 8;
+        m_bpp = m_channels * m_bytesPerSample;
+        m_stride = size_t(w) * size_t(m_bpp);
+
+        // scan the chunks up to the first IDAT
+        for (int i = 0;  i < 256;  ++i) {
+            m_palette[i][0] = m_palette[i][1] = m_palette[i][2] = 0;  m_palette[i][3] = 255;
+        }
+        size_t pos = 8;
+        for (;;) {
+            if ((pos + 12) > size) { return; }
+            uint32_t len = getBE32(&data[pos]);
+            if (len > (size - pos - 12)) { return; }
+            const uint8_t* type = &data[pos + 4];
+            const uint8_t* chunk = &data[pos + 8];
+            if (!memcmp(type, "IDAT", 4)) { break; }
+            if (!memcmp(type, "IEND", 4)) { return; }
+            if (!memcmp(type, "PLTE", 4)) {
+                for (uint32_t i = 0;  (i < 256) && ((i * 3 + 2) < len);  ++i) {
+                    memcpy(m_palette[i], &chunk[i * 3], 3);
+                }
+            } else if (!memcmp(type, "tRNS", 4)) {
+                if (m_colorType == 3) {
+                    for (uint32_t i = 0;  (i < 256) && (i < len);  ++i) { m_palette[i][3] = chunk[i]; }
+                } else if ((m_colorType == 0) && (len >= 2)) {
+                    m_hasKey = true;
+                    m_key[0] = uint16_t((chunk[0] << 8) | chunk[1]);
+                } else if ((m_colorType == 2) && (len >= 6)) {
+                    m_hasKey = true;
+                    for (int c = 0;  c < 3;  ++c) { m_key[c] = uint16_t((chunk[c * 2] << 8) | chunk[c * 2 + 1]); }
+                }
+            }
+            pos += size_t(len) + 12u;
+        }
+        m_nextChunk = pos;
+
+        // check the zlib header
+        uint32_t cmf = getBits(8), flg = getBits(8);
+        if (((cmf * 256u + flg) % 31u) || ((cmf & 15) != 8) || (flg & 32)) { return; }
+
+        m_window.resize(Inflate::WindowSize);
+        m_prev.assign(m_stride, 0);
+        m_cur.resize(m_stride);
+        m_width = w;
+        m_height = h;
+    }
+
+    bool readRows(void* dest, int count) override {
+        if (!good() || (count < 0) || ((m_row + count) > m_height)) { return false; }
+        uint8_t* out8 = static_cast<uint8_t*>(dest);
+        for (int y = 0;  y < count;  ++y) {
+            // decompress and unfilter one scanline
+            uint8_t filter;
+            uint8_t* cur = m_cur.data();
+            if (!inflate(&filter, 1) || !inflate(cur, m_stride)) { return false; }
+            const uint8_t* prev = m_prev.data();
+            const size_t bpp = size_t(m_bpp);
+            switch (filter) {
+                case 0: break;
+                case 1: for (size_t i = bpp;  i < m_stride;  ++i) { cur[i] = uint8_t(cur[i] + cur[i - bpp]); } break;
+                case 2: for (size_t i = 0;    i < m_stride;  ++i) { cur[i] = uint8_t(cur[i] + prev[i]); } break;
+                case 3:
+                    for (size_t i = 0;  i < m_stride;  ++i) {
+                        int a = (i >= bpp) ? cur[i - bpp] : 0;
+                        cur[i] = uint8_t(cur[i] + ((a + prev[i]) >> 1));
+                    }
+                    break;
+                case 4:
+                    for (size_t i = 0;  i < m_stride;  ++i) {
+                        int a = (i >= bpp) ? cur[i - bpp]  : 0;
+                        int b = prev[i];
+                        int c = (i >= bpp) ? prev[i - bpp] : 0;
+                        int p = a + b - c;
+                        int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+                        cur[i] = uint8_t(cur[i] + (((pa <= pb) && (pa <= pc)) ? a : (pb <= pc) ? b : c));
+                    }
+                    break;
+                default:
+                    return false;
+            }
+
+            // convert to RGBA
+            if (m_bytesPerSample == 1) {
+                for (int x = 0;  x < m_width;  ++x) {
+                    const uint8_t* s = &cur[size_t(x) * bpp];
+                    switch (m_colorType) {
+                        case 0: out8[0] = out8[1] = out8[2] = s[0];
+                                out8[3] = (m_hasKey && (s[0] == m_key[0])) ? 0 : 255; break;
+                        case 2: out8[0] = s[0];  out8[1] = s[1];  out8[2] = s[2];
+                                out8[3] = (m_hasKey && (s[0] == m_key[0]) && (s[1] == m_key[1]) && (s[2] == m_key[2])) ? 0 : 255; break;
+                        case 3: memcpy(out8, m_palette[s[0]], 4); break;
+                        case 4: out8[0] = out8[1] = out8[2] = s[0];  out8[3] = s[1]; break;
+                        default: memcpy(out8, s, 4); break;
+                    }
+                    out8 += 4;
+                }
+            } else {
+                uint16_t* out16 = reinterpret_cast<uint16_t*>(out8);
+                for (int x = 0;  x < m_width;  ++x) {
+                    const uint8_t* s = &cur[size_t(x) * bpp];
+                    uint16_t v[4];
+                    for (int c = 0;  c < m_channels;  ++c) { v[c] = uint16_t((s[c * 2] << 8) | s[c * 2 + 1]); }
+                    switch (m_colorType) {
+                        case 0: out16[0] = out16[1] = out16[2] = v[0];
+                                out16[3] = (m_hasKey && (v[0] == m_key[0])) ? 0 : 0xFFFF; break;
+                        case 2: out16[0] = v[0];  out16[1] = v[1];  out16[2] = v[2];
+                                out16[3] = (m_hasKey && (v[0] == m_key[0]) && (v[1] == m_key[1]) && (v[2] == m_key[2])) ? 0 : 0xFFFF; break;
+                        case 4: out16[0] = out16[1] = out16[2] = v[0];  out16[3] = v[1]; break;
+                        default: memcpy(out16, v, 8); break;
+                    }
+                    out16 += 4;
+                }
+                out8 = reinterpret_cast<uint8_t*>(out16);
+            }
+            m_prev.swap(m_cur);
+        }
+        m_row += count;
+        return true;
+    }
+};
+
+RowReader* createRowReader(const uint8_t* data, size_t size) {
+    if (!data || (size < 4)) { return nullptr; }
+    RowReader* reader = nullptr;
+    RawImageInfo info;
+    if (data[0] == 0x89) {
+        reader = new PNGReader(data, size);
+    } else if (!memcmp(data, "qoif", 4)) {
+        reader = new QOIReader(data, size);
+    } else if (parseRawImageHeader(data, size, info)) {
+        reader = new RawReader(data, info);
+    }
+    if (reader && !reader->good()) {
+        delete reader;
+        reader = nullptr;
+    }
+    return reader;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Deflate {
+    constexpr int HashBits = 15;
+    constexpr int MaxChain = 32;           //!< maximum number of match candidates to check
+    constexpr size_t MinMatch = 3;
+    constexpr size_t MaxMatch = 258;
+    constexpr size_t WindowSize = 32768;
+    constexpr size_t ChunkSize = 65536;    //!< amount of new data to collect before encoding
+
+    //! incremental zlib compressor; like stb_image_write's implementation,
+    //! it uses LZ77 with hash chains and the fixed Huffman code, but it can
+    //! be fed with data piece by piece and keeps only one window in memory
+    class Encoder {
+        std::vector<uint8_t> m_buf;   //!< up to one window of history, followed by pending data
+        uint64_t m_base = 0;          //!< stream position of m_buf[0]
+        size_t m_pos = 0;             //!< next byte to encode, as an index into m_buf
+        std::vector<int64_t> m_head;  //!< per hash: most recent stream position, or -1
+        std::vector<int64_t> m_prev;  //!< per window position: previous position with the same hash
+        uint32_t m_adlerA = 1;
+        uint32_t m_adlerB = 0;
+        uint32_t m_bitBuf = 0;
+        int m_bitCount = 0;
+        uint16_t m_code[288];         //!< fixed Huffman code, bit-reversed
+        uint8_t m_codeLength[288];
+
+        inline void putBits(uint32_t bits, int count) {
+            m_bitBuf |= bits << m_bitCount;
+            m_bitCount += count;
+            while (m_bitCount >= 8) {
+                output.push_back(uint8_t(m_bitBuf));
+                m_bitBuf >>= 8;
+                m_bitCount -= 8;
+            }
+        }
+        inline void putSymbol(int sym) {
+            putBits(m_code[sym], m_codeLength[sym]);
+        }
+        inline uint32_t hash(size_t pos) const {
+            uint32_t x = uint32_t(m_buf[pos]) | (uint32_t(m_buf[pos + 1]) << 8) | (uint32_t(m_buf[pos + 2]) << 16);
+            return (x * 2654435761u) >> (32 - HashBits);
+        }
+        inline void insert(size_t pos) {
+            uint32_t h = hash(pos);
+            int64_t p = int64_t(m_base + pos);
+            m_prev[size_t(p) & (WindowSize - 1)] = m_head[h];
+            m_head[h] = p;
+        }
+
+        void putMatch(size_t length, size_t dist) {
+            int li = 28;
+            while (Inflate::lengthBase[li] > length) { --li; }
+            putSymbol(257 + li);
+            putBits(uint32_t(length - Inflate::lengthBase[li]), Inflate::lengthExtra[li]);
+            int di = 29;
+            while (Inflate::distBase[di] > dist) { --di; }
+            putBits(Inflate::reverseBits(uint32_t(di), 5), 5);
+            putBits(uint32_t(dist - Inflate::distBase[di]), Inflate::distExtra[di]);
+        }
+
+        //! encode the pending data as one fixed-Huffman block; unless
+        //! flushing, enough data for a maximum-length match is kept back
+        void encode(bool flush) {
+            size_t end = m_buf.size();
+            size_t limit = flush ? end : ((end > MaxMatch) ? (end - MaxMatch) : 0);
+            if (m_pos >= limit) { return; }
+            putBits(2, 3);  // non-final block, fixed Huffman code
+            while (m_pos < limit) {
+                size_t bestLength = 0, bestDist = 0;
+                size_t maxLength = std::min(end - m_pos, MaxMatch);
+                if (maxLength >= MinMatch) {
+                    int64_t cur = int64_t(m_base + m_pos);
+                    int64_t cand = m_head[hash(m_pos)];
+                    for (int chain = MaxChain;  (cand >= 0) && chain--;) {
+                        size_t dist = size_t(cur - cand);
+                        if (dist > WindowSize) { break; }
+                        const uint8_t* a = &m_buf[size_t(cand - int64_t(m_base))];
+                        const uint8_t* b = &m_buf[m_pos];
+                        size_t length = 0;
+                        while ((length < maxLength) && (a[length] == b[length])) { ++length; }
+                        if (length > bestLength) {
+                            bestLength = length;
+                            bestDist = dist;
+                            if (length == maxLength) { break; }
+                        }
+                        int64_t next = m_prev[size_t(cand) & (WindowSize - 1)];
+                        if (next >= cand) { break; }  // stale entry
+                        cand = next;
+                    }
+                    insert(m_pos);
+                }
+                if (bestLength >= MinMatch) {
+                    putMatch(bestLength, bestDist);
+                    for (size_t i = 1;  (i < bestLength) && ((m_pos + i + MinMatch) <= end);  ++i) {
+                        insert(m_pos + i);
+                    }
+                    m_pos += bestLength;
+                } else {
+                    putSymbol(m_buf[m_pos++]);
+                }
+            }
+            putSymbol(256);  // end of block
+
+            // drop history that can't be referenced any longer
+            if (m_pos > (WindowSize + ChunkSize)) {
+                size_t drop = m_pos - WindowSize;
+                m_buf.erase(m_buf.begin(), m_buf.begin() + ptrdiff_t(drop));
+                m_base += drop;
+                m_pos -= drop;
+            }
+        }
+
+    public:
+        std::vector<uint8_t> output;  //!< compressed data; to be consumed by the caller
+
+        Encoder() : m_head(size_t(1) << HashBits, -1), m_prev(WindowSize, -1) {
+            for (int i = 0;  i < 288;  ++i) {
+                uint32_t code; int length;
+                     if (i < 144) { code = 0x030u + uint32_t(i);       length = 8; }
+                else if (i < 256) { code = 0x190u + uint32_t(i - 144); length = 9; }
+                else if (i < 280) { code = uint32_t(i - 256);          length = 7; }
+                else              { code = 0x0C0u + uint32_t(i - 280); length = 8; }
+                m_code[i] = uint16_t(Inflate::reverseBits(code, length));
+                m_codeLength[i] = uint8_t(length);
+            }
+            output.push_back(0x78);  // zlib header: deflate, 32K window
+            output.push_back(0x01);
+        }
+
+        void write(const void* data, size_t size) {
+            const uint8_t* p = static_cast<const uint8_t*>(data);
+            m_buf.insert(m_buf.end(), p, p + size);
+            while (size) {
+                // Adler-32, with the modulo deferred as long as possible
+                size_t n = std::min(size, size_t(5552));
+                size -= n;
+                while (n--) { m_adlerA += *p++;  m_adlerB += m_adlerA; }
+                m_adlerA %= 65521u;
+                m_adlerB %= 65521u;
+            }
+            if ((m_buf.size() - m_pos) >= (ChunkSize + MaxMatch)) { encode(false); }
+        }
+
+        void finish() {
+            encode(true);
+            putBits(3, 3);    // final block, fixed Huffman code ...
+            putSymbol(256);   // ... that's empty
+            if (m_bitCount > 0) { output.push_back(uint8_t(m_bitBuf)); }
+            m_bitBuf = 0;
+            m_bitCount = 0;
+            uint8_t adler[4];
+            putBE32(adler, (m_adlerB << 16) | m_adlerA);
+            output.insert(output.end(), adler, adler + 4);
+        }
+    };
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+RowWriter::~RowWriter() {
+    if (m_file) { fclose(m_file); }
+}
+
+bool RowWriter::write(const void* data, size_t size) {
+    m_ok = m_ok && m_file && (!size || (fwrite(data, size, 1, m_file) == 1));
+    return m_ok;
+}
+
+bool RowWriter::close() {
+    if (m_file) {
+        m_ok = (fclose(m_file) == 0) && m_ok;
+        m_file = nullptr;
+    }
+    return m_ok && (m_row == m_height);
+}
+
+//! sequential PNG encoder; each row gets the filter that minimizes the
+//! sum of absolute differences, just like stb_image_write does it
+class PNGWriter : public RowWriter {
+    static constexpr size_t IDATSize = 256u << 10;
+    Deflate::Encoder m_z;
+    std::vector<uint8_t> m_prev;
+    std::vector<uint8_t> m_cur;
+    std::vector<uint8_t> m_line[2];  //!< filter type + filtered row (best and candidate)
+
+    bool writeChunk(const char* type, const uint8_t* data, size_t size) {
+        m_ok = m_ok && ImageUtil::writeChunk(m_file, type, data, size);
+        return m_ok;
+    }
+    bool flush() {
+        if (m_z.output.empty()) { return m_ok; }
+        writeChunk("IDAT", m_z.output.data(), m_z.output.size());
+        m_z.output.clear();
+        return m_ok;
+    }
+    static inline int paeth(int a, int b, int c) {
+        int p = a + b - c, pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+        return ((pa <= pb) && (pa <= pc)) ? a : (pb <= pc) ? b : c;
+    }
+
+public:
+    PNGWriter(FILE* f, int width, int height, int bytesPerSample) {
+        m_file = f;
+        m_width = width;
+        m_height = height;
+        m_bytesPerSample = bytesPerSample;
+        m_prev.assign(rowSize(), 0);
+        m_cur.resize(rowSize());
+        m_line[0].resize(rowSize() + 1u);
+        m_line[1].resize(rowSize() + 1u);
+        uint8_t ihdr[13];
+        putBE32(&ihdr[0], uint32_t(width));
+        putBE32(&ihdr[4], uint32_t(height));
+        ihdr[8]  = uint8_t(bytesPerSample * 8);  // bit depth
+        ihdr[9]  = 6;   // color type: RGBA
+        ihdr[10] = 0;   // compression: deflate
+        ihdr[11] = 0;   // filter method: adaptive
+        ihdr[12] = 0;   // no interlacing
+        static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+        write(signature, 8);
+        writeChunk("IHDR", ihdr, sizeof(ihdr));
+    }
+
+    bool writeRows(const void* rows, int count) override {
+        const size_t n = rowSize();
+        const size_t bpp = size_t(m_bytesPerSample) * 4u;
+        const uint8_t* src = static_cast<const uint8_t*>(rows);
+        for (;  m_ok && count && (m_row < m_height);  --count, ++m_row, src += n) {
+            // PNG samples are big-endian
+            if ((m_bytesPerSample == 2) && isLittleEndian()) {
+                for (size_t i = 0;  i < n;  i += 2) { m_cur[i] = src[i + 1];  m_cur[i + 1] = src[i]; }
+            } else {
+                memcpy(m_cur.data(), src, n);
+            }
+
+            // try all filters and keep the best one
+            int best = 0;
+            uint64_t bestSum = ~uint64_t(0);
+            for (int filter = 0;  filter < 5;  ++filter) {
+                uint8_t* line = m_line[best ^ 1].data();
+                line[0] = uint8_t(filter);
+                uint64_t sum = 0;
+                for (size_t i = 0;  i < n;  ++i) {
+                    int a = (i >= bpp) ? m_cur[i - bpp] : 0;
+                    int b = m_prev[i];
+                    int c = (i >= bpp) ? m_prev[i - bpp] : 0;
+                    int pred;
+                    switch (filter) {
+                        case 1:  pred = a; break;
+                        case 2:  pred = b; break;
+                        case 3:  pred = (a + b) >> 1; break;
+                        case 4:  pred = paeth(a, b, c); break;
+                        default: pred = 0; break;
+                    }
+                    uint8_t d = uint8_t(m_cur[i] - pred);
+                    line[i + 1] = d;
+                    sum += uint64_t(abs(int(int8_t(d))));
+                }
+                if (sum < bestSum) {
+                    bestSum = sum;
+                    best = int(line == m_line[1].data());
+                }
+            }
+            m_z.write(m_line[best].data(), n + 1u);
+            m_prev.swap(m_cur);
+            if (m_z.output.size() >= IDATSize) { flush(); }
+        }
+        return m_ok;
+    }
+
+    bool finish() override {
+        m_z.finish();
+        flush();
+        writeChunk("IEND", nullptr, 0);
+        return close();
+    }
+};
+
+RowWriter* createPNGWriter(const char* filename, int width, int height, int bytesPerSample) {
+    if (!filename || (width < 1) || (height < 1) || ((bytesPerSample != 1) && (bytesPerSample != 2))) { return nullptr; }
+    FILE* f = fopen(filename, "wb");
+    return f ? new PNGWriter(f, width, height, bytesPerSample) : nullptr;
+}
+
+//! sequential writer for tiled TIFF files; rows are collected until a
+//! whole row of tiles is complete, and the directory is written at the end
+class TIFFWriter : public RowWriter {
+    static constexpr int TileSize = 256;
+    bool m_big;              //!< BigTIFF format (64-bit offsets)
+    uint64_t m_pos = 0;      //!< current file offset
+    int m_tilesX;
+    std::vector<uint8_t> m_band;  //!< one row of tiles
+    int m_bandRows = 0;
+    std::vector<uint8_t> m_tile;
+    std::vector<uint64_t> m_offsets;
+    std::vector<uint64_t> m_counts;
+
+    bool put(const void* data, size_t size) {
+        m_pos += size;
+        return write(data, size);
+    }
+    template <typename T> bool putValue(T value) {
+        return put(&value, sizeof(T));  // TIFF is written in host byte order
+    }
+
+    //! horizontal differencing (TIFF predictor 2) for integer samples
+    template <typename T> void predict(T* row, int width) {
+        for (int x = width * 4 - 1;  x > 3;  --x) { row[x] = T(row[x] - row[x - 4]); }
+    }
+
+    bool writeBand() {
+        const size_t bpp = size_t(m_bytesPerSample) * 4u;
+        const size_t tileRow = size_t(TileSize) * bpp;
+        for (int tx = 0;  m_ok && (tx < m_tilesX);  ++tx) {
+            // extract the tile; pixels outside of the image are zero
+            std::fill(m_tile.begin(), m_tile.end(), uint8_t(0));
+            int x0 = tx * TileSize;
+            int w = std::min(TileSize, m_width - x0);
+            for (int y = 0;  y < m_bandRows;  ++y) {
+                uint8_t* row = &m_tile[size_t(y) * tileRow];
+                memcpy(row, &m_band[(size_t(y) * size_t(m_width) + size_t(x0)) * bpp], size_t(w) * bpp);
+                switch (m_bytesPerSample) {
+                    case 1:  predict(row, w); break;
+                    case 2:  predict(reinterpret_cast<uint16_t*>(row), w); break;
+                    default: break;  // floating-point samples aren't predicted
+                }
+            }
+            Deflate::Encoder z;
+            z.write(m_tile.data(), m_tile.size());
+            z.finish();
+            m_offsets.push_back(m_pos);
+            m_counts.push_back(z.output.size());
+            put(z.output.data(), z.output.size());
+        }
+        m_bandRows = 0;
+        return m_ok;
+    }
+
+public:
+    TIFFWriter(FILE* f, int width, int height, int bytesPerSample) {
+        m_file = f;
+        m_width = width;
+        m_height = height;
+        m_bytesPerSample = bytesPerSample;
+        m_tilesX = (width + TileSize - 1) / TileSize;
+        int tilesY = (height + TileSize - 1) / TileSize;
+        m_band.resize(rowSize() * size_t(TileSize));
+        m_tile.resize(size_t(TileSize) * size_t(TileSize) * size_t(bytesPerSample) * 4u);
+
+        // the worst case for the fixed Huffman code is 9 bits per byte;
+        // if that could exceed the 32-bit offsets, use BigTIFF
+        uint64_t maxSize = uint64_t(m_tilesX) * uint64_t(tilesY) * (uint64_t(m_tile.size()) * 9u / 8u + 1024u);
+        m_big = (maxSize > 0xFFF00000u);
+
+        // header; the offset of the directory is filled in at the end
+        put(isLittleEndian() ? "II" : "MM", 2);
+        if (m_big) {
+            putValue(uint16_t(43));
+            putValue(uint16_t(8));  // offset size
+            putValue(uint16_t(0));
+            putValue(uint64_t(0));
+        } else {
+            putValue(uint16_t(42));
+            putValue(uint32_t(0));
+        }
+    }
+
+    bool writeRows(const void* rows, int count) override {
+        const uint8_t* src = static_cast<const uint8_t*>(rows);
+        for (;  m_ok && count && (m_row < m_height);  --count, ++m_row, src += rowSize()) {
+            memcpy(&m_band[size_t(m_bandRows) * rowSize()], src, rowSize());
+            ++m_bandRows;
+            if ((m_bandRows == TileSize) || ((m_row + 1) == m_height)) { writeBand(); }
+        }
+        return m_ok;
+    }
+
+    bool finish() override {
+        if (m_bandRows) { writeBand(); }
+
+        // directory entries; arrays that don't fit into an entry are
+        // written before the directory itself
+        struct Entry {
+            uint16_t tag, type;
+            std::vector<uint64_t> values;
+        };
+        const uint16_t Short = 3, Long = 4, Long8 = 16;
+        const uint16_t offsetType = m_big ? Long8 : Long;
+        const uint16_t bits = uint16_t(m_bytesPerSample * 8);
+        const uint16_t sampleFormat = (m_bytesPerSample == 4) ? 3 : 1;  // float or unsigned integer
+        std::vector<Entry> entries = {
+            { 256, Long,  { uint64_t(m_width) } },                      // ImageWidth
+            { 257, Long,  { uint64_t(m_height) } },                     // ImageLength
+            { 258, Short, { bits, bits, bits, bits } },                 // BitsPerSample
+            { 259, Short, { 8 } },                                      // Compression: Deflate
+            { 262, Short, { 2 } },                                      // PhotometricInterpretation: RGB
+            { 277, Short, { 4 } },                                      // SamplesPerPixel
+            { 284, Short, { 1 } },                                      // PlanarConfiguration: interleaved
+            { 317, Short, { (m_bytesPerSample == 4) ? 1u : 2u } },      // Predictor: none or horizontal
+            { 322, Short, { uint64_t(TileSize) } },                     // TileWidth
+            { 323, Short, { uint64_t(TileSize) } },                     // TileLength
+            { 324, offsetType, m_offsets },                             // TileOffsets
+            { 325, offsetType, m_counts },                              // TileByteCounts
+            { 338, Short, { 2 } },                                      // ExtraSamples: unassociated alpha
+            { 339, Short, { sampleFormat, sampleFormat, sampleFormat, sampleFormat } },  // SampleFormat
+        };
+        const auto typeSize = [] (uint16_t type) -> size_t {
+            return (type == Short) ? 2u : (type == Long) ? 4u : 8u;
+        };
+        const size_t inlineSize = m_big ? 8u : 4u;
+        const auto putTyped = [&] (uint16_t type, uint64_t value) {
+                 if (type == Short) { putValue(uint16_t(value)); }
+            else if (type == Long)  { putValue(uint32_t(value)); }
+            else                    { putValue(value); }
+        };
+        std::vector<uint64_t> arrayOffsets;
+        for (const auto& e : entries) {
+            uint64_t offset = 0;
+            if ((e.values.size() * typeSize(e.type)) > inlineSize) {
+                if (m_pos & 1) { put("", 1); }  // TIFF wants word alignment
+                offset = m_pos;
+                for (uint64_t v : e.values) { putTyped(e.type, v); }
+            }
+            arrayOffsets.push_back(offset);
+        }
+        if (m_pos & 1) { put("", 1); }
+        uint64_t ifdOffset = m_pos;
+        if (m_big) { putValue(uint64_t(entries.size())); } else { putValue(uint16_t(entries.size())); }
+        for (size_t i = 0;  i < entries.size();  ++i) {
+            const Entry& e = entries[i];
+            putValue(e.tag);
+            putValue(e.type);
+            if (m_big) { putValue(uint64_t(e.values.size())); } else { putValue(uint32_t(e.values.size())); }
+            if (arrayOffsets[i]) {
+                putTyped(offsetType, arrayOffsets[i]);
+            } else {
+                // inline values are left-aligned and padded with zeros
+                size_t used = e.values.size() * typeSize(e.type);
+                for (uint64_t v : e.values) { putTyped(e.type, v); }
+                static const uint8_t zeros[8] = { 0, };
+                put(zeros, inlineSize - used);
+            }
+        }
+        if (m_big) { putValue(uint64_t(0)); } else { putValue(uint32_t(0)); }  // no next directory
+
+        // fill in the directory offset in the header
+        m_ok = m_ok && (fseek(m_file, m_big ? 8 : 4, SEEK_SET) == 0);
+        if (m_big) { putValue(ifdOffset); } else { putValue(uint32_t(ifdOffset)); }
+        return close();
+    }
+};
+
+RowWriter* createTIFFWriter(const char* filename, int width, int height, int bytesPerSample) {
+    if (!filename || (width < 1) || (height < 1)
+    || ((bytesPerSample != 1) && (bytesPerSample != 2) && (bytesPerSample != 4))) { return nullptr; }
+    FILE* f = fopen(filename, "wb");
+    return f ? new TIFFWriter(f, width, height, bytesPerSample) : nullptr;
+}
+
+//! sequential PAM writer; this just needs to take care of the byte order
+class PAMWriter : public RowWriter {
+    std::vector<uint8_t> m_line;
+public:
+    PAMWriter(FILE* f, int width, int height, int bytesPerSample) {
+        m_file = f;
+        m_width = width;
+        m_height = height;
+        m_bytesPerSample = bytesPerSample;
+        m_line.resize(rowSize());
+        m_ok = (fprintf(f, "P7\nWIDTH %d\nHEIGHT %d\nDEPTH 4\nMAXVAL %d\nTUPLTYPE RGB_ALPHA\nENDHDR\n",
+                        width, height, (bytesPerSample == 2) ? 65535 : 255) > 0);
+    }
+    bool writeRows(const void* rows, int count) override {
+        const uint8_t* src = static_cast<const uint8_t*>(rows);
+        for (;  m_ok && count && (m_row < m_height);  --count, ++m_row, src += rowSize()) {
+            if ((m_bytesPerSample == 2) && isLittleEndian()) {
+                for (size_t i = 0;  i < m_line.size();  i += 2) { m_line[i] = src[i + 1];  m_line[i + 1] = src[i]; }
+                write(m_line.data(), m_line.size());
+            } else {
+                write(src, rowSize());
+            }
+        }
+        return m_ok;
+    }
+    bool finish() override {
+        return close();
+    }
+};
+
+RowWriter* createPAMWriter(const char* filename, int width, int height, int bytesPerSample) {
+    if (!filename || (width < 1) || (height < 1) || ((bytesPerSample != 1) && (bytesPerSample != 2))) { return nullptr; }
+    FILE* f = fopen(filename, "wb");
+    return f ? new PAMWriter(f, width, height, bytesPerSample) : nullptr;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+}  // namespace ImageUtil
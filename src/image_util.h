@@ -0,0 +1,153 @@
+// SPDX-FileCopyrightText: 2021 Martin J. Fiedler <keyj@emphy.de>
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+
+namespace ImageUtil {
+
+///////////////////////////////////////////////////////////////////////////////
+
+//! write a 16-bit RGBA PNG file
+//! \param data  interleaved RGBA samples in host byte order, top-down
+bool writePNG16(const char* filename, int width, int height, const uint16_t* data);
+
+//! write a 16-bit RGBA PAM (portable arbitrary map) file
+//! \param data  interleaved RGBA samples in host byte order, top-down
+bool writePAM16(const char* filename, int width, int height, const uint16_t* data);
+
+//! write a floating-point RGB PFM (portable float map) file;
+//! alpha is dropped, as the format doesn't support it
+//! \param data  interleaved RGBA samples, top-down
+bool writePFM(const char* filename, int width, int height, const float* data);
+
+///////////////////////////////////////////////////////////////////////////////
+
+//! sequential (row-by-row) image decoder, for images that are too large
+//! to be decoded into memory as a whole
+class RowReader {
+protected:
+    int m_width = 0;
+    int m_height = 0;
+    int m_bytesPerSample = 1;
+    int m_row = 0;  //!< next row to be decoded
+public:
+    inline bool good()           const { return (m_width > 0) && (m_height > 0); }
+    inline int  width()          const { return m_width; }
+    inline int  height()         const { return m_height; }
+    inline int  bytesPerSample() const { return m_bytesPerSample; }  //!< 1 (uint8_t), 2 (uint16_t) or 4 (float)
+    inline int  currentRow()     const { return m_row; }
+    inline size_t rowSize()      const { return size_t(m_width) * 4u * size_t(m_bytesPerSample); }
+
+    //! decode the next rows as RGBA in host byte order
+    virtual bool readRows(void* dest, int count) = 0;
+
+    inline RowReader() {}
+    RowReader(const RowReader&) = delete;
+    virtual ~RowReader() {}
+};
+
+//! create a sequential reader for a PNG, QOI or raw PPM/PAM/PFM file in
+//! memory (which must stay valid as long as the reader is used)
+//! \returns a new reader (must be deleted by the caller), or nullptr if
+//!          the data can't be decoded sequentially; in that case, the
+//!          file should be decoded as a whole instead
+RowReader* createRowReader(const uint8_t* data, size_t size);
+
+///////////////////////////////////////////////////////////////////////////////
+
+//! sequential (row-by-row) image encoder, for images that are too large
+//! to be kept in memory as a whole
+class RowWriter {
+protected:
+    FILE* m_file = nullptr;
+    int m_width = 0;
+    int m_height = 0;
+    int m_bytesPerSample = 1;
+    int m_row = 0;  //!< next row to be encoded
+    bool m_ok = true;
+    bool write(const void* data, size_t size);
+    bool close();
+public:
+    inline bool good()           const { return m_file && m_ok; }
+    inline int  width()          const { return m_width; }
+    inline int  height()         const { return m_height; }
+    inline int  bytesPerSample() const { return m_bytesPerSample; }  //!< 1 (uint8_t), 2 (uint16_t) or 4 (float)
+    inline int  currentRow()     const { return m_row; }
+    inline size_t rowSize()      const { return size_t(m_width) * 4u * size_t(m_bytesPerSample); }
+
+    //! encode the next rows, given as RGBA in host byte order
+    virtual bool writeRows(const void* rows, int count) = 0;
+
+    //! write everything that's still pending and close the file
+    //! \returns true if the whole file has been written successfully
+    virtual bool finish() = 0;
+
+    inline RowWriter() {}
+    RowWriter(const RowWriter&) = delete;
+    virtual ~RowWriter();
+};
+
+//! create a sequential writer for an RGBA PNG file with 8 or 16 bits
+//! per sample; the data is compressed and written in small pieces
+//! \returns a new writer (must be deleted by the caller), or nullptr if
+//!          the file can't be created
+RowWriter* createPNGWriter(const char* filename, int width, int height, int bytesPerSample);
+
+//! create a sequential writer for a tiled, deflate-compressed RGBA TIFF
+//! file with 8 or 16 bits per sample or floating-point samples; the file
+//! is written in BigTIFF format if it could get larger than 4 GiB
+RowWriter* createTIFFWriter(const char* filename, int width, int height, int bytesPerSample);
+
+//! create a sequential writer for an RGBA PAM file with 8 or 16 bits per sample
+RowWriter* createPAMWriter(const char* filename, int width, int height, int bytesPerSample);
+
+///////////////////////////////////////////////////////////////////////////////
+
+//! decode a QOI ("Quite OK Image") file from memory
+//! \returns a newly-malloc'd RGBA8 image (must be free()d by the caller),
+//!          or nullptr if the data is invalid
+uint8_t* decodeQOI(const uint8_t* data, size_t size, int& width, int& height);
+
+//! write an RGBA8 image as a QOI file
+bool writeQOI(const char* filename, int width, int height, const uint8_t* data);
+
+///////////////////////////////////////////////////////////////////////////////
+
+//! layout of the pixel data in an uncompressed PPM, PAM or PFM file
+struct RawImageInfo {
+    int width = 0;
+    int height = 0;
+    int channels = 0;         //!< 3 (RGB) or 4 (RGBA)
+    int bytesPerSample = 0;   //!< 1, 2 (integer) or 4 (float)
+    bool bigEndian = false;   //!< byte order of multi-byte samples
+    bool bottomUp = false;    //!< rows are stored bottom-to-top
+    size_t offset = 0;        //!< start of the pixel data in the file
+    inline size_t rowSize()  const { return size_t(width) * size_t(channels) * size_t(bytesPerSample); }
+    inline size_t dataSize() const { return rowSize() * size_t(height); }
+    //! check whether the samples' byte order differs from the host's
+    bool needsByteSwap() const;
+};
+
+//! parse the header of a binary RGB(A) PPM, PAM or PFM file; only
+//! layouts that can be used without any conversion except byte swapping
+//! and row flipping are accepted (i.e. no grayscale, maxval 255 or 65535),
+//! and the image must be at most 2^20 pixels wide and high and fit into
+//! the file completely
+bool parseRawImageHeader(const uint8_t* data, size_t size, RawImageInfo& info);
+
+//! convert the pixel data of a raw image into top-down RGBA in host byte
+//! order (uint8_t, uint16_t or float, depending on the sample size)
+//! \returns a newly-malloc'd buffer (must be free()d by the caller)
+void* convertRawImage(const uint8_t* data, const RawImageInfo& info);
+
+//! convert a rectangular region of a raw image, like convertRawImage()
+//! \param dest  buffer for width x height RGBA pixels
+bool readRawImageRegion(const uint8_t* data, const RawImageInfo& info, int x0, int y0, int width, int height, void* dest);
+
+///////////////////////////////////////////////////////////////////////////////
+
+}  // namespace ImageUtil
@@ -0,0 +1,337 @@
+// SPDX-FileCopyrightText: 2021 Martin J. Fiedler <keyj@emphy.de>
+// SPDX-License-Identifier: MIT
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <string>
+#include <new>
+
+#include "gl_header.h"
+#include "gl_util.h"
+#include "string_util.h"
+#include "vfs.h"
+
+#include "gips_version.h"
+#include "gips_core.h"
+
+#include "libgips.h"
+
+static_assert(int(GIPS_FORMAT_DEFAULT) == int(GIPS::PixelFormat::DontCare)
+           && int(GIPS_FORMAT_INT8)    == int(GIPS::PixelFormat::Int8)
+           && int(GIPS_FORMAT_SRGB8)   == int(GIPS::PixelFormat::SRGB8)
+           && int(GIPS_FORMAT_INT16)   == int(GIPS::PixelFormat::Int16)
+           && int(GIPS_FORMAT_FLOAT16) == int(GIPS::PixelFormat::Float16)
+           && int(GIPS_FORMAT_FLOAT32) == int(GIPS::PixelFormat::Float32),
+              "GIPSFormat and GIPS::PixelFormat are out of sync");
+
+struct GIPSPipeline {
+    GIPS::Pipeline pipeline;
+    GLuint vao = 0;         //!< VAOs aren't shared, so every pipeline has its own
+    int outputNode = -1;    //!< maxNodes parameter for rendering
+    std::string error;
+    inline int setError(const char* msg) { error = msg;  return 0; }
+    inline int setSuccess() { error.clear();  return 1; }
+};
+
+namespace {
+
+constexpr int TextureUnits = 2 + GIPS::MaxNamedBuffers;
+
+inline GIPS::PixelFormat toPixelFormat(GIPSFormat f) { return static_cast<GIPS::PixelFormat>(int(f)); }
+inline GIPSFormat fromPixelFormat(GIPS::PixelFormat f) { return static_cast<GIPSFormat>(int(f)); }
+
+inline bool isBufferType(GIPSFormat f) {
+    return (f == GIPS_FORMAT_INT8) || (f == GIPS_FORMAT_INT16) || (f == GIPS_FORMAT_FLOAT32);
+}
+
+//! saves all caller's GL state that the pipeline may modify, and sets
+//! the state that the pipeline relies on; the caller's state is restored
+//! when the guard goes out of scope
+class StateGuard {
+    GLint m_vao = 0;
+    GLint m_program = 0;
+    GLint m_drawFBO = 0;
+    GLint m_readFBO = 0;
+    GLint m_viewport[4] = { 0, };
+    GLint m_scissorBox[4] = { 0, };
+    GLint m_activeTex = GL_TEXTURE0;
+    GLint m_tex2D[TextureUnits] = { 0, };
+    GLint m_sampler[TextureUnits] = { 0, };
+    GLint m_tex3D = 0;  //!< unit 1 only, which is used for LUTs
+    GLint m_unpackBuffer = 0;
+    GLint m_packBuffer = 0;
+    GLint m_unpackAlign = 4;
+    GLint m_packAlign = 4;
+    GLint m_unpackRowLength = 0;
+    GLint m_packRowLength = 0;
+    GLboolean m_colorMask[4] = { GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE };
+    GLboolean m_blend, m_depthTest, m_stencilTest, m_scissorTest, m_cullFace, m_sRGB;
+
+    static inline void setEnable(GLenum cap, GLboolean enable)
+        { if (enable) { glEnable(cap); } else { glDisable(cap); } }
+
+public:
+    explicit StateGuard(GLuint vao) {
+        glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &m_vao);
+        glGetIntegerv(GL_CURRENT_PROGRAM, &m_program);
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &m_drawFBO);
+        glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &m_readFBO);
+        glGetIntegerv(GL_VIEWPORT, m_viewport);
+        glGetIntegerv(GL_SCISSOR_BOX, m_scissorBox);
+        glGetIntegerv(GL_ACTIVE_TEXTURE, &m_activeTex);
+        for (int i = 0;  i < TextureUnits;  ++i) {
+            glActiveTexture(GLenum(GL_TEXTURE0 + i));
+            glGetIntegerv(GL_TEXTURE_BINDING_2D, &m_tex2D[i]);
+            glGetIntegerv(GL_SAMPLER_BINDING, &m_sampler[i]);
+            if (i == 1) { glGetIntegerv(GL_TEXTURE_BINDING_3D, &m_tex3D); }
+            glBindSampler(GLuint(i), 0);
+        }
+        glActiveTexture(GL_TEXTURE0);
+        glGetIntegerv(GL_PIXEL_UNPACK_BUFFER_BINDING, &m_unpackBuffer);
+        glGetIntegerv(GL_PIXEL_PACK_BUFFER_BINDING, &m_packBuffer);
+        glGetIntegerv(GL_UNPACK_ALIGNMENT, &m_unpackAlign);
+        glGetIntegerv(GL_PACK_ALIGNMENT, &m_packAlign);
+        glGetIntegerv(GL_UNPACK_ROW_LENGTH, &m_unpackRowLength);
+        glGetIntegerv(GL_PACK_ROW_LENGTH, &m_packRowLength);
+        glGetBooleanv(GL_COLOR_WRITEMASK, m_colorMask);
+        m_blend       = glIsEnabled(GL_BLEND);
+        m_depthTest   = glIsEnabled(GL_DEPTH_TEST);
+        m_stencilTest = glIsEnabled(GL_STENCIL_TEST);
+        m_scissorTest = glIsEnabled(GL_SCISSOR_TEST);
+        m_cullFace    = glIsEnabled(GL_CULL_FACE);
+        m_sRGB        = glIsEnabled(GL_FRAMEBUFFER_SRGB);
+
+        // set up what the pipeline expects (i.e. the GL's defaults)
+        glBindVertexArray(vao);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        glDisable(GL_BLEND);
+        glDisable(GL_DEPTH_TEST);
+        glDisable(GL_STENCIL_TEST);
+        glDisable(GL_SCISSOR_TEST);
+        glDisable(GL_CULL_FACE);
+        glDisable(GL_FRAMEBUFFER_SRGB);
+    }
+
+    ~StateGuard() {
+        glBindVertexArray(GLuint(m_vao));
+        glUseProgram(GLuint(m_program));
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, GLuint(m_drawFBO));
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, GLuint(m_readFBO));
+        glViewport(m_viewport[0], m_viewport[1], m_viewport[2], m_viewport[3]);
+        glScissor(m_scissorBox[0], m_scissorBox[1], m_scissorBox[2], m_scissorBox[3]);
+        for (int i = 0;  i < TextureUnits;  ++i) {
+            glActiveTexture(GLenum(GL_TEXTURE0 + i));
+            glBindTexture(GL_TEXTURE_2D, GLuint(m_tex2D[i]));
+            if (i == 1) { glBindTexture(GL_TEXTURE_3D, GLuint(m_tex3D)); }
+            glBindSampler(GLuint(i), GLuint(m_sampler[i]));
+        }
+        glActiveTexture(GLenum(m_activeTex));
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, GLuint(m_unpackBuffer));
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, GLuint(m_packBuffer));
+        glPixelStorei(GL_UNPACK_ALIGNMENT, m_unpackAlign);
+        glPixelStorei(GL_PACK_ALIGNMENT, m_packAlign);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, m_unpackRowLength);
+        glPixelStorei(GL_PACK_ROW_LENGTH, m_packRowLength);
+        glColorMask(m_colorMask[0], m_colorMask[1], m_colorMask[2], m_colorMask[3]);
+        setEnable(GL_BLEND,            m_blend);
+        setEnable(GL_DEPTH_TEST,       m_depthTest);
+        setEnable(GL_STENCIL_TEST,     m_stencilTest);
+        setEnable(GL_SCISSOR_TEST,     m_scissorTest);
+        setEnable(GL_CULL_FACE,        m_cullFace);
+        setEnable(GL_FRAMEBUFFER_SRGB, m_sRGB);
+    }
+
+    StateGuard(const StateGuard&) = delete;
+};
+
+const GIPS::Parameter* findParam(const GIPS::Node& node, const char* name) {
+    for (int i = 0;  i < node.paramCount();  ++i) {
+        if (!strcmp(node.param(i).name(), name)) { return &node.param(i); }
+    }
+    return nullptr;
+}
+
+inline bool validNode(const GIPSPipeline* p, int node) {
+    return p && (node >= 0) && (node < p->pipeline.nodeCount());
+}
+
+}  // anonymous namespace
+
+///////////////////////////////////////////////////////////////////////////////
+
+const char* gipsGetVersion(void) {
+    return GIPS_VERSION;
+}
+
+int gipsInit(GIPSGetProcAddress getProcAddress) {
+    if (GLutil::initialized) { return 1; }
+    if (!getProcAddress || !gladLoadGLLoader((GLADloadproc)getProcAddress)) { return 0; }
+    // GLutil::init() binds a vertex array, which must not stay bound
+    GLint vao = 0;
+    glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &vao);
+    bool ok = GLutil::init();
+    glBindVertexArray(GLuint(vao));
+    return ok ? 1 : 0;
+}
+
+void gipsAddShaderPath(const char* path) {
+    if (path && path[0]) { VFS::addRoot(path); }
+}
+
+GIPSPipeline* gipsCreatePipeline(void) {
+    if (!GLutil::initialized) { return nullptr; }
+    GIPSPipeline* p = new(std::nothrow) GIPSPipeline;
+    if (!p) { return nullptr; }
+    glGenVertexArrays(1, &p->vao);
+    bool ok;
+    {
+        StateGuard guard(p->vao);
+        ok = p->pipeline.init();
+    }
+    if (!ok) {
+        gipsDestroyPipeline(p);
+        return nullptr;
+    }
+    return p;
+}
+
+void gipsDestroyPipeline(GIPSPipeline* p) {
+    if (!p) { return; }
+    {
+        StateGuard guard(p->vao);
+        p->pipeline.free();
+    }
+    if (p->vao) { glDeleteVertexArrays(1, &p->vao); }
+    delete p;
+}
+
+const char* gipsGetError(const GIPSPipeline* p) {
+    return p ? p->error.c_str() : "invalid pipeline";
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int gipsLoadPipelineString(GIPSPipeline* p, const char* data) {
+    if (!p || !data) { return 0; }
+    // the parser works in-place, so it needs a copy
+    std::string copy(data);
+    int showIndex;
+    {
+        StateGuard guard(p->vao);
+        showIndex = p->pipeline.unserialize(&copy[0]);
+    }
+    if (showIndex < 0) { return p->setError("invalid pipeline file"); }
+    p->outputNode = showIndex;
+    return p->setSuccess();
+}
+
+int gipsLoadPipeline(GIPSPipeline* p, const char* filename) {
+    if (!p || !filename) { return 0; }
+    char* data = StringUtil::loadTextFile(filename);
+    if (!data) { return p->setError("can't read pipeline file"); }
+    // shaders are searched in the pipeline file's directory, too
+    VFS::TemporaryRoot tempRoot;
+    tempRoot.begin(filename);
+    int res = gipsLoadPipelineString(p, data);
+    tempRoot.end();
+    ::free(data);
+    return res;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int gipsGetNodeCount(const GIPSPipeline* p) {
+    return p ? p->pipeline.nodeCount() : 0;
+}
+
+const char* gipsGetNodeName(const GIPSPipeline* p, int node) {
+    return validNode(p, node) ? p->pipeline.node(node).name() : nullptr;
+}
+
+const char* gipsGetNodeErrors(const GIPSPipeline* p, int node) {
+    return validNode(p, node) ? p->pipeline.node(node).errors() : nullptr;
+}
+
+int gipsFindNode(const GIPSPipeline* p, const char* name) {
+    if (!p || !name) { return -1; }
+    for (int i = 0;  i < p->pipeline.nodeCount();  ++i) {
+        if (!strcmp(p->pipeline.node(i).name(), name)) { return i; }
+    }
+    return -1;
+}
+
+void gipsSetNodeEnabled(GIPSPipeline* p, int node, int enabled) {
+    if (validNode(p, node)) { p->pipeline.node(node).setEnabled(enabled != 0); }
+}
+
+int gipsSetParameter(GIPSPipeline* p, int node, const char* name, const float* values, int count) {
+    if (!p || !name || !values || (count < 1)) { return 0; }
+    if (count > 4) { count = 4; }
+    int setCount = 0;
+    for (int i = 0;  i < p->pipeline.nodeCount();  ++i) {
+        if ((node >= 0) && (i != node)) { continue; }
+        GIPS::Parameter* param = p->pipeline.node(i).findParam(name);
+        if (!param) { continue; }
+        for (int j = 0;  j < count;  ++j) {
+            param->value()[j] = values[j];
+        }
+        ++setCount;
+    }
+    if (!setCount) { p->setError("no such parameter"); }
+    return setCount;
+}
+
+int gipsGetParameter(const GIPSPipeline* p, int node, const char* name, float values[4]) {
+    if (!validNode(p, node) || !name || !values) { return 0; }
+    const GIPS::Parameter* param = findParam(p->pipeline.node(node), name);
+    if (!param) { return 0; }
+    for (int i = 0;  i < 4;  ++i) {
+        values[i] = param->value()[i];
+    }
+    return 1;
+}
+
+void gipsSetOutputNode(GIPSPipeline* p, int node) {
+    if (p) { p->outputNode = node; }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int gipsRenderTexture(GIPSPipeline* p, unsigned srcTex, int width, int height, GIPSFormat format,
+                      unsigned* resultTex, GIPSFormat* resultFormat) {
+    if (!p || !resultTex) { return 0; }
+    if (!srcTex || (width < 1) || (height < 1)) { return p->setError("invalid source texture"); }
+    StateGuard guard(p->vao);
+    // changed() needs to be called to invalidate outdated node caches
+    p->pipeline.changed();
+    p->pipeline.latchParameters();
+    p->pipeline.render(GLuint(srcTex), width, height, toPixelFormat(format), p->outputNode);
+    *resultTex = p->pipeline.resultTex();
+    if (resultFormat) { *resultFormat = fromPixelFormat(p->pipeline.resultFormat()); }
+    return *resultTex ? p->setSuccess() : p->setError("rendering failed");
+}
+
+int gipsCopyResult(GIPSPipeline* p, unsigned destTex) {
+    if (!p || !destTex) { return 0; }
+    StateGuard guard(p->vao);
+    return p->pipeline.copyResult(GLuint(destTex)) ? p->setSuccess() : p->setError("copying the result failed");
+}
+
+int gipsRenderBuffer(GIPSPipeline* p, const void* src, GIPSFormat srcType,
+                     void* dest, GIPSFormat destType, int width, int height, GIPSFormat format) {
+    if (!p) { return 0; }
+    if (!src || !dest || (width < 1) || (height < 1)) { return p->setError("invalid buffer"); }
+    if (!isBufferType(srcType) || !isBufferType(destType)) { return p->setError("unsupported buffer type"); }
+    StateGuard guard(p->vao);
+    p->pipeline.changed();
+    p->pipeline.latchParameters();
+    GIPS::MemoryTileIO io(src, width, toPixelFormat(srcType), dest, width, toPixelFormat(destType));
+    if (p->pipeline.renderTiled(io, width, height, toPixelFormat(format), p->outputNode)) { return p->setSuccess(); }
+    return p->setError(p->pipeline.tilingError() ? p->pipeline.tilingError() : "rendering failed");
+}
@@ -0,0 +1,144 @@
+// SPDX-FileCopyrightText: 2021 Martin J. Fiedler <keyj@emphy.de>
+// SPDX-License-Identifier: MIT
+
+// libgips: C API for embedding the GIPS processing core into other
+// applications, without the GIPS user interface.
+//
+// All functions (except gipsGetVersion() and gipsAddShaderPath()) must be
+// called with an OpenGL 3.3 core profile context being current on the
+// calling thread; a pipeline must always be used with the context (or a
+// context of the share group) that it was created in. GIPS saves and
+// restores all GL state it touches, so it can run in the caller's own
+// context between the caller's own rendering.
+//
+// The API is stable: functions are only ever added, and the numerical
+// values of the enums don't change.
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define GIPS_API_VERSION 1
+
+//! pixel formats; the values are the same as those of GIPS::PixelFormat
+typedef enum GIPSFormat {
+    GIPS_FORMAT_DEFAULT = 0,    //!< as requested by the pipeline's nodes
+    GIPS_FORMAT_GRAY8   = 1,
+    GIPS_FORMAT_GRAY16F = 2,
+    GIPS_FORMAT_INT8    = 8,    //!< 8-bit RGBA; in buffers: uint8_t samples
+    GIPS_FORMAT_SRGB8   = 9,
+    GIPS_FORMAT_RGB10A2 = 10,
+    GIPS_FORMAT_INT16   = 16,   //!< 16-bit RGBA; in buffers: uint16_t samples
+    GIPS_FORMAT_RGB11F  = 111,
+    GIPS_FORMAT_FLOAT16 = 116,
+    GIPS_FORMAT_FLOAT32 = 132,  //!< 32-bit float RGBA; in buffers: float samples
+} GIPSFormat;
+
+typedef struct GIPSPipeline GIPSPipeline;
+
+//! function that returns the address of a GL function (e.g. glfwGetProcAddress)
+typedef void* (*GIPSGetProcAddress)(const char* name);
+
+//! version string of the library
+const char* gipsGetVersion(void);
+
+//! load the GL functions; must be called once before creating any pipeline
+//! \returns 0 if the current context doesn't support OpenGL 3.3
+int gipsInit(GIPSGetProcAddress getProcAddress);
+
+//! add a directory in which the shaders referenced by pipeline files are
+//! searched (in addition to the pipeline file's own directory)
+void gipsAddShaderPath(const char* path);
+
+//! create an empty pipeline; \returns NULL on failure
+GIPSPipeline* gipsCreatePipeline(void);
+void gipsDestroyPipeline(GIPSPipeline* p);
+
+//! error message for the last failed call on a pipeline
+const char* gipsGetError(const GIPSPipeline* p);
+
+//! load a .gips pipeline file, or a pipeline in the same format from memory
+//! \returns 0 on failure; nodes with errors (e.g. missing shader files)
+//!          don't make loading fail, see gipsGetNodeErrors()
+int gipsLoadPipeline(GIPSPipeline* p, const char* filename);
+int gipsLoadPipelineString(GIPSPipeline* p, const char* data);
+
+//! information about the pipeline's nodes
+int gipsGetNodeCount(const GIPSPipeline* p);
+const char* gipsGetNodeName(const GIPSPipeline* p, int node);
+const char* gipsGetNodeErrors(const GIPSPipeline* p, int node);  //!< "" if none
+int gipsFindNode(const GIPSPipeline* p, const char* name);      //!< -1 if not found
+void gipsSetNodeEnabled(GIPSPipeline* p, int node, int enabled);
+
+//! set a parameter by name
+//! \param node   index of the node, or -1 for all nodes with that parameter
+//! \param count  number of values (1 to 4); missing values are unchanged
+//! \returns the number of parameters that have been set
+int gipsSetParameter(GIPSPipeline* p, int node, const char* name, const float* values, int count);
+
+//! get a parameter's value (always 4 values)
+//! \returns 0 if the node doesn't have such a parameter
+int gipsGetParameter(const GIPSPipeline* p, int node, const char* name, float values[4]);
+
+//! only process the nodes before this one (the pipeline file's ".show"
+//! node; default: all nodes)
+void gipsSetOutputNode(GIPSPipeline* p, int node);
+
+//! run the pipeline on a texture; the result is left in a texture owned
+//! by the pipeline (which may also be the source texture itself, if no
+//! node needs to be rendered), so no copies are made; the source
+//! texture's parameters and mipmap levels are left untouched
+//! \param format      processing format, or GIPS_FORMAT_DEFAULT
+//! \param resultTex   receives the result texture; it stays valid until
+//!                    the next call that renders or modifies the pipeline
+//! \param resultFormat  receives the format of the result texture (may be NULL)
+int gipsRenderTexture(GIPSPipeline* p, unsigned srcTex, int width, int height, GIPSFormat format,
+                      unsigned* resultTex, GIPSFormat* resultFormat);
+
+//! copy the result of the last gipsRenderTexture() call into the caller's
+//! texture, which is re-allocated in the result's format and size
+int gipsCopyResult(GIPSPipeline* p, unsigned destTex);
+
+//! run the pipeline on an RGBA image in system memory; the image is
+//! processed in tiles, so it can be larger than the maximum texture size
+//! \param srcType, destType  sample type: GIPS_FORMAT_INT8, _INT16 or _FLOAT32
+//! \note src and dest must not overlap, as neighboring tiles overlap.
+int gipsRenderBuffer(GIPSPipeline* p, const void* src, GIPSFormat srcType,
+                     void* dest, GIPSFormat destType, int width, int height, GIPSFormat format);
+
+#ifdef __cplusplus
+}  // extern "C"
+
+//! thin C++ wrapper around the C API, for RAII and convenience
+namespace libgips {
+
+class Pipeline {
+    GIPSPipeline* m_p;
+public:
+    inline Pipeline() : m_p(gipsCreatePipeline()) {}
+    Pipeline(const Pipeline&) = delete;
+    inline ~Pipeline() { gipsDestroyPipeline(m_p); }
+    inline bool good() const { return m_p != nullptr; }
+    inline GIPSPipeline* handle() const { return m_p; }
+    inline const char* error() const { return gipsGetError(m_p); }
+    inline bool load(const char* filename) { return !!gipsLoadPipeline(m_p, filename); }
+    inline bool loadString(const char* data) { return !!gipsLoadPipelineString(m_p, data); }
+    inline int nodeCount() const { return gipsGetNodeCount(m_p); }
+    inline int findNode(const char* name) const { return gipsFindNode(m_p, name); }
+    inline int set(const char* name, float value, int node=-1)
+        { return gipsSetParameter(m_p, node, name, &value, 1); }
+    inline int set(const char* name, const float* values, int count, int node=-1)
+        { return gipsSetParameter(m_p, node, name, values, count); }
+    inline unsigned render(unsigned srcTex, int width, int height, GIPSFormat format=GIPS_FORMAT_DEFAULT) {
+        unsigned tex = 0;
+        return gipsRenderTexture(m_p, srcTex, width, height, format, &tex, nullptr) ? tex : 0u;
+    }
+    inline bool render(const void* src, GIPSFormat srcType, void* dest, GIPSFormat destType,
+                       int width, int height, GIPSFormat format=GIPS_FORMAT_DEFAULT)
+        { return !!gipsRenderBuffer(m_p, src, srcType, dest, destType, width, height, format); }
+};
+
+}  // namespace libgips
+#endif